@@ -0,0 +1,195 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: framecapture.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "framecapture.h"
+#include "framewriter.h"
+
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+
+#include <stdio.h>
+#include <string.h>
+
+/*======================================== DEFINES =======================================*/
+
+static const int      Readbacks   = 3;           // readbacks in flight
+static const GLuint64 WaitTimeout = 1000000000;  // nanoseconds per wait on a fence
+
+/*======================================== GLOBAL ========================================*/
+
+// flips and encodes an image read back from the GL
+class SaveTask : public QRunnable
+{
+    public:
+        SaveTask(const QImage &image, const QString &fileName) :
+            image(image), fileName(fileName) {}
+
+        void run()
+        {
+            if (!image.mirrored().save(fileName, "PNG"))
+                fprintf(stderr, "can't write \"%s\"\n", fileName.toUtf8().data());
+        }
+
+    private:
+        QImage image;
+        QString fileName;
+};
+
+/*======================================== PUBLIC ========================================*/
+
+FrameCapture::FrameCapture() :
+    initialized(false), pixelBuffers(false), next(0)
+{
+}
+
+void FrameCapture::capture(int x, int y, int width, int height, const QString &fileName)
+{
+    capture(x, y, width, height, fileName, NULL);
+}
+
+void FrameCapture::capture(int x, int y, int width, int height, FrameWriter *writer)
+{
+    capture(x, y, width, height, QString(), writer);
+}
+
+bool FrameCapture::poll()
+{
+    // oldest first, the fences pass in the same order
+    for (int i = 0; i < readbacks.size(); i++) {
+        Readback &readback = readbacks[(next + i) % readbacks.size()];
+        if (readback.fence && !complete(readback, false))
+            return true;
+    }
+    return false;
+}
+
+void FrameCapture::finish()
+{
+    for (int i = 0; i < readbacks.size(); i++) {
+        Readback &readback = readbacks[(next + i) % readbacks.size()];
+        if (readback.fence)
+            complete(readback, true);
+    }
+
+    // the next capture makes the buffers again
+    for (int i = 0; i < readbacks.size(); i++)
+        pglDeleteBuffers(1, &readbacks[i].buffer);
+    readbacks.clear();
+    initialized = false;
+    next = 0;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+void FrameCapture::capture(int x, int y, int width, int height,
+                           const QString &fileName, FrameWriter *writer)
+{
+    // the buffers belong to the context, which is current by now
+    if (!initialized) {
+        initialized = true;
+        pixelBuffers = (glmExtensions() & GLM_EXT_PIXELBUFFERS) != 0;
+        if (pixelBuffers) {
+            readbacks.resize(Readbacks);
+            for (int i = 0; i < Readbacks; i++) {
+                pglGenBuffers(1, &readbacks[i].buffer);
+                readbacks[i].fence = 0;
+            }
+        }
+    }
+
+    // BGRA in reversed words is ARGB32 on any byte order
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    if (!pixelBuffers) {
+        QImage image(width, height, QImage::Format_ARGB32);
+        glReadPixels(x, y, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image.bits());
+        save(image, fileName, writer);
+        return;
+    }
+
+    // the oldest readback makes room when all are in flight
+    Readback &readback = readbacks[next];
+    if (readback.fence)
+        complete(readback, true);
+    next = (next + 1) % Readbacks;
+
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    pglBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, NULL, GL_STREAM_READ);
+    glReadPixels(x, y, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.width = width;
+    readback.height = height;
+    readback.fileName = fileName;
+    readback.writer = writer;
+
+    // the fence is reached without waiting for the next frame
+    glFlush();
+}
+
+// copies a readback out of its buffer once the fence has passed, true
+// unless it is still in flight
+bool FrameCapture::complete(Readback &readback, bool wait)
+{
+    GLenum status;
+    do {
+        status = pglClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   wait ? WaitTimeout : 0);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    pglDeleteSync(readback.fence);
+    readback.fence = 0;
+    if (status == GL_WAIT_FAILED) {
+        fprintf(stderr, "capture of \"%s\" failed\n", readback.fileName.toUtf8().data());
+        return true;
+    }
+
+    QImage image(readback.width, readback.height, QImage::Format_ARGB32);
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    void *pixels = pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (pixels) {
+        memcpy(image.bits(), pixels, 4 * readback.width * readback.height);
+        pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (pixels)
+        save(image, readback.fileName, readback.writer);
+    else
+        fprintf(stderr, "capture of \"%s\" failed\n", readback.fileName.toUtf8().data());
+    return true;
+}
+
+void FrameCapture::save(const QImage &image, const QString &fileName, FrameWriter *writer)
+{
+    if (writer)
+        writer->write(image);
+    else
+        QThreadPool::globalInstance()->start(new SaveTask(image, fileName));
+}
+
+/*========================================================================================*/
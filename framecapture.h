@@ -0,0 +1,83 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: framecapture.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include "glmext.h"
+
+class FrameWriter;
+class QImage;
+
+/*======================================== CLASSES =======================================*/
+
+// Saves rectangles of the framebuffer as PNG without stalling the
+// pipeline: each one is read into a pixel pack buffer with a fence
+// behind it, and mapped once the fence has passed, a few frames later.
+// The images are encoded on the global thread pool.  Without pixel
+// buffers the pixels are read at once and only the encoding is left to
+// the pool.  All calls must be made with the GL context current.
+class FrameCapture
+{
+    public:
+        FrameCapture();
+
+        // reads from the current read buffer, rows bottom up, into a
+        // PNG file or the next frame of a writer
+        void capture(int x, int y, int width, int height, const QString &fileName);
+        void capture(int x, int y, int width, int height, FrameWriter *writer);
+
+        // hands the readbacks that are done to the encoder, in the
+        // order they were captured, true while others are in flight
+        bool poll();
+        // waits for all readbacks and frees their buffers
+        void finish();
+
+    private:
+        struct Readback {
+            GLuint buffer;
+            GLsync fence;
+            int width;
+            int height;
+            QString fileName;
+            FrameWriter *writer;
+        };
+
+        void capture(int x, int y, int width, int height,
+                     const QString &fileName, FrameWriter *writer);
+        bool complete(Readback &readback, bool wait);
+        void save(const QImage &image, const QString &fileName, FrameWriter *writer);
+
+        bool initialized;
+        bool pixelBuffers;
+        int next;
+        QVector<Readback> readbacks;
+};
+
+#endif // FRAMECAPTURE_H
+
+/*========================================================================================*/
@@ -0,0 +1,246 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: frametimer.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "frametimer.h"
+#include "glmext.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+
+/*======================================== DEFINES =======================================*/
+
+static const int HistorySize   = 1000;  // frames kept for writeCsv
+static const int AverageFrames = 60;    // frames averaged for the overlay
+static const int QueryFrames   = 4;     // frames of GPU queries in flight
+
+/*======================================== PUBLIC ========================================*/
+
+FrameTimer::FrameTimer() :
+    phaseStart(0), phase(-1), frames(0), history(HistorySize), gpu(false), slot(0)
+{
+    for (int i = 0; i < HistorySize; i++)
+        history[i].frame = -1;
+}
+
+FrameTimer::~FrameTimer()
+{
+    if (!queries.isEmpty())
+        pglDeleteQueries(queries.size(), queries.data());
+}
+
+void FrameTimer::beginFrame()
+{
+    // the queries belong to the context, which is current by now
+    if (frames == 0) {
+        gpu = (glmExtensions() & GLM_EXT_TIMERS) != 0;
+        if (gpu) {
+            queries.resize(QueryFrames * Phases);
+            pglGenQueries(queries.size(), queries.data());
+            queryFrames.fill(-1, QueryFrames);
+            queryPhases.fill(0, QueryFrames);
+        }
+    }
+
+    // collect the results of the last frame using this slot
+    slot = frames % QueryFrames;
+    if (gpu)
+        readQueries(slot);
+
+    Sample &sample = history[frames % HistorySize];
+    sample.frame = frames;
+    for (int i = 0; i < Phases; i++) {
+        sample.cpu[i] = 0.0;
+        sample.gpu[i] = -1.0;
+    }
+
+    phase = -1;
+    clock.start();
+}
+
+void FrameTimer::beginPhase(Phase value)
+{
+    endPhase();
+
+    phase = value;
+    phaseStart = clock.nsecsElapsed();
+    if (gpu) {
+        pglBeginQuery(GL_TIME_ELAPSED, queries[slot * Phases + phase]);
+        queryPhases[slot] |= 1 << phase;
+    }
+}
+
+void FrameTimer::endFrame()
+{
+    endPhase();
+
+    if (gpu)
+        queryFrames[slot] = frames;
+    frames++;
+}
+
+bool FrameTimer::hasGpu() const
+{
+    return gpu;
+}
+
+double FrameTimer::cpuAverage(Phase value) const
+{
+    return average(false, value);
+}
+
+double FrameTimer::gpuAverage(Phase value) const
+{
+    return average(true, value);
+}
+
+double FrameTimer::cpuFrameAverage() const
+{
+    return average(false, Phases);
+}
+
+double FrameTimer::gpuFrameAverage() const
+{
+    return average(true, Phases);
+}
+
+bool FrameTimer::writeCsv(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate))
+        return false;
+
+    QTextStream out(&file);
+    out << "frame";
+    for (int i = 0; i < Phases; i++)
+        out << "," << phaseName(Phase(i)) << "_cpu_ms";
+    out << ",frame_cpu_ms";
+    for (int i = 0; i < Phases; i++)
+        out << "," << phaseName(Phase(i)) << "_gpu_ms";
+    out << ",frame_gpu_ms\n";
+
+    // oldest first; gpu columns stay empty where no result came back
+    for (qint64 f = qMax(frames - HistorySize, qint64(0)); f < frames; f++) {
+        const Sample &sample = history[f % HistorySize];
+        if (sample.frame != f)
+            continue;
+
+        double cpuTotal = 0.0, gpuTotal = 0.0;
+        out << f;
+        for (int i = 0; i < Phases; i++) {
+            out << "," << sample.cpu[i];
+            cpuTotal += sample.cpu[i];
+        }
+        out << "," << cpuTotal;
+        for (int i = 0; i < Phases; i++) {
+            out << ",";
+            if (sample.gpu[i] >= 0.0) {
+                out << sample.gpu[i];
+                gpuTotal += sample.gpu[i];
+            }
+        }
+        out << ",";
+        if (sample.gpu[0] >= 0.0)
+            out << gpuTotal;
+        out << "\n";
+    }
+
+    return out.status() == QTextStream::Ok;
+}
+
+const char *FrameTimer::phaseName(Phase value)
+{
+    static const char *names[Phases] = { "setup", "draw", "overlay" };
+    return names[value];
+}
+
+/*======================================== PRIVATE =======================================*/
+
+// mean over the last AverageFrames frames with results, in milliseconds;
+// a phase of Phases gives the whole frame
+double FrameTimer::average(bool fromGpu, int value) const
+{
+    double sum = 0.0;
+    int count = 0;
+
+    for (qint64 f = frames - 1; f >= 0 && f >= frames - AverageFrames - QueryFrames &&
+            count < AverageFrames; f--) {
+        const Sample &sample = history[f % HistorySize];
+        const double *times = fromGpu ? sample.gpu : sample.cpu;
+        if (sample.frame != f || times[0] < 0.0)
+            continue;
+
+        for (int i = 0; i < Phases; i++) {
+            if (value == Phases || value == i)
+                sum += times[i];
+        }
+        count++;
+    }
+    return count ? sum / count : 0.0;
+}
+
+void FrameTimer::endPhase()
+{
+    if (phase < 0)
+        return;
+
+    history[frames % HistorySize].cpu[phase] += (clock.nsecsElapsed() - phaseStart) / 1e6;
+    if (gpu)
+        pglEndQuery(GL_TIME_ELAPSED);
+    phase = -1;
+}
+
+void FrameTimer::readQueries(int index)
+{
+    qint64 frame = queryFrames[index];
+    int begun = queryPhases[index];
+
+    queryFrames[index] = -1;
+    queryPhases[index] = 0;
+    if (frame < 0)
+        return;
+
+    Sample &sample = history[frame % HistorySize];
+    if (sample.frame != frame)
+        return;
+
+    // results not back after QueryFrames frames are dropped rather
+    // than waited for
+    GLint available;
+    for (int i = 0; i < Phases; i++) {
+        if (!(begun & (1 << i)))
+            continue;
+        pglGetQueryObjectiv(queries[index * Phases + i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+    }
+
+    for (int i = 0; i < Phases; i++) {
+        GLuint64 elapsed = 0;
+        if (begun & (1 << i))
+            pglGetQueryObjectui64v(queries[index * Phases + i], GL_QUERY_RESULT, &elapsed);
+        sample.gpu[i] = elapsed / 1e6;
+    }
+}
+
+/*========================================================================================*/
@@ -0,0 +1,93 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: frametimer.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef FRAMETIMER_H
+#define FRAMETIMER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+#include <GL/gl.h>
+
+/*======================================== CLASSES =======================================*/
+
+// Times the phases of each frame on the CPU and, where timer queries
+// are available, on the GPU.  GPU results are read a few frames late so
+// that waiting for them never stalls the pipeline.  All calls must be
+// made with the GL context current.
+class FrameTimer
+{
+    public:
+        enum Phase { Setup, Draw, Overlay, Phases };
+
+        FrameTimer();
+        // deletes the queries, the context must still be current
+        ~FrameTimer();
+
+        void beginFrame();
+        void beginPhase(Phase phase);
+        void endFrame();
+
+        bool hasGpu() const;
+        double cpuAverage(Phase phase) const;
+        double gpuAverage(Phase phase) const;
+        double cpuFrameAverage() const;
+        double gpuFrameAverage() const;
+
+        bool writeCsv(const QString &fileName) const;
+
+        static const char *phaseName(Phase phase);
+
+    private:
+        // milliseconds spent in each phase, gpu < 0 until known
+        struct Sample {
+            qint64 frame;
+            double cpu[Phases];
+            double gpu[Phases];
+        };
+
+        double average(bool fromGpu, int phase) const;
+        void endPhase();
+        void readQueries(int index);
+
+        QElapsedTimer clock;
+        qint64 phaseStart;
+        int phase;
+
+        qint64 frames;
+        QVector<Sample> history;
+
+        // a set of queries per frame in flight, with the frame
+        // they belong to and the phases begun
+        bool gpu;
+        int slot;
+        QVector<GLuint> queries;
+        QVector<qint64> queryFrames;
+        QVector<int> queryPhases;
+};
+
+#endif // FRAMETIMER_H
+
+/*========================================================================================*/
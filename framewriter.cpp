@@ -0,0 +1,200 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: framewriter.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "framewriter.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QProcess>
+#include <QtCore/QRunnable>
+#include <QtCore/QStringList>
+#include <QtCore/QSysInfo>
+
+#include <stdio.h>
+
+/*======================================== DEFINES =======================================*/
+
+static const int MaxQueued = 8;  // frames waiting to be encoded, 8 MB each at 1080p
+
+/*======================================== GLOBAL ========================================*/
+
+// flips and encodes one frame of an image sequence
+class ImageTask : public QRunnable
+{
+    public:
+        ImageTask(FrameWriter *writer, const QImage &image, const QString &fileName) :
+            writer(writer), image(image), fileName(fileName)
+        {
+        }
+
+        void run()
+        {
+            bool ok = image.mirrored().save(fileName, "PNG");
+            if (!ok)
+                fprintf(stderr, "can't write \"%s\"\n", fileName.toUtf8().data());
+            writer->done(ok);
+        }
+
+    private:
+        FrameWriter *writer;
+        QImage image;
+        QString fileName;
+};
+
+// feeds the frames of a video to ffmpeg as they come, which flips them
+class EncoderTask : public QRunnable
+{
+    public:
+        EncoderTask(FrameWriter *writer, int width, int height) :
+            writer(writer), width(width), height(height)
+        {
+        }
+
+        void run()
+        {
+            // ARGB32 is BGRA in memory on little endian machines
+            QStringList arguments;
+            arguments << "-loglevel" << "error" << "-y"
+                      << "-f" << "rawvideo"
+                      << "-pixel_format" << (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? "bgra" : "argb")
+                      << "-video_size" << QString("%1x%2").arg(width).arg(height)
+                      << "-framerate" << QString::number(writer->fps)
+                      << "-i" << "-"
+                      << "-vf" << "vflip" << "-pix_fmt" << "yuv420p"
+                      << writer->target;
+
+            QProcess encoder;
+            encoder.setProcessChannelMode(QProcess::ForwardedChannels);
+            encoder.start("ffmpeg", arguments);
+            bool ok = encoder.waitForStarted(-1);
+            if (!ok)
+                fprintf(stderr, "can't start ffmpeg to write \"%s\"\n", writer->target.toUtf8().data());
+
+            // frames are still taken after a failure, so write never blocks for good
+            QImage image;
+            while (!(image = writer->take()).isNull()) {
+                if (ok && image.size() != QSize(width, height)) {
+                    fprintf(stderr, "frames of \"%s\" change size\n", writer->target.toUtf8().data());
+                    ok = false;
+                }
+                if (ok) {
+                    encoder.write((const char *)image.bits(), image.byteCount());
+                    ok = encoder.waitForBytesWritten(-1) || !encoder.bytesToWrite();
+                }
+                writer->done(ok);
+            }
+
+            if (encoder.state() != QProcess::NotRunning) {
+                encoder.closeWriteChannel();
+                encoder.waitForFinished(-1);
+                if (encoder.exitStatus() != QProcess::NormalExit || encoder.exitCode() != 0) {
+                    fprintf(stderr, "ffmpeg failed to write \"%s\"\n", writer->target.toUtf8().data());
+                    writer->fail();
+                }
+            }
+        }
+
+    private:
+        FrameWriter *writer;
+        int width;
+        int height;
+};
+
+/*======================================== PUBLIC ========================================*/
+
+FrameWriter::FrameWriter(const QString &target, int fps) :
+    target(target), fps(fps), frames(0), queued(0), closed(false), failed(false)
+{
+    video = !target.endsWith(".png", Qt::CaseInsensitive);
+}
+
+FrameWriter::~FrameWriter()
+{
+    close();
+}
+
+void FrameWriter::write(const QImage &image)
+{
+    QMutexLocker locker(&mutex);
+    while (queued >= MaxQueued)
+        changed.wait(&mutex);
+    queued++;
+
+    int frame = frames++;
+    if (video) {
+        // the encoder is started on the first frame, which has the size
+        if (frame == 0)
+            pool.start(new EncoderTask(this, image.width(), image.height()));
+        images.append(image);
+        changed.wakeAll();
+    } else {
+        pool.start(new ImageTask(this, image, frameFileName(frame)));
+    }
+}
+
+bool FrameWriter::close()
+{
+    mutex.lock();
+    closed = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    pool.waitForDone();
+    return !failed;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+QString FrameWriter::frameFileName(int frame) const
+{
+    QFileInfo info(target);
+    return info.path() + "/" + info.completeBaseName() +
+           QString("_%1.").arg(frame, 4, 10, QChar('0')) + info.suffix();
+}
+
+// the next frame for the encoder, a null image once closed
+QImage FrameWriter::take()
+{
+    QMutexLocker locker(&mutex);
+    while (images.isEmpty() && !closed)
+        changed.wait(&mutex);
+    return images.isEmpty() ? QImage() : images.takeFirst();
+}
+
+// a frame is written, or could not be
+void FrameWriter::done(bool ok)
+{
+    QMutexLocker locker(&mutex);
+    queued--;
+    if (!ok)
+        failed = true;
+    changed.wakeAll();
+}
+
+void FrameWriter::fail()
+{
+    QMutexLocker locker(&mutex);
+    failed = true;
+}
+
+/*========================================================================================*/
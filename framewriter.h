@@ -0,0 +1,81 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: framewriter.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+#include <QtGui/QImage>
+
+/*======================================== CLASSES =======================================*/
+
+// Writes a sequence of frames read back from the GL (rows bottom up) on
+// a pool of threads, so that encoding overlaps drawing the next ones:
+// either as numbered PNG images, encoded in parallel, or piped as raw
+// video to an ffmpeg process.  Frames are written in order.
+class FrameWriter
+{
+    public:
+        // target - a .png file name, numbered by inserting _0000, _0001...
+        //          before the suffix, or a video file for ffmpeg
+        // fps    - frame rate of the video
+        FrameWriter(const QString &target, int fps);
+        // waits for the frames in flight
+        ~FrameWriter();
+
+        // blocks while too many frames wait to be encoded, all frames
+        // of a video must have the same size
+        void write(const QImage &image);
+        // waits for all frames, false if any could not be written
+        bool close();
+
+    private:
+        friend class ImageTask;
+        friend class EncoderTask;
+
+        QString frameFileName(int frame) const;
+        QImage take();
+        void done(bool ok);
+        void fail();
+
+        QString target;
+        int fps;
+        bool video;
+        int frames;
+        int queued;
+        bool closed;
+        bool failed;
+
+        QMutex mutex;
+        QWaitCondition changed;
+        QList<QImage> images;
+        QThreadPool pool;
+};
+
+#endif // FRAMEWRITER_H
+
+/*========================================================================================*/
@@ -18,14 +18,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stddef.h>
 #include "glm.h"
+#include "glmext.h"
+#include "glmshader.h"
 
 //#define DebugVisibleSurfaces
 
 #define total_textures 5
 
 #define T(x) (model->triangles[(x)])
+#define VISIBLE(group) (model->visiblegroups[(group)->index >> 5] & (1u << ((group)->index & 31)))
 GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat, GLboolean filtering, GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight);
+static GLvoid glmReadPoints(GLMmodel *model, FILE *file, GLuint maxpoints);
+static GLvoid glmMovePoints(GLMpointcloud *cloud, GLfloat *offset, GLfloat scale);
+static GLvoid glmDrawPoints(GLMmodel *model);
 
 /* _GLMnode: general purpose node */
 typedef struct _GLMnode {
@@ -193,9 +200,21 @@ glmAddGroup(GLMmodel *model, char *name)
         group->material = 0;
         group->numtriangles = 0;
         group->triangles = NULL;
+        group->prototype = NULL;
+        group->numlods = 0;
+        group->lods = NULL;
+        group->lod = 0;
+        group->index = model->numgroups;
         group->next = model->groups;
         model->groups = group;
         model->numgroups++;
+
+        /* groups start out visible, 32 to a word */
+        if (!(group->index & 31)) {
+            model->visiblegroups = (GLuint *)realloc(model->visiblegroups,
+                                   sizeof(GLuint) * ((group->index >> 5) + 1));
+            model->visiblegroups[group->index >> 5] = ~0u;
+        }
     }
 
     return group;
@@ -245,26 +264,18 @@ glmDirName(char *path)
     return dir;
 }
 
-int glmFindOrAddTexture(GLMmodel *model, char *name,mycallback *call)
+/* glmTexturePath: the file of a texture named in a material library,
+ * relative to the model unless it is an absolute (drive) path.  The
+ * returned string should be free'd.
+ */
+static char *
+glmTexturePath(GLMmodel *model, char *name)
 {
-    GLuint i;
     char *dir, *filename;
-    float width, height;
 
     char *numefis = name;
     while (*numefis==' ') numefis++;
 
-    for (i = 0; i < model->numtextures; i++) {
-        if (!strcmp(model->textures[i].name, numefis))
-            return i;
-    }
-    char afis[180];
-    sprintf(afis,"Loading Textures (%s )...",name);
-
-    if (call) {
-        int procent = ((float)((float)model->numtextures*30/total_textures)/100)*(call->end-call->start)+call->start;
-        call->loadcallback(procent,afis); // textures represent 30% from the model (just saying :))
-    }
     if (strstr(name,":\\")) {
         filename = (char *)malloc(sizeof(char) * (strlen(name) + 1));
         strcpy(filename,name);
@@ -281,29 +292,103 @@ int glmFindOrAddTexture(GLMmodel *model, char *name,mycallback *call)
     if (filename[lung-1]<32) filename[lung-1]=0;
     if (filename[lung-2]<32) filename[lung-2]=0;
 
-    model->numtextures++;
-    model->textures = (GLMtexture *)realloc(model->textures, sizeof(GLMtexture)*model->numtextures);
-    model->textures[model->numtextures-1].name = strdup(numefis);
-    model->textures[model->numtextures-1].id = glmLoadTexture(filename, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, &width, &height);
-    model->textures[model->numtextures-1].width = width;
-    model->textures[model->numtextures-1].height = height;
+    return filename;
+}
 
+/* glmUploadTexture: loads the file of a texture into a texture object */
+static GLvoid
+glmUploadTexture(GLMmodel *model, GLMtexture *texture)
+{
+    char *filename;
+    float width, height;
 
+    filename = glmTexturePath(model, texture->name);
+    texture->id = glmLoadTexture(filename, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, &width, &height);
+    texture->width = width;
+    texture->height = height;
     free(filename);
+}
 
-    return model->numtextures-1;
+/* glmCachedTexture: the entry of a cache holding a texture, NULL if
+ * there is none (the layers of an array share its id)
+ */
+static GLMcachedtexture *
+glmCachedTexture(GLMtexturecache *cache, GLMtexture *texture)
+{
+    GLuint i;
+
+    for (i = 0; i < cache->numtextures; i++) {
+        if (cache->textures[i].id == texture->id && cache->textures[i].layer == texture->layer)
+            return &cache->textures[i];
+    }
+    return NULL;
 }
 
+/* glmReleaseTexture: drops a reference to a cached texture, deleting
+ * it with the last one (an array with its last layer)
+ */
+static GLvoid
+glmReleaseTexture(GLMtexturecache *cache, GLMtexture *texture)
+{
+    GLMcachedtexture *cached;
+    GLuint i, id;
+
+    cached = glmCachedTexture(cache, texture);
+    if (!cached || --cached->references)
+        return;
+
+    id = cached->id;
+    free(cached->filename);
+    *cached = cache->textures[--cache->numtextures];
+    for (i = 0; i < cache->numtextures; i++) {
+        if (cache->textures[i].id == id)
+            return;
+    }
+    glDeleteTextures(1, &id);
+}
+
+int glmFindOrAddTexture(GLMmodel *model, char *name,mycallback *call, GLboolean load)
+{
+    GLuint i;
+
+    char *numefis = name;
+    while (*numefis==' ') numefis++;
+
+    for (i = 0; i < model->numtextures; i++) {
+        if (!strcmp(model->textures[i].name, numefis))
+            return i;
+    }
+    char afis[180];
+    sprintf(afis,"Loading Textures (%s )...",name);
+
+    if (call) {
+        int procent = ((float)((float)model->numtextures*30/total_textures)/100)*(call->end-call->start)+call->start;
+        call->loadcallback(procent,afis); // textures represent 30% from the model (just saying :))
+    }
 
+    model->numtextures++;
+    model->textures = (GLMtexture *)realloc(model->textures, sizeof(GLMtexture)*model->numtextures);
+    model->textures[model->numtextures-1].name = strdup(numefis);
+    model->textures[model->numtextures-1].id = 0;
+    model->textures[model->numtextures-1].width = 0;
+    model->textures[model->numtextures-1].height = 0;
+    model->textures[model->numtextures-1].target = GL_TEXTURE_2D;
+    model->textures[model->numtextures-1].layer = 0;
+    if (load)
+        glmUploadTexture(model, &model->textures[model->numtextures-1]);
 
+    return model->numtextures-1;
+}
 
-/* glmReadMTL: read a wavefront material library file
+/* glmReadMTL: read a wavefront material library file.  Returns
+ * GL_FALSE if the file can't be opened.
  *
- * model - properly initialized GLMmodel structure
- * name  - name of the material library
+ * model    - properly initialized GLMmodel structure
+ * name     - name of the material library
+ * textures - load the textures, or only name them for glmLoadTextures
  */
-static GLvoid
-glmReadMTL(GLMmodel *model, char *name, mycallback *call)
+static GLboolean
+glmReadMTL(GLMmodel *model, char *name, mycallback *call, GLboolean textures)
 {
     FILE *file;
     char *dir;
@@ -322,7 +407,8 @@ glmReadMTL(GLMmodel *model, char *name, mycallback *call)
     if (!file) {
         fprintf(stderr, "glmReadMTL() failed: can't open material file \"%s\".\n",
                 filename);
-        exit(1);
+        free(filename);
+        return GL_FALSE;
     }
     free(filename);
 
@@ -427,7 +513,7 @@ glmReadMTL(GLMmodel *model, char *name, mycallback *call)
             if (strncmp(buf, "map_Kd", 6) == 0) {
                 char afis[180];
                 sprintf(afis,"Loading Textures (%s)...",textura);
-                model->materials[nummaterials].IDTextura = glmFindOrAddTexture(model, textura,call);
+                model->materials[nummaterials].IDTextura = glmFindOrAddTexture(model, textura,call, textures);
                 free(textura);
             } else {
                 //printf("map %s %s ignored",buf,t_filename);
@@ -441,6 +527,9 @@ glmReadMTL(GLMmodel *model, char *name, mycallback *call)
             break;
         }
     }
+
+    fclose(file);
+    return GL_TRUE;
 }
 
 /* glmWriteMTL: write a wavefront material library file
@@ -499,12 +588,14 @@ glmWriteMTL(GLMmodel *model, char *modelpath, char *mtllibname)
 
 
 /* glmFirstPass: first pass at a Wavefront OBJ file that gets all the
- * statistics of the model (such as #vertices, #normals, etc)
+ * statistics of the model (such as #vertices, #normals, etc).  Returns
+ * GL_FALSE on an unknown token or a material library that can't be read.
  *
- * model - properly initialized GLMmodel structure
- * file  - (fopen'd) file descriptor
+ * model    - properly initialized GLMmodel structure
+ * file     - (fopen'd) file descriptor
+ * textures - load the textures of the material library
  */
-static GLvoid glmFirstPass(GLMmodel *model, FILE *file, mycallback *call)
+static GLboolean glmFirstPass(GLMmodel *model, FILE *file, mycallback *call, GLboolean textures)
 {
     GLuint  numvertices;        /* number of vertices in model */
     GLuint  numnormals;         /* number of normals in model */
@@ -542,16 +633,16 @@ static GLvoid glmFirstPass(GLMmodel *model, FILE *file, mycallback *call)
                 numtexcoords++;
                 break;
             default:
-                printf("glmFirstPass(): Unknown token \"%s\".\n", buf);
-                exit(1);
-                break;
+                fprintf(stderr, "glmFirstPass() failed: unknown token \"%s\".\n", buf);
+                return GL_FALSE;
             }
             break;
         case 'm': //mtllib
             fgets(buf, sizeof(buf), file);
             sscanf(buf, "%s %s", buf, buf);
             model->mtllibname = strdup(buf);
-            glmReadMTL(model, buf, call);
+            if (!glmReadMTL(model, buf, call, textures))
+                return GL_FALSE;
             break;
         case 'u': //usemtl
             /* eat up rest of line */
@@ -635,6 +726,8 @@ static GLvoid glmFirstPass(GLMmodel *model, FILE *file, mycallback *call)
         group->numtriangles = 0;
         group = group->next;
     }
+
+    return GL_TRUE;
 }
 
 /* glmSecondPass: second pass at a Wavefront OBJ file that gets all
@@ -664,6 +757,9 @@ static GLvoid glmSecondPass(GLMmodel *model, FILE *file, mycallback *call)
     texcoords    = model->texcoords;
     group      = model->groups;
 
+    /* faces read without normals or texcoords keep index 0 (none) */
+    memset(model->triangles, 0, sizeof(GLMtriangle) * model->numtriangles);
+
     /* on the second pass through the file, read all the data into the
     allocated arrays */
     numvertices = numnormals = numtexcoords = 1;
@@ -772,8 +868,7 @@ static GLvoid glmSecondPass(GLMmodel *model, FILE *file, mycallback *call)
                 group->triangles[group->numtriangles++] = numtriangles;
                 numtriangles++;
                 while (fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
-                    if (n== 181228)
-                        T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
+                    T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
                     T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
                     T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
                     T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
@@ -850,6 +945,67 @@ static GLvoid glmSecondPass(GLMmodel *model, FILE *file, mycallback *call)
 /* public functions */
 
 
+/* glmBounds: Returns the bounding box of a model in model units.  The
+ * box is computed on the first call and cached until the vertices are
+ * changed by one of the glm functions.
+ *
+ * model  - initialized GLMmodel structure
+ * bounds - array of 6 GLfloats (min x, y, z followed by max x, y, z)
+ */
+GLvoid
+glmBounds(GLMmodel *model, GLfloat *bounds)
+{
+    GLuint    i, j, k;
+    GLfloat  *v, *m, w;
+    GLMgroup *group;
+
+    assert(model);
+    assert(model->vertices);
+    assert(bounds);
+
+    if (!model->boundsvalid && model->pointcloud) {
+        memcpy(model->bounds, model->pointcloud->bounds, sizeof(GLfloat) * 6);
+        model->boundsvalid = GL_TRUE;
+    } else if (!model->boundsvalid && !model->numvertices) {
+        memset(model->bounds, 0, sizeof(GLfloat) * 6);
+        model->boundsvalid = GL_TRUE;
+    } else if (!model->boundsvalid) {
+        /* get the max/mins */
+        model->bounds[0] = model->bounds[3] = model->vertices[3 + 0];
+        model->bounds[1] = model->bounds[4] = model->vertices[3 + 1];
+        model->bounds[2] = model->bounds[5] = model->vertices[3 + 2];
+        for (i = 2; i <= model->numvertices; i++) {
+            v = &model->vertices[3 * i];
+            if (model->bounds[0] > v[0]) model->bounds[0] = v[0];
+            if (model->bounds[3] < v[0]) model->bounds[3] = v[0];
+            if (model->bounds[1] > v[1]) model->bounds[1] = v[1];
+            if (model->bounds[4] < v[1]) model->bounds[4] = v[1];
+            if (model->bounds[2] > v[2]) model->bounds[2] = v[2];
+            if (model->bounds[5] < v[2]) model->bounds[5] = v[2];
+        }
+
+        /* instances no longer own vertices, place their prototype */
+        for (group = model->groups; group; group = group->next) {
+            if (!group->prototype)
+                continue;
+            m = group->transform;
+            for (i = 0; i < group->prototype->numtriangles; i++) {
+                for (j = 0; j < 3; j++) {
+                    v = &model->vertices[3 * T(group->prototype->triangles[i]).vindices[j]];
+                    for (k = 0; k < 3; k++) {
+                        w = m[k] * v[0] + m[4 + k] * v[1] + m[8 + k] * v[2] + m[12 + k];
+                        if (model->bounds[k] > w) model->bounds[k] = w;
+                        if (model->bounds[3 + k] < w) model->bounds[3 + k] = w;
+                    }
+                }
+            }
+        }
+        model->boundsvalid = GL_TRUE;
+    }
+
+    memcpy(bounds, model->bounds, sizeof(GLfloat) * 6);
+}
+
 /* glmUnitize: "unitize" a model by translating it to the origin and
  * scaling it to fit in a unit cube around the origin.   Returns the
  * scalefactor used.
@@ -860,43 +1016,24 @@ GLfloat
 glmUnitize(GLMmodel *model)
 {
     GLuint  i;
-    GLfloat maxx, minx, maxy, miny, maxz, minz;
+    GLfloat bounds[6];
     GLfloat cx, cy, cz, w, h, d;
-    GLfloat scale;
+    GLfloat scale, offset[3];
 
     assert(model);
     assert(model->vertices);
 
-    /* get the max/mins */
-    maxx = minx = model->vertices[3 + 0];
-    maxy = miny = model->vertices[3 + 1];
-    maxz = minz = model->vertices[3 + 2];
-    for (i = 1; i <= model->numvertices; i++) {
-        if (maxx < model->vertices[3 * i + 0])
-            maxx = model->vertices[3 * i + 0];
-        if (minx > model->vertices[3 * i + 0])
-            minx = model->vertices[3 * i + 0];
-
-        if (maxy < model->vertices[3 * i + 1])
-            maxy = model->vertices[3 * i + 1];
-        if (miny > model->vertices[3 * i + 1])
-            miny = model->vertices[3 * i + 1];
-
-        if (maxz < model->vertices[3 * i + 2])
-            maxz = model->vertices[3 * i + 2];
-        if (minz > model->vertices[3 * i + 2])
-            minz = model->vertices[3 * i + 2];
-    }
+    glmBounds(model, bounds);
 
     /* calculate model width, height, and depth */
-    w = glmAbs(maxx) + glmAbs(minx);
-    h = glmAbs(maxy) + glmAbs(miny);
-    d = glmAbs(maxz) + glmAbs(minz);
+    w = bounds[3] - bounds[0];
+    h = bounds[4] - bounds[1];
+    d = bounds[5] - bounds[2];
 
     /* calculate center of the model */
-    cx = (maxx + minx) / 2.0;
-    cy = (maxy + miny) / 2.0;
-    cz = (maxz + minz) / 2.0;
+    cx = (bounds[3] + bounds[0]) / 2.0;
+    cy = (bounds[4] + bounds[1]) / 2.0;
+    cz = (bounds[5] + bounds[2]) / 2.0;
 
     /* calculate unitizing scale factor */
     scale = 2.0 / glmMax(glmMax(w, h), d);
@@ -910,10 +1047,65 @@ glmUnitize(GLMmodel *model)
         model->vertices[3 * i + 1] *= scale;
         model->vertices[3 * i + 2] *= scale;
     }
+    if (model->pointcloud) {
+        offset[0] = -cx;
+        offset[1] = -cy;
+        offset[2] = -cz;
+        glmMovePoints(model->pointcloud, offset, scale);
+    }
+    model->boundsvalid = GL_FALSE;
+    model->buffermode = GLM_NOBUFFERS;
 
     return scale;
 }
 
+/* glmUnitizeTransform: "unitize" a model like glmUnitize, but without
+ * touching the vertices.  The translation and scale are stored in the
+ * model transform (position, scale) and applied at draw time by
+ * glmApplyTransform.  Returns the scalefactor used.
+ *
+ * model - properly initialized GLMmodel structure
+ */
+GLfloat
+glmUnitizeTransform(GLMmodel *model)
+{
+    GLfloat bounds[6];
+    GLfloat w, h, d;
+
+    assert(model);
+
+    glmBounds(model, bounds);
+
+    w = bounds[3] - bounds[0];
+    h = bounds[4] - bounds[1];
+    d = bounds[5] - bounds[2];
+
+    /* position is applied before the scale, so it stays in model units */
+    model->position[0] = -(bounds[3] + bounds[0]) / 2.0;
+    model->position[1] = -(bounds[4] + bounds[1]) / 2.0;
+    model->position[2] = -(bounds[5] + bounds[2]) / 2.0;
+    model->scale = 2.0 / glmMax(glmMax(w, h), d);
+
+    return model->scale;
+}
+
+/* glmApplyTransform: Multiplies the current OpenGL matrix by the model
+ * transform (rotation, scale and position, in that order).
+ *
+ * model - properly initialized GLMmodel structure
+ */
+GLvoid
+glmApplyTransform(GLMmodel *model)
+{
+    assert(model);
+
+    glRotatef(model->rotation[0], 1.0, 0.0, 0.0);
+    glRotatef(model->rotation[1], 0.0, 1.0, 0.0);
+    glRotatef(model->rotation[2], 0.0, 0.0, 1.0);
+    glScalef(model->scale, model->scale, model->scale);
+    glTranslatef(model->position[0], model->position[1], model->position[2]);
+}
+
 /* glmDimensions: Calculates the dimensions (width, height, depth) of
  * a model.
  *
@@ -923,38 +1115,18 @@ glmUnitize(GLMmodel *model)
 GLvoid
 glmDimensions(GLMmodel *model, GLfloat *dimensions)
 {
-    GLuint i;
-    GLfloat maxx, minx, maxy, miny, maxz, minz;
+    GLfloat bounds[6];
 
     assert(model);
     assert(model->vertices);
     assert(dimensions);
 
-    /* get the max/mins */
-    maxx = minx = model->vertices[3 + 0];
-    maxy = miny = model->vertices[3 + 1];
-    maxz = minz = model->vertices[3 + 2];
-    for (i = 1; i <= model->numvertices; i++) {
-        if (maxx < model->vertices[3 * i + 0])
-            maxx = model->vertices[3 * i + 0];
-        if (minx > model->vertices[3 * i + 0])
-            minx = model->vertices[3 * i + 0];
-
-        if (maxy < model->vertices[3 * i + 1])
-            maxy = model->vertices[3 * i + 1];
-        if (miny > model->vertices[3 * i + 1])
-            miny = model->vertices[3 * i + 1];
-
-        if (maxz < model->vertices[3 * i + 2])
-            maxz = model->vertices[3 * i + 2];
-        if (minz > model->vertices[3 * i + 2])
-            minz = model->vertices[3 * i + 2];
-    }
+    glmBounds(model, bounds);
 
     /* calculate model width, height, and depth */
-    dimensions[0] = glmAbs(maxx) + glmAbs(minx);
-    dimensions[1] = glmAbs(maxy) + glmAbs(miny);
-    dimensions[2] = glmAbs(maxz) + glmAbs(minz);
+    dimensions[0] = bounds[3] - bounds[0];
+    dimensions[1] = bounds[4] - bounds[1];
+    dimensions[2] = bounds[5] - bounds[2];
 }
 
 /* glmScale: Scales a model by a given amount.
@@ -966,12 +1138,17 @@ GLvoid
 glmScale(GLMmodel *model, GLfloat scale)
 {
     GLuint i;
+    GLfloat offset[3] = { 0.0, 0.0, 0.0 };
 
     for (i = 1; i <= model->numvertices; i++) {
         model->vertices[3 * i + 0] *= scale;
         model->vertices[3 * i + 1] *= scale;
         model->vertices[3 * i + 2] *= scale;
     }
+    if (model->pointcloud)
+        glmMovePoints(model->pointcloud, offset, scale);
+    model->boundsvalid = GL_FALSE;
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 /* glmReverseWinding: Reverse the polygon winding for all polygons in
@@ -1018,6 +1195,7 @@ glmReverseWinding(GLMmodel *model)
         model->normals[3 * i + 1] = -model->normals[3 * i + 1];
         model->normals[3 * i + 2] = -model->normals[3 * i + 2];
     }
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 /* glmFacetNormals: Generates facet normals for a model (by taking the
@@ -1065,6 +1243,7 @@ glmFacetNormals(GLMmodel *model)
         glmCross(u, v, &model->facetnorms[3 * (i+1)]);
         glmNormalize(&model->facetnorms[3 * (i+1)]);
     }
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 /* glmVertexNormals: Generates smooth vertex normals for a model.
@@ -1237,6 +1416,7 @@ glmVertexNormals(GLMmodel *model, GLfloat angle)
         model->normals[3 * i + 2] = normals[3 * i + 2];
     }
     free(normals);
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 GLvoid
@@ -1281,6 +1461,7 @@ glmLinearTexture(GLMmodel *model)
     printf("glmLinearTexture(): generated %d linear texture coordinates\n",
            model->numtexcoords);
 #endif
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 /* glmSpheremapTexture: Generates texture coordinates according to a
@@ -1345,6 +1526,7 @@ glmSpheremapTexture(GLMmodel *model)
         }
         group = group->next;
     }
+    model->buffermode = GLM_NOBUFFERS;
 }
 
 /* glmDelete: Deletes a GLMmodel structure.
@@ -1359,6 +1541,8 @@ glmDelete(GLMmodel *model)
 
     assert(model);
 
+    glmDeleteBuffers(model);
+    if (model->instances)    free(model->instances);
     if (model->pathname)     free(model->pathname);
     if (model->mtllibname) free(model->mtllibname);
     if (model->vertices)     free(model->vertices);
@@ -1374,11 +1558,15 @@ glmDelete(GLMmodel *model)
     if (model->textures) {
         for (i = 0; i < model->numtextures; i++) {
             free(model->textures[i].name);
-            glDeleteTextures(1,&model->textures[i].id);
+            if (model->texturecache)
+                glmReleaseTexture(model->texturecache, &model->textures[i]);
+            else if (model->textures[i].id)
+                glDeleteTextures(1,&model->textures[i].id);
         }
         free(model->textures);
     }
 
+    glmDeleteLODs(model);
     while (model->groups) {
         group = model->groups;
         model->groups = model->groups->next;
@@ -1386,15 +1574,29 @@ glmDelete(GLMmodel *model)
         free(group->triangles);
         free(group);
     }
+    if (model->visiblegroups)
+        free(model->visiblegroups);
+    if (model->pointcloud) {
+        free(model->pointcloud->points);
+        free(model->pointcloud->nodes);
+        free(model->pointcloud);
+    }
 
     free(model);
 }
 
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
- * glmDelete().
+ * glmDelete(), or NULL if the file or its material library can't be
+ * read.
  *
- * filename - name of the file containing the Wavefront .OBJ format data.
+ * A file with vertices but no faces is read as a point cloud, at most
+ * maxpoints of them (see glm.h).
+ *
+ * filename  - name of the file containing the Wavefront .OBJ format data.
+ * textures  - GL_FALSE to leave the textures for glmLoadTextures, so that
+ *             the model can be read without a current context.
+ * maxpoints - points of a point cloud to keep
  */
 
 GLMmodel *glmReadOBJ(char *filename)
@@ -1402,6 +1604,14 @@ GLMmodel *glmReadOBJ(char *filename)
     return glmReadOBJ(filename,0);
 }
 GLMmodel *glmReadOBJ(char *filename,mycallback *call)
+{
+    return glmReadOBJ(filename,call,GL_TRUE);
+}
+GLMmodel *glmReadOBJ(char *filename,mycallback *call,GLboolean textures)
+{
+    return glmReadOBJ(filename,call,textures,GLM_MAXPOINTS);
+}
+GLMmodel *glmReadOBJ(char *filename,mycallback *call,GLboolean textures,GLuint maxpoints)
 {
     GLMmodel *model;
     FILE   *file;
@@ -1411,7 +1621,7 @@ GLMmodel *glmReadOBJ(char *filename,mycallback *call)
     if (!file) {
         fprintf(stderr, "glmReadOBJ() failed: can't open data file \"%s\".\n",
                 filename);
-        exit(1);
+        return NULL;
     }
 
     /* allocate a new model */
@@ -1431,16 +1641,57 @@ GLMmodel *glmReadOBJ(char *filename,mycallback *call)
     model->nummaterials  = 0;
     model->materials       = NULL;
     model->numtextures  = 0;
+    model->numtexturearrays = 0;
+    model->texturecache  = NULL;
+    model->numlods       = 0;
+    model->lodtolerance  = 0.0;
+    memset(model->lodtriangles, 0, sizeof(model->lodtriangles));
     model->textures       = NULL;
     model->numgroups       = 0;
     model->groups      = NULL;
     model->position[0]   = 0.0;
     model->position[1]   = 0.0;
     model->position[2]   = 0.0;
+    model->rotation[0]   = 0.0;
+    model->rotation[1]   = 0.0;
+    model->rotation[2]   = 0.0;
+    model->scale         = 1.0;
+    model->boundsvalid   = GL_FALSE;
+    model->buffermode    = GLM_NOBUFFERS;
+    model->vertexbuffer  = 0;
+    model->indexbuffer   = 0;
+    model->numbatches    = 0;
+    model->batches       = NULL;
+    model->batchcounts   = NULL;
+    model->batchoffsets  = NULL;
+    model->batchserial   = 0;
+    model->visiblegroups = NULL;
+    model->visibleserial = 0;
+    model->numdrawgroups = 0;
+    model->numdrawcalls  = 0;
+    model->numinstances  = 0;
+    model->instances     = NULL;
+    model->instancebuffer = 0;
+    model->instancesvalid = GL_FALSE;
+    model->materialbuffer = 0;
+    model->pointcloud    = NULL;
+    model->pointbudget   = 1000000;
+    model->numdrawpoints = 0;
 
     /* make a first pass through the file to get a count of the number
     of vertices, normals, texcoords & triangles */
-    glmFirstPass(model, file, call);
+    if (!glmFirstPass(model, file, call, textures)) {
+        fclose(file);
+        glmDelete(model);
+        return NULL;
+    }
+
+    /* vertices without faces are the points of a scan, kept apart */
+    if (model->numvertices && !model->numtriangles) {
+        rewind(file);
+        glmReadPoints(model, file, maxpoints);
+        model->numvertices = model->numnormals = model->numtexcoords = 0;
+    }
 
     /* allocate memory */
     model->vertices = (GLfloat *)malloc(sizeof(GLfloat) *
@@ -1459,7 +1710,8 @@ GLMmodel *glmReadOBJ(char *filename,mycallback *call)
     /* rewind to beginning of file and read in the data this pass */
     rewind(file);
 
-    glmSecondPass(model, file,call);
+    if (!model->pointcloud)
+        glmSecondPass(model, file,call);
 
     /* close the file */
     fclose(file);
@@ -1467,6 +1719,135 @@ GLMmodel *glmReadOBJ(char *filename,mycallback *call)
     return model;
 }
 
+/* glmLoadTextures: Loads the textures a model was read without.
+ * Returns the number of textures loaded.
+ *
+ * model - initialized GLMmodel structure, its context current
+ */
+GLuint
+glmLoadTextures(GLMmodel *model)
+{
+    GLuint i, numloaded;
+
+    assert(model);
+
+    numloaded = 0;
+    for (i = 0; i < model->numtextures; i++) {
+        if (model->textures[i].id)
+            continue;
+        glmUploadTexture(model, &model->textures[i]);
+        if (model->textures[i].id)
+            numloaded++;
+    }
+
+    return numloaded;
+}
+
+GLuint
+glmLoadTextures(GLMmodel *model, GLMtexturecache *cache)
+{
+    GLMtexture *texture;
+    GLMcachedtexture *cached;
+    char *filename;
+    GLuint i, j, numloaded;
+
+    assert(model);
+    assert(cache);
+
+    if (model->texturecache != cache) {
+        for (i = 0; i < model->numtextures; i++) {
+            if (model->textures[i].id) {
+                printf("glmLoadTextures() warning: model has textures of its own, "
+                       "not sharing them.\n");
+                return glmLoadTextures(model);
+            }
+        }
+        model->texturecache = cache;
+    }
+
+    numloaded = 0;
+    for (i = 0; i < model->numtextures; i++) {
+        texture = &model->textures[i];
+        if (texture->id)
+            continue;
+
+        filename = glmTexturePath(model, texture->name);
+        for (j = 0; j < cache->numtextures; j++) {
+            if (!strcmp(cache->textures[j].filename, filename))
+                break;
+        }
+        if (j == cache->numtextures) {
+            glmUploadTexture(model, texture);
+            if (!texture->id) {
+                free(filename);
+                continue;
+            }
+            cache->numtextures++;
+            cache->textures = (GLMcachedtexture *)realloc(cache->textures,
+                              sizeof(GLMcachedtexture) * cache->numtextures);
+            cached = &cache->textures[j];
+            cached->filename = filename;
+            cached->id = texture->id;
+            cached->width = texture->width;
+            cached->height = texture->height;
+            cached->target = texture->target;
+            cached->layer = texture->layer;
+            cached->references = 0;
+            numloaded++;
+        } else {
+            free(filename);
+        }
+
+        cached = &cache->textures[j];
+        cached->references++;
+        texture->id = cached->id;
+        texture->width = cached->width;
+        texture->height = cached->height;
+        texture->target = cached->target;
+        texture->layer = cached->layer;
+
+        /* layers packed for another model, counted once per array */
+        if (texture->target == GL_TEXTURE_2D_ARRAY) {
+            for (j = 0; j < i; j++) {
+                if (model->textures[j].id == texture->id)
+                    break;
+            }
+            if (j == i)
+                model->numtexturearrays++;
+        }
+    }
+
+    return numloaded;
+}
+
+GLMtexturecache *
+glmNewTextureCache(GLvoid)
+{
+    GLMtexturecache *cache;
+
+    cache = (GLMtexturecache *)malloc(sizeof(GLMtexturecache));
+    cache->numtextures = 0;
+    cache->textures = NULL;
+
+    return cache;
+}
+
+GLvoid
+glmDeleteTextureCache(GLMtexturecache *cache)
+{
+    GLuint i;
+
+    assert(cache);
+
+    /* deleting an array again with its other layers is ignored */
+    for (i = 0; i < cache->numtextures; i++) {
+        free(cache->textures[i].filename);
+        glDeleteTextures(1, &cache->textures[i].id);
+    }
+    free(cache->textures);
+    free(cache);
+}
+
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
  *
@@ -1485,9 +1866,13 @@ GLMmodel *glmReadOBJ(char *filename,mycallback *call)
 GLvoid
 glmWriteOBJ(GLMmodel *model, char *filename, GLuint mode)
 {
-    GLuint  i;
+    GLuint  i, j, k;
     FILE   *file;
     GLMgroup *group;
+    GLMtriangle *triangle, placed;
+    GLuint  *vertexmap, *vertexstamp, *normalmap, *normalstamp;
+    GLuint  numvertices, numnormals, numinstances;
+    GLfloat *m, *v, w[3], d;
     assert(model);
 
     /* do a bit of warning */
@@ -1574,7 +1959,7 @@ glmWriteOBJ(GLMmodel *model, char *filename, GLuint mode)
     } else if (mode & GLM_FLAT) {
         fprintf(file, "\n");
         fprintf(file, "# %d normals\n", model->numfacetnorms);
-        for (i = 1; i <= model->numnormals; i++) {
+        for (i = 1; i <= model->numfacetnorms; i++) {
             fprintf(file, "vn %f %f %f\n",
                     model->facetnorms[3 * i + 0],
                     model->facetnorms[3 * i + 1],
@@ -1598,291 +1983,2821 @@ glmWriteOBJ(GLMmodel *model, char *filename, GLuint mode)
     fprintf(file, "# %d faces (triangles)\n", model->numtriangles);
     fprintf(file, "\n");
 
+    /* instances are written as the faces of their prototype, with its
+       vertices (and normals) placed by the transform of the instance
+       ahead of them; the maps give the index written for each */
+    numvertices = model->numvertices;
+    numnormals = (mode & GLM_SMOOTH) ? model->numnormals :
+                 (mode & GLM_FLAT) ? model->numfacetnorms : 0;
+    vertexmap = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    vertexstamp = (GLuint *)calloc(model->numvertices + 1, sizeof(GLuint));
+    normalmap = (GLuint *)malloc(sizeof(GLuint) * (numnormals + 1));
+    normalstamp = (GLuint *)calloc(numnormals + 1, sizeof(GLuint));
+    numinstances = 0;
+
     group = model->groups;
     while (group) {
+        if (group->prototype) {
+            numinstances++;
+            m = group->transform;
+            for (i = 0; i < group->prototype->numtriangles; i++) {
+                triangle = &T(group->prototype->triangles[i]);
+                for (j = 0; j < 3; j++) {
+                    k = triangle->vindices[j];
+                    if (vertexstamp[k] == numinstances)
+                        continue;
+                    vertexstamp[k] = numinstances;
+                    vertexmap[k] = ++numvertices;
+                    v = &model->vertices[3 * k];
+                    fprintf(file, "v %f %f %f\n",
+                            m[0] * v[0] + m[4] * v[1] + m[8] * v[2] + m[12],
+                            m[1] * v[0] + m[5] * v[1] + m[9] * v[2] + m[13],
+                            m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14]);
+                }
+                for (j = 0; j < 3 && mode & (GLM_SMOOTH | GLM_FLAT); j++) {
+                    k = (mode & GLM_SMOOTH) ? triangle->nindices[j] : triangle->findex;
+                    if (!k || (mode & GLM_SMOOTH && k > model->numnormals))
+                        continue;
+                    if (normalstamp[k] == numinstances)
+                        continue;
+                    normalstamp[k] = numinstances;
+                    normalmap[k] = ++numnormals;
+                    v = (mode & GLM_SMOOTH) ? &model->normals[3 * k] : &model->facetnorms[3 * k];
+                    w[0] = m[0] * v[0] + m[4] * v[1] + m[8] * v[2];
+                    w[1] = m[1] * v[0] + m[5] * v[1] + m[9] * v[2];
+                    w[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2];
+                    d = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+                    if (d > 0.0)
+                        d = 1.0 / d;
+                    fprintf(file, "vn %f %f %f\n", w[0] * d, w[1] * d, w[2] * d);
+                }
+            }
+        }
+
         fprintf(file, "g %s\n", group->name);
         if (mode & GLM_MATERIAL)
             fprintf(file, "usemtl %s\n", model->materials[group->material].name);
-        for (i = 0; i < group->numtriangles; i++) {
+        for (i = 0; i < (group->prototype ? group->prototype->numtriangles : group->numtriangles); i++) {
+            if (group->prototype) {
+                placed = T(group->prototype->triangles[i]);
+                for (j = 0; j < 3; j++) {
+                    placed.vindices[j] = vertexmap[placed.vindices[j]];
+                    k = placed.nindices[j];
+                    if (mode & GLM_SMOOTH && k && k <= model->numnormals)
+                        placed.nindices[j] = normalmap[k];
+                }
+                if (mode & GLM_FLAT && placed.findex)
+                    placed.findex = normalmap[placed.findex];
+                triangle = &placed;
+            } else {
+                triangle = &T(group->triangles[i]);
+            }
             if (mode & GLM_SMOOTH && mode & GLM_TEXTURE) {
                 fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).nindices[0],
-                        T(group->triangles[i]).tindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).nindices[1],
-                        T(group->triangles[i]).tindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).nindices[2],
-                        T(group->triangles[i]).tindices[2]);
+                        triangle->vindices[0],
+                        triangle->nindices[0],
+                        triangle->tindices[0],
+                        triangle->vindices[1],
+                        triangle->nindices[1],
+                        triangle->tindices[1],
+                        triangle->vindices[2],
+                        triangle->nindices[2],
+                        triangle->tindices[2]);
             } else if (mode & GLM_FLAT && mode & GLM_TEXTURE) {
                 fprintf(file, "f %d/%d %d/%d %d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).findex);
+                        triangle->vindices[0],
+                        triangle->findex,
+                        triangle->vindices[1],
+                        triangle->findex,
+                        triangle->vindices[2],
+                        triangle->findex);
             } else if (mode & GLM_TEXTURE) {
                 fprintf(file, "f %d/%d %d/%d %d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).tindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).tindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).tindices[2]);
+                        triangle->vindices[0],
+                        triangle->tindices[0],
+                        triangle->vindices[1],
+                        triangle->tindices[1],
+                        triangle->vindices[2],
+                        triangle->tindices[2]);
             } else if (mode & GLM_SMOOTH) {
                 fprintf(file, "f %d//%d %d//%d %d//%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).nindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).nindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).nindices[2]);
+                        triangle->vindices[0],
+                        triangle->nindices[0],
+                        triangle->vindices[1],
+                        triangle->nindices[1],
+                        triangle->vindices[2],
+                        triangle->nindices[2]);
             } else if (mode & GLM_FLAT) {
                 fprintf(file, "f %d//%d %d//%d %d//%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).findex);
+                        triangle->vindices[0],
+                        triangle->findex,
+                        triangle->vindices[1],
+                        triangle->findex,
+                        triangle->vindices[2],
+                        triangle->findex);
             } else {
                 fprintf(file, "f %d %d %d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).vindices[2]);
+                        triangle->vindices[0],
+                        triangle->vindices[1],
+                        triangle->vindices[2]);
             }
         }
         fprintf(file, "\n");
         group = group->next;
     }
 
+    free(vertexmap);
+    free(vertexstamp);
+    free(normalmap);
+    free(normalstamp);
     fclose(file);
 }
 
-/* glmDraw: Renders the model to the current OpenGL context using the
- * mode specified.
- *
- * model - initialized GLMmodel structure
- * mode  - a bitwise OR of values describing what is to be rendered.
- *             GLM_NONE     -  render with only vertices
- *             GLM_FLAT     -  render with facet normals
- *             GLM_SMOOTH   -  render with vertex normals
- *             GLM_TEXTURE  -  render with texture coords
- *             GLM_COLOR    -  render with colors (color material)
- *             GLM_MATERIAL -  render with materials
- *             GLM_COLOR and GLM_MATERIAL should not both be specified.
- *             GLM_FLAT and GLM_SMOOTH should not both be specified.
- */
-
-GLvoid glmDraw(GLMmodel *model, GLuint mode)
+/* glmMaterialEqual: returns GL_TRUE if two materials have the same
+ * lighting parameters */
+static GLboolean
+glmMaterialEqual(GLMmaterial *a, GLMmaterial *b)
 {
-    glmDraw(model,mode,0);
+    return (!memcmp(a->diffuse, b->diffuse, sizeof(a->diffuse)) &&
+            !memcmp(a->ambient, b->ambient, sizeof(a->ambient)) &&
+            !memcmp(a->specular, b->specular, sizeof(a->specular)) &&
+            a->shininess == b->shininess) ? GL_TRUE : GL_FALSE;
 }
-GLvoid glmDraw(GLMmodel *model, GLuint mode,char *drawonly)
+
+/* glmSetState: sets the material and texture of a group, skipping
+ * whatever is unchanged since the previous group.
+ *
+ * lastmaterial, lasttexture - state set last, updated on return
+ */
+static GLvoid
+glmSetState(GLMmodel *model, GLMgroup *group, GLuint mode,
+            GLMmaterial **lastmaterial, GLuint *lasttexture)
 {
-    static GLuint i;
-    static GLMgroup *group;
-    static GLMtriangle *triangle;
-    static GLMmaterial *material;
+    GLMmaterial *material;
+    GLMtexture *texture;
     GLuint IDTextura;
 
-    assert(model);
-    assert(model->vertices);
+    material = &model->materials[group->material];
+    if (material)
+        IDTextura = material->IDTextura;
+    else IDTextura=-1;
 
-    /* do a bit of warning */
-    if (mode & GLM_FLAT && !model->facetnorms) {
-        printf("glmDraw() warning: flat render mode requested "
-               "with no facet normals defined.\n");
-        mode &= ~GLM_FLAT;
-    }
-    if (mode & GLM_SMOOTH && !model->normals) {
-        printf("glmDraw() warning: smooth render mode requested "
-               "with no normals defined.\n");
-        mode &= ~GLM_SMOOTH;
-    }
-    if (mode & GLM_TEXTURE && !model->texcoords) {
-        printf("glmDraw() warning: texture render mode requested "
-               "with no texture coordinates defined.\n");
-        mode &= ~GLM_TEXTURE;
+    if (material && material != *lastmaterial &&
+            (!*lastmaterial || !glmMaterialEqual(material, *lastmaterial))) {
+        if (mode & GLM_MATERIAL) {
+            glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+            glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+            glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+        }
+
+        if (mode & GLM_COLOR) {
+            glColor3fv(material->diffuse);
+        }
+        *lastmaterial = material;
     }
-    if (mode & GLM_FLAT && mode & GLM_SMOOTH) {
-        printf("glmDraw() warning: flat render mode requested "
-               "and smooth render mode requested (using smooth).\n");
-        mode &= ~GLM_FLAT;
+
+    /* textures packed in the same array need no new bind */
+    texture = (IDTextura == (GLuint)-1) ? NULL : &model->textures[IDTextura];
+    if ((mode & GLM_TEXTURE) && (texture ? texture->id : 0) != *lasttexture) {
+        if (!texture)
+            glBindTexture(GL_TEXTURE_2D, 0);
+        else if (texture->target == GL_TEXTURE_2D_ARRAY) {
+            pglActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture->id);
+            pglActiveTexture(GL_TEXTURE0);
+        } else
+            glBindTexture(GL_TEXTURE_2D, texture->id);
+        *lasttexture = texture ? texture->id : 0;
     }
-    if (mode & GLM_COLOR && !model->materials) {
+}
+
+/* glmGroupTexture: returns the texture a group is drawn with, or NULL */
+static GLMtexture *
+glmGroupTexture(GLMmodel *model, GLMgroup *group)
+{
+    GLuint IDTextura;
+
+    if (!model->materials || group->material >= model->nummaterials)
+        return NULL;
+    IDTextura = model->materials[group->material].IDTextura;
+    if (IDTextura == (GLuint)-1 || IDTextura >= model->numtextures)
+        return NULL;
+    return &model->textures[IDTextura];
+}
+
+/* GLMvertex: Structure that defines a vertex in the vertex buffer.
+ */
+typedef struct _GLMvertex {
+    GLfloat texcoord[3];          /* s, t and texture array layer */
+    GLfloat normal[3];
+    GLfloat position[3];
+} GLMvertex;
+
+/* glmFreeBatches: releases the draw batches of a model */
+static GLvoid
+glmFreeBatches(GLMmodel *model)
+{
+    if (model->batches)
+        free(model->batches);
+    if (model->batchcounts)
+        free(model->batchcounts);
+    if (model->batchoffsets)
+        free(model->batchoffsets);
+    model->batches = NULL;
+    model->batchcounts = NULL;
+    model->batchoffsets = NULL;
+    model->numbatches = 0;
+}
+
+/* glmSameState: returns GL_TRUE if two groups are drawn with the same
+ * material and texture in the given mode */
+static GLboolean
+glmSameState(GLMmodel *model, GLMgroup *a, GLMgroup *b, GLuint mode)
+{
+    GLMmaterial *ma, *mb;
+    GLMtexture  *ta, *tb;
+
+    if (!model->materials || a->material == b->material)
+        return GL_TRUE;
+    ma = &model->materials[a->material];
+    mb = &model->materials[b->material];
+    ta = glmGroupTexture(model, a);
+    tb = glmGroupTexture(model, b);
+    if (mode & GLM_TEXTURE && (ta ? ta->id : 0) != (tb ? tb->id : 0))
+        return GL_FALSE;
+    if (mode & (GLM_COLOR | GLM_MATERIAL) && !glmMaterialEqual(ma, mb))
+        return GL_FALSE;
+    return GL_TRUE;
+}
+
+/* glmBuildBatches: collects the groups to be drawn into batches of
+ * index ranges.  Runs of groups with the same state become one batch,
+ * and ranges that follow each other in the index buffer are merged.
+ * Instances keep a batch of their own, since they need a transform.
+ * Each group is drawn at its level of detail (group->lod), and hidden
+ * groups are left out.  Must be called after glmBuildBuffers.
+ *
+ * model - initialized GLMmodel structure
+ * mode  - render mode the buffers were built for
+ */
+static GLvoid
+glmBuildBatches(GLMmodel *model, GLuint mode)
+{
+    GLMgroup *group, *geometry, *last;
+    GLMbatch *batch;
+    GLuint    numranges, end, first, count, level;
+
+    glmFreeBatches(model);
+    memset(model->lodtriangles, 0, sizeof(model->lodtriangles));
+
+    /* at most one batch and one range per group */
+    model->batches = (GLMbatch *)malloc(sizeof(GLMbatch) * (model->numgroups + 1));
+    model->batchcounts = (GLsizei *)malloc(sizeof(GLsizei) * (model->numgroups + 1));
+    model->batchoffsets = (GLvoid **)malloc(sizeof(GLvoid *) * (model->numgroups + 1));
+    model->batchserial = model->visibleserial;
+
+    batch = NULL;
+    last = NULL;
+    numranges = 0;
+    end = (GLuint)-1;
+    model->numdrawgroups = 0;
+    for (group = model->groups; group; group = group->next) {
+        if (!VISIBLE(group))
+            continue;
+        geometry = group->prototype ? group->prototype : group;
+        level = group->lod <= geometry->numlods ? group->lod : 0;
+        if (level) {
+            first = geometry->lods[level - 1].first;
+            count = 3 * geometry->lods[level - 1].numtriangles;
+        } else {
+            first = geometry->first;
+            count = 3 * geometry->numtriangles;
+        }
+        if (!count)
+            continue;
+        model->numdrawgroups++;
+        model->lodtriangles[level] += count / 3;
+
+        if (!batch || group->prototype || last->prototype ||
+                !glmSameState(model, last, group, mode)) {
+            batch = &model->batches[model->numbatches++];
+            batch->group = group;
+            batch->first = numranges;
+            batch->numranges = 0;
+        } else if (first == end) {
+            /* continues the previous range */
+            model->batchcounts[numranges - 1] += count;
+            end += count;
+            last = group;
+            continue;
+        }
+
+        model->batchcounts[numranges] = count;
+        model->batchoffsets[numranges] = (GLvoid *)(sizeof(GLuint) * first);
+        numranges++;
+        batch->numranges++;
+        end = group->prototype ? (GLuint)-1 : first + count;
+        last = group;
+    }
+
+#if 0
+    printf("glmBuildBatches(): %d groups, %d batches, %d ranges\n",
+           model->numdrawgroups, model->numbatches, numranges);
+#endif
+}
+
+/* glmBuildBuffers: uploads the model into a vertex and an index buffer
+ * for the given (already validated) render mode.  In flat mode every
+ * triangle corner gets its own vertex carrying the facet normal; in the
+ * other modes corners sharing the same vertex/normal/texcoord indices
+ * share a vertex.  The triangles of each group are stored one after
+ * the other, starting at group->first, followed by the levels of
+ * detail level by level, so that neighbouring groups drawn at the same
+ * level still make one range.
+ *
+ * model - initialized GLMmodel structure
+ * mode  - render mode, as passed to glmDraw
+ */
+static GLvoid
+glmBuildBuffers(GLMmodel *model, GLuint mode)
+{
+    GLMgroup    *group;
+    GLMtriangle *triangle;
+    GLMlod      *lod;
+    GLMvertex   *vertices, *vertex;
+    GLuint      *indices, *hash, *keys;
+    GLMtexture  *texture;
+    GLuint       numvertices, numindices, numtriangles, hashsize, h, key[4];
+    GLuint       level, count, i, j;
+
+    if (!model->vertexbuffer) {
+        pglGenBuffers(1, &model->vertexbuffer);
+        pglGenBuffers(1, &model->indexbuffer);
+    }
+    model->buffermode = mode;
+    glmFreeBatches(model);
+
+    numtriangles = model->numtriangles;
+    for (group = model->groups; group; group = group->next) {
+        for (level = 0; level < group->numlods; level++)
+            numtriangles += group->lods[level].numtriangles;
+    }
+
+    vertices = (GLMvertex *)malloc(sizeof(GLMvertex) * (3 * numtriangles + 1));
+    indices = (GLuint *)malloc(sizeof(GLuint) * (3 * numtriangles + 1));
+
+    /* open addressing table of vertex index + 1 keyed by v/n/t/layer */
+    for (hashsize = 1; hashsize < 6 * numtriangles; hashsize <<= 1);
+    hash = (GLuint *)calloc(hashsize, sizeof(GLuint));
+    keys = (GLuint *)malloc(sizeof(GLuint) * 4 * (3 * numtriangles + 1));
+
+    numvertices = numindices = 0;
+    lod = NULL;
+    for (level = 0; level <= model->numlods; level++) {
+        for (group = model->groups; group; group = group->next) {
+            if (level > group->numlods)
+                continue;
+            if (level) {
+                lod = &group->lods[level - 1];
+                lod->first = numindices;
+                count = lod->numtriangles;
+            } else {
+                group->first = numindices;
+                count = group->numtriangles;
+            }
+            texture = (mode & GLM_TEXTURE) ? glmGroupTexture(model, group) : NULL;
+            key[3] = texture ? texture->layer : 0;
+            for (i = 0; i < count; i++) {
+                triangle = &T(level ? lod->triangles[i] : group->triangles[i]);
+                for (j = 0; j < 3; j++) {
+                    key[0] = level ? lod->vindices[3 * i + j] : triangle->vindices[j];
+                    /* index 0 is none for normals and texcoords */
+                    key[1] = (mode & GLM_SMOOTH) ? triangle->nindices[j] : 0;
+                    key[2] = (mode & GLM_TEXTURE) ? triangle->tindices[j] : 0;
+
+                    if (!(mode & GLM_FLAT)) {
+                        h = (key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u ^
+                             key[3] * 2654435761u) & (hashsize - 1);
+                        while (hash[h] && memcmp(&keys[4 * (hash[h] - 1)], key, sizeof(key)))
+                            h = (h + 1) & (hashsize - 1);
+                        if (hash[h]) {
+                            indices[numindices++] = hash[h] - 1;
+                            continue;
+                        }
+                        hash[h] = numvertices + 1;
+                        memcpy(&keys[4 * numvertices], key, sizeof(key));
+                    }
+
+                    vertex = &vertices[numvertices];
+                    memcpy(vertex->position, &model->vertices[3 * key[0]], sizeof(GLfloat) * 3);
+                    if (mode & GLM_FLAT)
+                        memcpy(vertex->normal, &model->facetnorms[3 * triangle->findex],
+                               sizeof(GLfloat) * 3);
+                    else if (key[1])
+                        memcpy(vertex->normal, &model->normals[3 * key[1]], sizeof(GLfloat) * 3);
+                    else
+                        vertex->normal[0] = vertex->normal[1] = vertex->normal[2] = 0.0;
+                    if (key[2])
+                        memcpy(vertex->texcoord, &model->texcoords[2 * key[2]], sizeof(GLfloat) * 2);
+                    else
+                        vertex->texcoord[0] = vertex->texcoord[1] = 0.0;
+                    vertex->texcoord[2] = (GLfloat)key[3];
+
+                    indices[numindices++] = numvertices++;
+                }
+            }
+        }
+    }
+    free(hash);
+    free(keys);
+
+    pglBindBuffer(GL_ARRAY_BUFFER, model->vertexbuffer);
+    pglBufferData(GL_ARRAY_BUFFER, sizeof(GLMvertex) * numvertices, vertices, GL_STATIC_DRAW);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->indexbuffer);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * numindices, indices, GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    free(vertices);
+    free(indices);
+
+#if 0
+    printf("glmBuildBuffers(): %d vertices, %d indices\n", numvertices, numindices);
+#endif
+}
+
+/* glmDeleteBuffers: Releases the buffer objects of a model; they are
+ * built again by the next glmDraw.  Requires the context the buffers
+ * were created in to be current.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmDeleteBuffers(GLMmodel *model)
+{
+    assert(model);
+
+    if (model->vertexbuffer) {
+        pglDeleteBuffers(1, &model->vertexbuffer);
+        pglDeleteBuffers(1, &model->indexbuffer);
+    }
+    if (model->instancebuffer)
+        pglDeleteBuffers(1, &model->instancebuffer);
+    if (model->materialbuffer)
+        pglDeleteBuffers(1, &model->materialbuffer);
+    if (model->pointcloud && model->pointcloud->pointbuffer) {
+        pglDeleteBuffers(1, &model->pointcloud->pointbuffer);
+        model->pointcloud->pointbuffer = 0;
+    }
+    model->vertexbuffer = model->indexbuffer = model->instancebuffer = 0;
+    model->materialbuffer = 0;
+    model->buffermode = GLM_NOBUFFERS;
+    model->instancesvalid = GL_FALSE;
+    glmFreeBatches(model);
+}
+
+/* glmAddInstance: Adds a copy of the model placed by the given
+ * transform.  Once a model has instances glmDraw draws one copy per
+ * instance instead of the model itself; with GLM_EXT_INSTANCING the
+ * copies come from a single instanced draw per batch.  Returns the
+ * index of the new instance.
+ *
+ * model     - initialized GLMmodel structure
+ * transform - 4x4 column-major matrix applied before the model's own
+ *             position/rotation/scale (rigid or uniformly scaled)
+ */
+GLuint
+glmAddInstance(GLMmodel *model, GLfloat *transform)
+{
+    assert(model);
+    assert(transform);
+
+    model->instances = (GLfloat *)realloc(model->instances,
+                                          sizeof(GLfloat) * 16 * (model->numinstances + 1));
+    memcpy(&model->instances[16 * model->numinstances], transform, sizeof(GLfloat) * 16);
+    model->instancesvalid = GL_FALSE;
+
+    return model->numinstances++;
+}
+
+/* glmClearInstances: Removes all instances, the model is drawn once
+ * again.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmClearInstances(GLMmodel *model)
+{
+    assert(model);
+
+    if (model->instances)
+        free(model->instances);
+    model->instances = NULL;
+    model->numinstances = 0;
+    model->instancesvalid = GL_FALSE;
+}
+
+/* glmShowGroup: Shows or hides a group.  Hidden groups are left out
+ * when the draw batches are built, so changing any number of groups
+ * costs a single rebuild at the next glmDraw.
+ *
+ * model   - initialized GLMmodel structure
+ * group   - group of the model
+ * visible - GL_TRUE to draw the group
+ */
+GLvoid
+glmShowGroup(GLMmodel *model, GLMgroup *group, GLboolean visible)
+{
+    GLuint bit;
+
+    assert(model);
+    assert(group);
+    assert(group->index < model->numgroups);
+
+    if ((VISIBLE(group) != 0) == (visible != GL_FALSE))
+        return;
+
+    bit = 1u << (group->index & 31);
+    if (visible)
+        model->visiblegroups[group->index >> 5] |= bit;
+    else
+        model->visiblegroups[group->index >> 5] &= ~bit;
+    model->visibleserial++;
+}
+
+/* glmShowAllGroups: Shows or hides every group of a model.
+ *
+ * model   - initialized GLMmodel structure
+ * visible - GL_TRUE to draw the groups
+ */
+GLvoid
+glmShowAllGroups(GLMmodel *model, GLboolean visible)
+{
+    assert(model);
+
+    if (!model->numgroups)
+        return;
+
+    memset(model->visiblegroups, visible ? 0xff : 0x00,
+           sizeof(GLuint) * ((model->numgroups + 31) >> 5));
+    model->visibleserial++;
+}
+
+/* glmGroupVisible: Returns GL_TRUE if a group is drawn.
+ *
+ * model - initialized GLMmodel structure
+ * group - group of the model
+ */
+GLboolean
+glmGroupVisible(GLMmodel *model, GLMgroup *group)
+{
+    assert(model);
+    assert(group);
+
+    return VISIBLE(group) ? GL_TRUE : GL_FALSE;
+}
+
+/* glmDrawImmediate: sends the groups of a model in immediate mode.
+ *
+ * lastmaterial, lasttexture - state set last (see glmSetState)
+ */
+static GLvoid
+glmDrawImmediate(GLMmodel *model, GLuint mode, GLMmaterial **lastmaterial, GLuint *lasttexture)
+{
+    GLuint i;
+    GLMgroup *group;
+    GLMgroup *geometry;
+    GLMtriangle *triangle;
+
+    group = model->groups;
+    while (group) {
+        if (!VISIBLE(group)) {
+            group = group->next;
+            continue;
+        }
+
+        glmSetState(model, group, mode, lastmaterial, lasttexture);
+
+        /* instances draw the triangles of their prototype */
+        geometry = group;
+        if (group->prototype) {
+            geometry = group->prototype;
+            glPushMatrix();
+            glMultMatrixf(group->transform);
+        }
+
+        model->numdrawgroups++;
+        model->numdrawcalls++;
+        glBegin(GL_TRIANGLES);
+        for (i = 0; i < geometry->numtriangles; i++) {
+            triangle = &T(geometry->triangles[i]);
+#ifdef DebugVisibleSurfaces
+            if (!triangle->visible) continue;
+#endif
+            if (mode & GLM_FLAT)
+                glNormal3fv(&model->facetnorms[3 * triangle->findex]);
+
+            if (mode & GLM_SMOOTH)
+                glNormal3fv(&model->normals[3 * triangle->nindices[0]]);
+            if (mode & GLM_TEXTURE)
+                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[0]]);
+            glVertex3fv(&model->vertices[3 * triangle->vindices[0]]);
+
+            if (mode & GLM_SMOOTH)
+                glNormal3fv(&model->normals[3 * triangle->nindices[1]]);
+            if (mode & GLM_TEXTURE) {
+                //if (IDTextura==-1) printf("Warning: GLM_TEXTURE este on dar nu este setata nici o textura in material!");
+                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[1]]);
+            }
+            glVertex3fv(&model->vertices[3 * triangle->vindices[1]]);
+
+            if (mode & GLM_SMOOTH)
+                glNormal3fv(&model->normals[3 * triangle->nindices[2]]);
+            if (mode & GLM_TEXTURE)
+                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[2]]);
+            glVertex3fv(&model->vertices[3 * triangle->vindices[2]]);
+
+        }
+        glEnd();
+
+        if (group->prototype)
+            glPopMatrix();
+
+        group = group->next;
+    }
+}
+
+/* glmDrawBatches: draws the batches of a model from its buffers, which
+ * must be bound.  With a program the transform of instanced groups
+ * goes to its glm_group uniform and the kind of texture to
+ * glm_texturing.
+ *
+ * program   - glmFixedProgram() in use, or 0 for fixed function
+ * instances - number of instances to draw each range for, or 0
+ * lastmaterial, lasttexture - state set last (see glmSetState)
+ */
+static GLvoid
+glmDrawBatches(GLMmodel *model, GLuint mode, GLuint program, GLuint instances,
+               GLMmaterial **lastmaterial, GLuint *lasttexture)
+{
+    static const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    GLMbatch   *batch;
+    GLMtexture *texture;
+    GLint       group, texturing, material;
+    GLuint      i, j;
+
+    group = texturing = material = -1;
+    if (program) {
+        group = pglGetUniformLocation(program, "glm_group");
+        texturing = pglGetUniformLocation(program, "glm_texturing");
+        material = pglGetUniformLocation(program, "glm_material");
+        pglUniformMatrix4fv(group, 1, GL_FALSE, identity);
+    }
+
+    for (i = 0; i < model->numbatches; i++) {
+        batch = &model->batches[i];
+        glmSetState(model, batch->group, mode, lastmaterial, lasttexture);
+        if (material != -1)
+            pglUniform1i(material, model->materials ? batch->group->material : 0);
+        if (texturing != -1) {
+            texture = (mode & GLM_TEXTURE) ? glmGroupTexture(model, batch->group) : NULL;
+            pglUniform1i(texturing, !texture ? 0 : texture->target == GL_TEXTURE_2D_ARRAY ? 2 : 1);
+        }
+        if (program) {
+            if (batch->group->prototype)
+                pglUniformMatrix4fv(group, 1, GL_FALSE, batch->group->transform);
+        } else if (batch->group->prototype) {
+            glPushMatrix();
+            glMultMatrixf(batch->group->transform);
+        }
+
+        if (instances) {
+            for (j = 0; j < batch->numranges; j++) {
+                pglDrawElementsInstanced(GL_TRIANGLES, model->batchcounts[batch->first + j],
+                                         GL_UNSIGNED_INT, model->batchoffsets[batch->first + j],
+                                         instances);
+                model->numdrawcalls++;
+            }
+        } else if (batch->numranges > 1 && glmExtensions() & GLM_EXT_MULTIDRAW) {
+            pglMultiDrawElements(GL_TRIANGLES, &model->batchcounts[batch->first], GL_UNSIGNED_INT,
+                                 (const GLvoid **)&model->batchoffsets[batch->first],
+                                 batch->numranges);
+            model->numdrawcalls++;
+        } else {
+            for (j = 0; j < batch->numranges; j++) {
+                glDrawElements(GL_TRIANGLES, model->batchcounts[batch->first + j], GL_UNSIGNED_INT,
+                               model->batchoffsets[batch->first + j]);
+                model->numdrawcalls++;
+            }
+        }
+
+        if (batch->group->prototype) {
+            if (program)
+                pglUniformMatrix4fv(group, 1, GL_FALSE, identity);
+            else
+                glPopMatrix();
+        }
+    }
+}
+
+/* glmShaderPointers: enables (or disables) the GLM_ATTRIB_* arrays of
+ * the vertex buffer, which must be bound, for glmRenderProgram */
+static GLvoid
+glmShaderPointers(GLuint mode, GLboolean enable)
+{
+    if (!enable) {
+        pglDisableVertexAttribArray(GLM_ATTRIB_POSITION);
+        pglDisableVertexAttribArray(GLM_ATTRIB_NORMAL);
+        pglDisableVertexAttribArray(GLM_ATTRIB_TEXCOORD);
+        return;
+    }
+
+    pglEnableVertexAttribArray(GLM_ATTRIB_POSITION);
+    pglVertexAttribPointer(GLM_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(GLMvertex),
+                           (GLvoid *)offsetof(GLMvertex, position));
+    if (mode & (GLM_FLAT | GLM_SMOOTH)) {
+        pglEnableVertexAttribArray(GLM_ATTRIB_NORMAL);
+        pglVertexAttribPointer(GLM_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(GLMvertex),
+                               (GLvoid *)offsetof(GLMvertex, normal));
+    }
+    if (mode & GLM_TEXTURE) {
+        pglEnableVertexAttribArray(GLM_ATTRIB_TEXCOORD);
+        pglVertexAttribPointer(GLM_ATTRIB_TEXCOORD, 3, GL_FLOAT, GL_FALSE, sizeof(GLMvertex),
+                               (GLvoid *)offsetof(GLMvertex, texcoord));
+    }
+}
+
+/* glmShaderInstance: sets the instance transform glmRenderProgram uses
+ * when the instances are not drawn with one instanced call
+ *
+ * transform - 16 floats (column-major), or NULL for identity
+ */
+static GLvoid
+glmShaderInstance(GLfloat *transform)
+{
+    static const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    GLuint i;
+
+    for (i = 0; i < 4; i++)
+        pglVertexAttrib4fv(GLM_ATTRIB_INSTANCE + i, transform ? &transform[4 * i] : &identity[4 * i]);
+}
+
+/* glmShaderUniforms: sets the per draw uniforms of glmRenderProgram,
+ * which must be in use, from the current OpenGL state and binds the
+ * materials of the model (uploading them on first use) */
+static GLvoid
+glmShaderUniforms(GLMmodel *model, GLuint mode, GLuint program)
+{
+    GLfloat     matrix[16], vector[4], *materials, *m;
+    GLint       viewport[4];
+    GLMtexture *texture;
+    GLuint      i, count;
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, matrix);
+    pglUniformMatrix4fv(pglGetUniformLocation(program, "glm_modelview"), 1, GL_FALSE, matrix);
+    glGetFloatv(GL_PROJECTION_MATRIX, matrix);
+    pglUniformMatrix4fv(pglGetUniformLocation(program, "glm_projection"), 1, GL_FALSE, matrix);
+
+    /* GL keeps the light position in eye space already */
+    glGetLightfv(GL_LIGHT0, GL_POSITION, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_light"), 1, vector);
+    glGetLightfv(GL_LIGHT0, GL_AMBIENT, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_lightambient"), 1, vector);
+    glGetLightfv(GL_LIGHT0, GL_DIFFUSE, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_lightdiffuse"), 1, vector);
+    glGetLightfv(GL_LIGHT0, GL_SPECULAR, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_lightspecular"), 1, vector);
+    glGetFloatv(GL_LIGHT_MODEL_AMBIENT, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_sceneambient"), 1, vector);
+    glGetFloatv(GL_CURRENT_COLOR, vector);
+    pglUniform4fv(pglGetUniformLocation(program, "glm_color"), 1, vector);
+    pglUniform1i(pglGetUniformLocation(program, "glm_textures"), (mode & GLM_TEXTURE) ? 1 : 0);
+
+    /* only used by the wireframe programs */
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    pglUniform2f(pglGetUniformLocation(program, "glm_viewport"), 0.5 * viewport[2], 0.5 * viewport[3]);
+    glGetFloatv(GL_LINE_WIDTH, vector);
+    pglUniform1f(pglGetUniformLocation(program, "glm_wirewidth"), vector[0]);
+
+    if (!model->materialbuffer) {
+        /* diffuse, ambient, specular, (shininess, texture kind) */
+        count = model->materials ? model->nummaterials : 1;
+        materials = (GLfloat *)calloc(16 * count, sizeof(GLfloat));
+        for (i = 0; i < count; i++) {
+            m = &materials[16 * i];
+            if (!model->materials) {
+                /* the OpenGL default material */
+                m[0] = m[1] = m[2] = 0.8; m[3] = 1.0;
+                m[4] = m[5] = m[6] = 0.2; m[7] = 1.0;
+                m[11] = 1.0;
+                continue;
+            }
+            memcpy(&m[0], model->materials[i].diffuse, sizeof(GLfloat) * 4);
+            memcpy(&m[4], model->materials[i].ambient, sizeof(GLfloat) * 4);
+            memcpy(&m[8], model->materials[i].specular, sizeof(GLfloat) * 4);
+            m[12] = model->materials[i].shininess;
+            texture = (model->materials[i].IDTextura < model->numtextures) ?
+                      &model->textures[model->materials[i].IDTextura] : NULL;
+            m[13] = !texture ? 0.0 : texture->target == GL_TEXTURE_2D_ARRAY ? 2.0 : 1.0;
+        }
+
+        pglGenBuffers(1, &model->materialbuffer);
+        pglBindBuffer(GL_UNIFORM_BUFFER, model->materialbuffer);
+        pglBufferData(GL_UNIFORM_BUFFER, sizeof(GLfloat) * 16 * count, materials, GL_STATIC_DRAW);
+        pglBindBuffer(GL_UNIFORM_BUFFER, 0);
+        free(materials);
+    }
+    pglBindBufferBase(GL_UNIFORM_BUFFER, 0, model->materialbuffer);
+}
+
+/* glmDraw: Renders the model to the current OpenGL context using the
+ * mode specified.
+ *
+ * model - initialized GLMmodel structure
+ * mode  - a bitwise OR of values describing what is to be rendered.
+ *             GLM_NONE     -  render with only vertices
+ *             GLM_FLAT     -  render with facet normals
+ *             GLM_SMOOTH   -  render with vertex normals
+ *             GLM_TEXTURE  -  render with texture coords
+ *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_MATERIAL -  render with materials
+ *             GLM_COLOR and GLM_MATERIAL should not both be specified.
+ *             GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+
+/* glmSelectLODs: picks the level of detail of every group for the
+ * current matrices and viewport, the coarsest whose error projects to
+ * at most model->lodtolerance pixels at the nearest point of the
+ * group.  A group only goes to a coarser level once that level is well
+ * within the tolerance, so that it does not flip between two levels
+ * at the boundary.  Returns GL_TRUE if any level changed.
+ */
+static GLboolean
+glmSelectLODs(GLMmodel *model)
+{
+    static const GLfloat hysteresis = 0.75;
+    GLMgroup *group, *geometry;
+    GLfloat   modelview[16], projection[16], center[3], eye[3];
+    GLint     viewport[4];
+    GLfloat   scale, pixels, w, *t;
+    GLuint    level, i;
+    GLboolean changed;
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    /* model units to eye units (the transforms scale uniformly), and
+       eye units to pixels at w = 1 */
+    scale = sqrt(modelview[0] * modelview[0] + modelview[1] * modelview[1] +
+                 modelview[2] * modelview[2]);
+    pixels = scale * fabs(projection[5]) * viewport[3] / 2.0;
+
+    changed = GL_FALSE;
+    for (group = model->groups; group; group = group->next) {
+        geometry = group->prototype ? group->prototype : group;
+        level = 0;
+        if (model->lodtolerance > 0.0 && geometry->numlods) {
+            memcpy(center, geometry->sphere, sizeof(center));
+            if (group->prototype) {
+                t = group->transform;
+                for (i = 0; i < 3; i++)
+                    center[i] = t[i] * geometry->sphere[0] + t[4 + i] * geometry->sphere[1] +
+                                t[8 + i] * geometry->sphere[2] + t[12 + i];
+            }
+            for (i = 0; i < 3; i++)
+                eye[i] = modelview[i] * center[0] + modelview[4 + i] * center[1] +
+                         modelview[8 + i] * center[2] + modelview[12 + i];
+            w = projection[3] * eye[0] + projection[7] * eye[1] + projection[11] * eye[2] +
+                projection[15] - fabs(projection[11]) * geometry->sphere[3] * scale;
+
+            /* groups reaching the eye are drawn in full */
+            if (w > 0.0) {
+                level = group->lod <= geometry->numlods ? group->lod : 0;
+                if (level && geometry->lods[level - 1].error * pixels / w > model->lodtolerance) {
+                    while (level && geometry->lods[level - 1].error * pixels / w > model->lodtolerance)
+                        level--;
+                } else {
+                    while (level < geometry->numlods && geometry->lods[level].error * pixels / w <=
+                            hysteresis * model->lodtolerance)
+                        level++;
+                }
+            }
+        }
+        if (group->lod != level) {
+            group->lod = level;
+            changed = GL_TRUE;
+        }
+    }
+
+    return changed;
+}
+
+GLvoid glmDraw(GLMmodel *model, GLuint mode)
+{
+    GLuint i;
+    GLMmaterial *lastmaterial;
+    GLuint lasttexture, program, features, instances, copies, maxmaterials, wire;
+    GLboolean buffers, shader, flat, lines;
+
+    assert(model);
+    assert(model->vertices);
+
+    /* point clouds have nothing but positions and colors */
+    if (model->pointcloud) {
+        glmDrawPoints(model);
+        return;
+    }
+
+    /* with shaders the normal of each triangle comes from the
+       derivatives of its position: the vertices stay shared and
+       neither normals nor facetnorms are needed */
+    flat = GL_FALSE;
+    if (mode & GLM_FLAT && !(mode & GLM_SMOOTH) && glmExtensions() & GLM_EXT_BUFFERS &&
+            glmExtensions() & GLM_EXT_SHADERS) {
+        if (glmFixedProgram(0)) {
+            flat = GL_TRUE;
+            mode &= ~GLM_FLAT;
+        } else if (!model->facetnorms) {
+            /* the program did not build, the normals are made now */
+            glmFacetNormals(model);
+        }
+    }
+
+    /* do a bit of warning */
+    if (mode & GLM_FLAT && !model->facetnorms) {
+        printf("glmDraw() warning: flat render mode requested "
+               "with no facet normals defined.\n");
+        mode &= ~GLM_FLAT;
+    }
+    if (mode & GLM_SMOOTH && !model->normals) {
+        printf("glmDraw() warning: smooth render mode requested "
+               "with no normals defined.\n");
+        mode &= ~GLM_SMOOTH;
+    }
+    if (mode & GLM_TEXTURE && !model->texcoords) {
+        printf("glmDraw() warning: texture render mode requested "
+               "with no texture coordinates defined.\n");
+        mode &= ~GLM_TEXTURE;
+    }
+    if (mode & GLM_FLAT && mode & GLM_SMOOTH) {
+        printf("glmDraw() warning: flat render mode requested "
+               "and smooth render mode requested (using smooth).\n");
+        mode &= ~GLM_FLAT;
+    }
+    if (mode & GLM_COLOR && !model->materials) {
         printf("glmDraw() warning: color render mode requested "
                "with no materials defined.\n");
         mode &= ~GLM_COLOR;
     }
-    if (mode & GLM_MATERIAL && !model->materials) {
-        printf("glmDraw() warning: material render mode requested "
-               "with no materials defined.\n");
-        mode &= ~GLM_MATERIAL;
+    if (mode & GLM_MATERIAL && !model->materials) {
+        printf("glmDraw() warning: material render mode requested "
+               "with no materials defined.\n");
+        mode &= ~GLM_MATERIAL;
+    }
+    if (mode & GLM_COLOR && mode & GLM_MATERIAL) {
+        printf("glmDraw() warning: color and material render mode requested "
+               "using only material mode.\n");
+        mode &= ~GLM_COLOR;
+    }
+    if (mode & GLM_WIREFRAME && mode & GLM_OVERLAY) {
+        printf("glmDraw() warning: wireframe and overlay render mode requested "
+               "using only overlay mode.\n");
+        mode &= ~GLM_WIREFRAME;
+    }
+    lines = (mode & GLM_WIREFRAME) ? GL_TRUE : GL_FALSE;
+    wire = 0;
+    if (mode & (GLM_WIREFRAME | GLM_OVERLAY)) {
+        wire = (mode & GLM_OVERLAY) ? GLM_PROGRAM_OVERLAY : GLM_PROGRAM_WIREFRAME;
+        if (!(glmExtensions() & GLM_EXT_GEOMETRY)) {
+            printf("glmDraw() warning: wireframe render mode requested "
+                   "with no support for it.\n");
+            mode &= ~(GLM_WIREFRAME | GLM_OVERLAY);
+            wire = 0;
+        } else {
+            mode |= GLM_SHADER;
+        }
+    }
+    if (mode & GLM_SHADER && (!(glmExtensions() & GLM_EXT_BUFFERS) ||
+                              !glmRenderProgram(wire, &maxmaterials))) {
+        printf("glmDraw() warning: shader render mode requested "
+               "with no support for it.\n");
+        mode &= ~(GLM_SHADER | GLM_WIREFRAME | GLM_OVERLAY);
+    }
+    if (mode & GLM_SHADER && model->nummaterials > maxmaterials) {
+        printf("glmDraw() warning: shader render mode requested "
+               "with more than %d materials.\n", maxmaterials);
+        mode &= ~(GLM_SHADER | GLM_WIREFRAME | GLM_OVERLAY);
+    }
+    /* a wireframe the program can't draw is rasterized as lines */
+    lines = (lines && !(mode & GLM_WIREFRAME)) ? GL_TRUE : GL_FALSE;
+    if (lines) {
+        glPushAttrib(GL_POLYGON_BIT);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    }
+    if (mode & GLM_SHADER) {
+        /* materials and textures are handled by the program */
+    } else {
+        if (mode & GLM_COLOR)
+            glEnable(GL_COLOR_MATERIAL);
+        else if (mode & GLM_MATERIAL)
+            glDisable(GL_COLOR_MATERIAL);
+        if (mode & GLM_TEXTURE) {
+            glEnable(GL_TEXTURE_2D);
+            glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        }
+    }
+    /* perhaps this loop should be unrolled into material, color, flat,
+       smooth, etc. loops?  since most cpu's have good branch prediction
+       schemes (and these branches will always go one way), probably
+       wouldn't gain too much?  */
+
+    /* the vertices are the same with or without shaders */
+    shader = mode & GLM_SHADER;
+    mode &= ~(GLM_SHADER | GLM_WIREFRAME | GLM_OVERLAY);
+
+    buffers = (glmExtensions() & GLM_EXT_BUFFERS) ? GL_TRUE : GL_FALSE;
+    if (buffers) {
+        if (model->buffermode != mode)
+            glmBuildBuffers(model, mode);
+
+        pglBindBuffer(GL_ARRAY_BUFFER, model->vertexbuffer);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->indexbuffer);
+        if (shader) {
+            glmShaderPointers(mode, GL_TRUE);
+        } else {
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, sizeof(GLMvertex), (GLvoid *)offsetof(GLMvertex, position));
+            if (mode & (GLM_FLAT | GLM_SMOOTH)) {
+                glEnableClientState(GL_NORMAL_ARRAY);
+                glNormalPointer(GL_FLOAT, sizeof(GLMvertex), (GLvoid *)offsetof(GLMvertex, normal));
+            }
+            if (mode & GLM_TEXTURE) {
+                glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+                glTexCoordPointer(3, GL_FLOAT, sizeof(GLMvertex), (GLvoid *)offsetof(GLMvertex, texcoord));
+            }
+        }
+
+        if (model->numlods && glmSelectLODs(model))
+            glmFreeBatches(model);
+        if (!model->batches || model->batchserial != model->visibleserial)
+            glmBuildBatches(model, mode);
+    }
+
+    lasttexture = -2;
+    lastmaterial = NULL;
+    model->numdrawcalls = 0;
+    if (!buffers)
+        model->numdrawgroups = 0;
+
+    /* instances come from one instanced draw, or from a loop here;
+       texture arrays can only be sampled by a program */
+    features = 0;
+    if (buffers && model->numinstances && glmExtensions() & GLM_EXT_INSTANCING)
+        features |= GLM_PROGRAM_INSTANCED;
+    if (buffers && model->numtexturearrays && mode & GLM_TEXTURE)
+        features |= GLM_PROGRAM_LAYERED;
+    if (shader)
+        program = glmRenderProgram(wire, NULL);
+    else
+        program = (features || flat) ? glmFixedProgram(features) : 0;
+    if (flat && !program) {
+        /* without its features the program still derives the normals */
+        features = 0;
+        program = glmFixedProgram(0);
+    }
+    instances = (program && features & GLM_PROGRAM_INSTANCED) ? model->numinstances : 0;
+
+    if (instances) {
+        if (!model->instancebuffer)
+            pglGenBuffers(1, &model->instancebuffer);
+        pglBindBuffer(GL_ARRAY_BUFFER, model->instancebuffer);
+        if (!model->instancesvalid) {
+            pglBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 16 * model->numinstances,
+                          model->instances, GL_STATIC_DRAW);
+            model->instancesvalid = GL_TRUE;
+        }
+        for (i = 0; i < 4; i++) {
+            pglEnableVertexAttribArray(GLM_ATTRIB_INSTANCE + i);
+            pglVertexAttribPointer(GLM_ATTRIB_INSTANCE + i, 4, GL_FLOAT, GL_FALSE,
+                                   sizeof(GLfloat) * 16, (GLvoid *)(sizeof(GLfloat) * 4 * i));
+            pglVertexAttribDivisor(GLM_ATTRIB_INSTANCE + i, 1);
+        }
+        pglBindBuffer(GL_ARRAY_BUFFER, model->vertexbuffer);
+    }
+    if (program) {
+        pglUseProgram(program);
+        pglUniform1i(pglGetUniformLocation(program, "glm_lighting"), glIsEnabled(GL_LIGHTING));
+        pglUniform1i(pglGetUniformLocation(program, "glm_flat"), flat);
+        pglUniform1i(pglGetUniformLocation(program, "glm_texture"), 0);
+        pglUniform1i(pglGetUniformLocation(program, "glm_layers"), 1);
+    }
+    if (shader) {
+        glmShaderUniforms(model, mode, program);
+        if (!instances)
+            glmShaderInstance(NULL);
+        /* only textures are left to glmSetState */
+        mode &= ~(GLM_COLOR | GLM_MATERIAL);
+    }
+
+    copies = (instances || !model->numinstances) ? 1 : model->numinstances;
+    for (i = 0; i < copies; i++) {
+        if (shader && model->numinstances && !instances) {
+            glmShaderInstance(&model->instances[16 * i]);
+        } else if (copies > 1 || (model->numinstances && !instances)) {
+            glPushMatrix();
+            glMultMatrixf(&model->instances[16 * i]);
+        }
+        if (buffers)
+            glmDrawBatches(model, mode, program, instances, &lastmaterial, &lasttexture);
+        else
+            glmDrawImmediate(model, mode, &lastmaterial, &lasttexture);
+        if (!shader && (copies > 1 || (model->numinstances && !instances)))
+            glPopMatrix();
+    }
+
+    if (program)
+        pglUseProgram(0);
+    if (instances) {
+        for (i = 0; i < 4; i++) {
+            pglVertexAttribDivisor(GLM_ATTRIB_INSTANCE + i, 0);
+            pglDisableVertexAttribArray(GLM_ATTRIB_INSTANCE + i);
+        }
+    }
+
+    if (shader)
+        glmShaderPointers(mode, GL_FALSE);
+    if (buffers) {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    if (lines)
+        glPopAttrib();
+}
+
+/* glmList: Generates and returns a display list for the model using
+ * the mode specified.
+ *
+ * model - initialized GLMmodel structure
+ * mode  - a bitwise OR of values describing what is to be rendered.
+ *             GLM_NONE     -  render with only vertices
+ *             GLM_FLAT     -  render with facet normals
+ *             GLM_SMOOTH   -  render with vertex normals
+ *             GLM_TEXTURE  -  render with texture coords
+ *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_MATERIAL -  render with materials
+ *             GLM_COLOR and GLM_MATERIAL should not both be specified.
+ * GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+GLuint
+glmList(GLMmodel *model, GLuint mode)
+{
+    GLuint list;
+
+    list = glGenLists(1);
+    glNewList(list, GL_COMPILE);
+    glmDraw(model, mode);
+    glEndList();
+
+    return list;
+}
+
+/* glmWeld: eliminate (weld) vectors that are within an epsilon of
+ * each other.
+ *
+ * model   - initialized GLMmodel structure
+ * epsilon     - maximum difference between vertices
+ *               ( 0.00001 is a good start for a unitized model)
+ *
+ */
+GLvoid
+glmWeld(GLMmodel *model, GLfloat epsilon)
+{
+    GLfloat *vectors;
+    GLfloat *copies;
+    GLuint   numvectors;
+    GLuint   i;
+
+    /* the levels of detail refer to the old vertices */
+    glmDeleteLODs(model);
+
+    /* vertices */
+    numvectors = model->numvertices;
+    vectors  = model->vertices;
+    copies = glmWeldVectors(vectors, &numvectors, epsilon);
+
+#if 0
+    printf("glmWeld(): %d redundant vertices.\n",
+           model->numvertices - numvectors - 1);
+#endif
+
+    for (i = 0; i < model->numtriangles; i++) {
+        T(i).vindices[0] = (GLuint)vectors[3 * T(i).vindices[0] + 0];
+        T(i).vindices[1] = (GLuint)vectors[3 * T(i).vindices[1] + 0];
+        T(i).vindices[2] = (GLuint)vectors[3 * T(i).vindices[2] + 0];
+    }
+
+    /* free space for old vertices */
+    free(vectors);
+
+    /* allocate space for the new vertices */
+    model->numvertices = numvectors;
+    model->vertices = (GLfloat *)malloc(sizeof(GLfloat) *
+                                        3 * (model->numvertices + 1));
+
+    /* copy the optimized vertices into the actual vertex list */
+    for (i = 1; i <= model->numvertices; i++) {
+        model->vertices[3 * i + 0] = copies[3 * i + 0];
+        model->vertices[3 * i + 1] = copies[3 * i + 1];
+        model->vertices[3 * i + 2] = copies[3 * i + 2];
+    }
+
+    free(copies);
+    model->boundsvalid = GL_FALSE;
+    model->buffermode = GLM_NOBUFFERS;
+}
+
+/* glmCompactVectors: drop the vectors of an array that are not marked
+ * as used, and fill in the old index -> new index mapping.  Returns the
+ * new number of vectors.
+ *
+ * vectors    - 1-based array of vectors (size components each)
+ * numvectors - number of vectors in the array
+ * size       - components per vector
+ * remap      - used flags on input (non-zero = used), new indices on output
+ */
+static GLuint
+glmCompactVectors(GLfloat *vectors, GLuint numvectors, GLuint size, GLuint *remap)
+{
+    GLuint i, copied;
+
+    copied = 0;
+    for (i = 1; i <= numvectors; i++) {
+        if (!remap[i])
+            continue;
+        copied++;
+        if (copied != i)
+            memcpy(&vectors[size * copied], &vectors[size * i], sizeof(GLfloat) * size);
+        remap[i] = copied;
+    }
+    remap[0] = 0;
+
+    return copied;
+}
+
+/* glmTriangleDegenerate: returns GL_TRUE if a triangle has no area */
+static GLboolean
+glmTriangleDegenerate(GLMmodel *model, GLMtriangle *triangle)
+{
+    GLfloat u[3], v[3], n[3];
+    GLfloat *p0, *p1, *p2;
+
+    if (triangle->vindices[0] == triangle->vindices[1] ||
+            triangle->vindices[1] == triangle->vindices[2] ||
+            triangle->vindices[2] == triangle->vindices[0])
+        return GL_TRUE;
+
+    p0 = &model->vertices[3 * triangle->vindices[0]];
+    p1 = &model->vertices[3 * triangle->vindices[1]];
+    p2 = &model->vertices[3 * triangle->vindices[2]];
+    u[0] = p1[0] - p0[0];
+    u[1] = p1[1] - p0[1];
+    u[2] = p1[2] - p0[2];
+    v[0] = p2[0] - p0[0];
+    v[1] = p2[1] - p0[1];
+    v[2] = p2[2] - p0[2];
+    glmCross(u, v, n);
+
+    return glmDot(n, n) == 0.0 ? GL_TRUE : GL_FALSE;
+}
+
+/* glmTriangleKey: rotates the vertex indices of a triangle so the
+ * smallest comes first (keeping the winding) */
+static GLvoid
+glmTriangleKey(GLMtriangle *triangle, GLuint *key)
+{
+    GLuint *v = triangle->vindices;
+    GLuint  first;
+
+    first = 0;
+    if (v[1] < v[first]) first = 1;
+    if (v[2] < v[first]) first = 2;
+    key[0] = v[first];
+    key[1] = v[(first + 1) % 3];
+    key[2] = v[(first + 2) % 3];
+}
+
+/* glmCompact: removes degenerate (zero area) and duplicate triangles,
+ * triangles that are not in any group, and vertices, normals and
+ * texcoords that are no longer referenced by a triangle.  All indices
+ * are remapped in place.  Returns the number of bytes reclaimed.
+ *
+ * model - initialized GLMmodel structure
+ */
+size_t
+glmCompact(GLMmodel *model)
+{
+    GLMgroup    *group;
+    GLMtriangle *triangle;
+    GLuint      *hash, *material, *remap;
+    GLuint       hashsize, h, key[3], other[3];
+    GLuint       numtriangles, numdegenerate, numduplicate;
+    GLuint       i, j, k;
+    size_t       before, after;
+
+    assert(model);
+    assert(model->vertices);
+
+    /* the levels of detail refer to the old vertices and triangles */
+    glmDeleteLODs(model);
+
+    before = sizeof(GLfloat) * 3 * (model->numvertices + 1) +
+             sizeof(GLMtriangle) * model->numtriangles +
+             sizeof(GLuint) * model->numtriangles;
+    if (model->normals)
+        before += sizeof(GLfloat) * 3 * (model->numnormals + 1);
+    if (model->texcoords)
+        before += sizeof(GLfloat) * 2 * (model->numtexcoords + 1);
+    if (model->facetnorms)
+        before += sizeof(GLfloat) * 3 * (model->numfacetnorms + 1);
+
+    /* the material of every live triangle, -1 for triangles that are
+       dropped (or not in any group) */
+    material = (GLuint *)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    for (i = 0; i < model->numtriangles; i++)
+        material[i] = (GLuint)-1;
+
+    /* open addressing table of triangle index + 1, keyed by vertices */
+    for (hashsize = 1; hashsize < 2 * model->numtriangles; hashsize <<= 1);
+    hash = (GLuint *)calloc(hashsize, sizeof(GLuint));
+
+    numdegenerate = numduplicate = 0;
+    group = model->groups;
+    while (group) {
+        for (i = 0; i < group->numtriangles; i++) {
+            triangle = &T(group->triangles[i]);
+            if (glmTriangleDegenerate(model, triangle)) {
+                numdegenerate++;
+                continue;
+            }
+
+            glmTriangleKey(triangle, key);
+            h = (key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u) & (hashsize - 1);
+            while (hash[h]) {
+                glmTriangleKey(&T(hash[h] - 1), other);
+                if (other[0] == key[0] && other[1] == key[1] && other[2] == key[2] &&
+                        material[hash[h] - 1] == group->material)
+                    break;
+                h = (h + 1) & (hashsize - 1);
+            }
+            if (hash[h]) {
+                numduplicate++;
+                continue;
+            }
+            hash[h] = group->triangles[i] + 1;
+            material[group->triangles[i]] = group->material;
+        }
+        group = group->next;
+    }
+    free(hash);
+
+    /* pack the live triangles (and their facet normals) and remember
+       where each one went */
+    remap = material;
+    numtriangles = 0;
+    for (i = 0; i < model->numtriangles; i++) {
+        if (material[i] == (GLuint)-1)
+            continue;
+        if (numtriangles != i)
+            T(numtriangles) = T(i);
+        if (model->facetnorms) {
+            if (T(numtriangles).findex != numtriangles + 1)
+                memcpy(&model->facetnorms[3 * (numtriangles + 1)],
+                       &model->facetnorms[3 * T(numtriangles).findex],
+                       sizeof(GLfloat) * 3);
+            T(numtriangles).findex = numtriangles + 1;
+        }
+        remap[i] = numtriangles++;
+    }
+
+    group = model->groups;
+    while (group) {
+        for (i = 0, j = 0; i < group->numtriangles; i++) {
+            k = remap[group->triangles[i]];
+            if (k != (GLuint)-1)
+                group->triangles[j++] = k;
+        }
+        if (j < group->numtriangles)
+            group->triangles = (GLuint *)realloc(group->triangles, sizeof(GLuint) * (j ? j : 1));
+        group->numtriangles = j;
+        group = group->next;
+    }
+    free(material);
+
+    model->numtriangles = numtriangles;
+    model->triangles = (GLMtriangle *)realloc(model->triangles,
+                       sizeof(GLMtriangle) * (numtriangles ? numtriangles : 1));
+    if (model->facetnorms) {
+        model->numfacetnorms = numtriangles;
+        model->facetnorms = (GLfloat *)realloc(model->facetnorms,
+                                               sizeof(GLfloat) * 3 * (numtriangles + 1));
+    }
+
+    /* drop vertices that no triangle uses any more */
+    remap = (GLuint *)calloc(model->numvertices + 1, sizeof(GLuint));
+    for (i = 0; i < numtriangles; i++)
+        for (j = 0; j < 3; j++)
+            remap[T(i).vindices[j]] = 1;
+    model->numvertices = glmCompactVectors(model->vertices, model->numvertices, 3, remap);
+    for (i = 0; i < numtriangles; i++)
+        for (j = 0; j < 3; j++)
+            T(i).vindices[j] = remap[T(i).vindices[j]];
+    model->vertices = (GLfloat *)realloc(model->vertices,
+                                         sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    model->boundsvalid = GL_FALSE;
+    model->buffermode = GLM_NOBUFFERS;
+    free(remap);
+
+    /* normals and texcoords; faces read without them have index 0,
+       which stays 0 (none) */
+    if (model->normals) {
+        remap = (GLuint *)calloc(model->numnormals + 1, sizeof(GLuint));
+        for (i = 0; i < numtriangles; i++)
+            for (j = 0; j < 3; j++)
+                if (T(i).nindices[j] && T(i).nindices[j] <= model->numnormals)
+                    remap[T(i).nindices[j]] = 1;
+        k = model->numnormals;
+        model->numnormals = glmCompactVectors(model->normals, k, 3, remap);
+        for (i = 0; i < numtriangles; i++)
+            for (j = 0; j < 3; j++)
+                if (T(i).nindices[j] && T(i).nindices[j] <= k)
+                    T(i).nindices[j] = remap[T(i).nindices[j]];
+        model->normals = (GLfloat *)realloc(model->normals,
+                                            sizeof(GLfloat) * 3 * (model->numnormals + 1));
+        free(remap);
+    }
+
+    if (model->texcoords) {
+        remap = (GLuint *)calloc(model->numtexcoords + 1, sizeof(GLuint));
+        for (i = 0; i < numtriangles; i++)
+            for (j = 0; j < 3; j++)
+                if (T(i).tindices[j] && T(i).tindices[j] <= model->numtexcoords)
+                    remap[T(i).tindices[j]] = 1;
+        k = model->numtexcoords;
+        model->numtexcoords = glmCompactVectors(model->texcoords, k, 2, remap);
+        for (i = 0; i < numtriangles; i++)
+            for (j = 0; j < 3; j++)
+                if (T(i).tindices[j] && T(i).tindices[j] <= k)
+                    T(i).tindices[j] = remap[T(i).tindices[j]];
+        model->texcoords = (GLfloat *)realloc(model->texcoords,
+                                              sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+        free(remap);
+    }
+
+    after = sizeof(GLfloat) * 3 * (model->numvertices + 1) +
+            sizeof(GLMtriangle) * model->numtriangles +
+            sizeof(GLuint) * model->numtriangles;
+    if (model->normals)
+        after += sizeof(GLfloat) * 3 * (model->numnormals + 1);
+    if (model->texcoords)
+        after += sizeof(GLfloat) * 2 * (model->numtexcoords + 1);
+    if (model->facetnorms)
+        after += sizeof(GLfloat) * 3 * (model->numfacetnorms + 1);
+
+#if 0
+    printf("glmCompact(): %d degenerate, %d duplicate triangles.\n",
+           numdegenerate, numduplicate);
+#endif
+
+    return before - after;
+}
+
+/* glmPackTextures: Packs the textures of a model that have the same
+ * size into 2D texture arrays, so that groups using different textures
+ * can still be drawn in one batch.  Needs GLM_EXT_TEXARRAYS and
+ * GLM_EXT_BUFFERS, and packs nothing unless the layered glmFixedProgram
+ * that glmDraw samples the arrays with builds.  Textures of a size
+ * used only once are left alone.  Returns the number of textures
+ * packed.
+ *
+ * model - initialized GLMmodel structure, its context current
+ */
+GLuint
+glmPackTextures(GLMmodel *model)
+{
+    GLMtexture *texture;
+    GLMcachedtexture *cached;
+    GLuint     *sizes, *layers, array, numlayers, numpacked;
+    GLint       maxlayers, width, height;
+    GLubyte    *pixels;
+    GLuint      i, j;
+
+    assert(model);
+
+    if ((glmExtensions() & (GLM_EXT_TEXARRAYS | GLM_EXT_BUFFERS)) !=
+            (GLM_EXT_TEXARRAYS | GLM_EXT_BUFFERS) || model->numtextures < 2)
+        return 0;
+    /* the arrays can only be sampled by the layered program */
+    if (!glmFixedProgram(GLM_PROGRAM_LAYERED))
+        return 0;
+
+    /* the size of every texture as uploaded, 0 if none or done; shared
+       textures stay as they are for the other models */
+    sizes = (GLuint *)malloc(sizeof(GLuint) * 2 * model->numtextures);
+    for (i = 0; i < model->numtextures; i++) {
+        texture = &model->textures[i];
+        sizes[2 * i + 0] = sizes[2 * i + 1] = 0;
+        if (texture->target != GL_TEXTURE_2D || !texture->id)
+            continue;
+        if (model->texturecache) {
+            cached = glmCachedTexture(model->texturecache, texture);
+            if (!cached || cached->references > 1)
+                continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture->id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        sizes[2 * i + 0] = width;
+        sizes[2 * i + 1] = height;
+    }
+
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxlayers);
+    layers = (GLuint *)malloc(sizeof(GLuint) * model->numtextures);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    numpacked = 0;
+    for (i = 0; i < model->numtextures; i++) {
+        if (!sizes[2 * i])
+            continue;
+        width = sizes[2 * i + 0];
+        height = sizes[2 * i + 1];
+
+        /* this texture and the next ones of the same size */
+        numlayers = 0;
+        for (j = i; j < model->numtextures && numlayers < (GLuint)maxlayers; j++) {
+            if (sizes[2 * j + 0] == (GLuint)width && sizes[2 * j + 1] == (GLuint)height) {
+                layers[numlayers++] = j;
+                sizes[2 * j + 0] = sizes[2 * j + 1] = 0;
+            }
+        }
+        if (numlayers < 2)
+            continue;
+
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        pglTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, numlayers, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        /* the loader keeps no pixels, copy them back from the textures */
+        pixels = (GLubyte *)malloc(sizeof(GLubyte) * 4 * width * height);
+        for (j = 0; j < numlayers; j++) {
+            texture = &model->textures[layers[j]];
+            glBindTexture(GL_TEXTURE_2D, texture->id);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            pglTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, j, width, height, 1,
+                             GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            glDeleteTextures(1, &texture->id);
+            /* models loading the texture later get the layer */
+            if (model->texturecache) {
+                cached = glmCachedTexture(model->texturecache, texture);
+                cached->id = array;
+                cached->target = GL_TEXTURE_2D_ARRAY;
+                cached->layer = j;
+            }
+            texture->id = array;
+            texture->target = GL_TEXTURE_2D_ARRAY;
+            texture->layer = j;
+        }
+        free(pixels);
+
+        /* same sampling as glmLoadTexture */
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        pglGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+        model->numtexturearrays++;
+        numpacked += numlayers;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    free(sizes);
+    free(layers);
+
+    /* the layers go into the vertices, the texture kinds into the materials */
+    if (numpacked) {
+        model->buffermode = GLM_NOBUFFERS;
+        if (model->materialbuffer)
+            pglDeleteBuffers(1, &model->materialbuffer);
+        model->materialbuffer = 0;
+    }
+
+#if 0
+    printf("glmPackTextures(): %d textures in %d arrays\n", numpacked, model->numtexturearrays);
+#endif
+
+    return numpacked;
+}
+
+/* glmGroupLess: orders groups by texture object, then by material */
+static GLboolean
+glmGroupLess(GLMmodel *model, GLMgroup *a, GLMgroup *b)
+{
+    GLMtexture *texture;
+    GLuint ta, tb;
+
+    texture = glmGroupTexture(model, a);
+    ta = texture ? texture->id : 0;
+    texture = glmGroupTexture(model, b);
+    tb = texture ? texture->id : 0;
+
+    if (ta != tb)
+        return ta < tb ? GL_TRUE : GL_FALSE;
+    return a->material < b->material ? GL_TRUE : GL_FALSE;
+}
+
+/* glmSortGroups: Sorts the groups of a model by texture and then by
+ * material, so that glmDraw changes state as rarely as possible.  The
+ * sort is stable; groups sharing both keep their relative order.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmSortGroups(GLMmodel *model)
+{
+    GLMgroup  *list, *left, *right, *tail, **next;
+    GLuint     width, merges, leftsize, rightsize;
+
+    assert(model);
+
+    /* bottom-up merge sort of the linked list */
+    list = model->groups;
+    for (width = 1; list; width *= 2) {
+        left = list;
+        list = NULL;
+        next = &list;
+        merges = 0;
+        while (left) {
+            merges++;
+            right = left;
+            for (leftsize = 0; right && leftsize < width; leftsize++)
+                right = right->next;
+            rightsize = width;
+
+            while (leftsize || (rightsize && right)) {
+                if (!leftsize || (rightsize && right && glmGroupLess(model, right, left))) {
+                    tail = right;
+                    right = right->next;
+                    rightsize--;
+                } else {
+                    tail = left;
+                    left = left->next;
+                    leftsize--;
+                }
+                *next = tail;
+                next = &tail->next;
+            }
+            left = right;
+        }
+        *next = NULL;
+        if (merges <= 1)
+            break;
+    }
+    model->groups = list;
+    model->buffermode = GLM_NOBUFFERS;
+}
+
+/* glmRadixSort: sorts values by their keys (least significant digit
+ * first, stable).  Both arrays are sorted in place.
+ *
+ * keys   - array of n keys
+ * values - array of n values that travel with the keys
+ * n      - number of keys
+ * bits   - number of significant bits in the keys
+ */
+static GLvoid
+glmRadixSort(GLuint *keys, GLuint *values, GLuint n, GLuint bits)
+{
+    GLuint *tmpkeys, *tmpvalues, *swap;
+    GLuint  count[1 << 11];
+    GLuint  shift, digit, sum, c, i;
+
+    tmpkeys = (GLuint *)malloc(sizeof(GLuint) * (n + 1));
+    tmpvalues = (GLuint *)malloc(sizeof(GLuint) * (n + 1));
+
+    for (shift = 0; shift < bits; shift += 11) {
+        memset(count, 0, sizeof(count));
+        for (i = 0; i < n; i++)
+            count[(keys[i] >> shift) & 0x7ff]++;
+        for (sum = 0, digit = 0; digit < (1 << 11); digit++) {
+            c = count[digit];
+            count[digit] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; i++) {
+            c = count[(keys[i] >> shift) & 0x7ff]++;
+            tmpkeys[c] = keys[i];
+            tmpvalues[c] = values[i];
+        }
+        swap = keys; keys = tmpkeys; tmpkeys = swap;
+        swap = values; values = tmpvalues; tmpvalues = swap;
+    }
+
+    /* an odd number of passes leaves the result in the scratch arrays */
+    if ((bits + 10) / 11 % 2) {
+        memcpy(tmpkeys, keys, sizeof(GLuint) * n);
+        memcpy(tmpvalues, values, sizeof(GLuint) * n);
+        swap = keys; keys = tmpkeys; tmpkeys = swap;
+        swap = values; values = tmpvalues; tmpvalues = swap;
+    }
+    free(tmpkeys);
+    free(tmpvalues);
+}
+
+/* glmMortonSpread: spreads the low 10 bits of x to every third bit */
+static GLuint
+glmMortonSpread(GLuint x)
+{
+    if (x > 0x3ff)
+        x = 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+}
+
+/* glmReorder: Reorders the vertices and triangles of a model for
+ * memory locality.  Vertices are first sorted along a 3D Morton (Z
+ * order) curve, the triangles of each group are sorted by their
+ * vertices and packed group by group, and finally the vertices are
+ * renumbered in the order the triangle list first uses them.  All
+ * indices are remapped in place.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmReorder(GLMmodel *model)
+{
+    GLMgroup    *group;
+    GLMtriangle *triangles;
+    GLfloat     *vectors;
+    GLfloat      bounds[6], scale[3];
+    GLuint      *keys, *order, *remap, *placed;
+    GLuint       numtriangles, bits, first, i, j, k, v;
+
+    assert(model);
+    assert(model->vertices);
+
+    /* the levels of detail refer to the old vertices and triangles */
+    glmDeleteLODs(model);
+
+    if (!model->numvertices)
+        return;
+
+    /* sort the vertices by the Morton code of their position quantized
+       to a 1024^3 grid over the bounding box */
+    glmBounds(model, bounds);
+    for (j = 0; j < 3; j++)
+        scale[j] = bounds[j + 3] > bounds[j] ? 1023.0 / (bounds[j + 3] - bounds[j]) : 0.0;
+
+    keys = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    order = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    for (i = 0; i < model->numvertices; i++) {
+        vectors = &model->vertices[3 * (i + 1)];
+        keys[i] = glmMortonSpread((GLuint)((vectors[0] - bounds[0]) * scale[0])) |
+                  glmMortonSpread((GLuint)((vectors[1] - bounds[1]) * scale[1])) << 1 |
+                  glmMortonSpread((GLuint)((vectors[2] - bounds[2]) * scale[2])) << 2;
+        order[i] = i + 1;
+    }
+    glmRadixSort(keys, order, model->numvertices, 30);
+
+    remap = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    for (i = 0; i < model->numvertices; i++)
+        remap[order[i]] = i + 1;
+    for (i = 0; i < model->numtriangles; i++)
+        for (j = 0; j < 3; j++)
+            T(i).vindices[j] = remap[T(i).vindices[j]];
+
+    /* pack the triangles group by group, each group sorted by the
+       lowest Morton ranked vertex of its triangles */
+    triangles = (GLMtriangle *)malloc(sizeof(GLMtriangle) * (model->numtriangles + 1));
+    placed = (GLuint *)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    for (i = 0; i < model->numtriangles; i++)
+        placed[i] = (GLuint)-1;
+    for (bits = 1; (1u << bits) <= model->numvertices; bits++);
+
+    numtriangles = 0;
+    group = model->groups;
+    while (group) {
+        keys = (GLuint *)realloc(keys, sizeof(GLuint) * (group->numtriangles + 1));
+        for (i = 0; i < group->numtriangles; i++) {
+            k = group->triangles[i];
+            v = T(k).vindices[0];
+            if (T(k).vindices[1] < v) v = T(k).vindices[1];
+            if (T(k).vindices[2] < v) v = T(k).vindices[2];
+            keys[i] = v;
+        }
+        glmRadixSort(keys, group->triangles, group->numtriangles, bits);
+
+        for (i = 0; i < group->numtriangles; i++) {
+            k = group->triangles[i];
+            if (placed[k] == (GLuint)-1) {
+                triangles[numtriangles] = T(k);
+                placed[k] = numtriangles++;
+            }
+            group->triangles[i] = placed[k];
+        }
+        group = group->next;
+    }
+
+    /* triangles that are in no group keep their relative order */
+    for (i = 0; i < model->numtriangles; i++) {
+        if (placed[i] == (GLuint)-1)
+            triangles[numtriangles++] = T(i);
+    }
+    free(placed);
+    free(model->triangles);
+    model->triangles = triangles;
+
+    /* facet normals follow their triangles */
+    if (model->facetnorms) {
+        vectors = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (model->numfacetnorms + 1));
+        memcpy(vectors, model->facetnorms, sizeof(GLfloat) * 3);
+        for (i = 0; i < model->numtriangles; i++) {
+            memcpy(&vectors[3 * (i + 1)], &model->facetnorms[3 * T(i).findex],
+                   sizeof(GLfloat) * 3);
+            T(i).findex = i + 1;
+        }
+        free(model->facetnorms);
+        model->facetnorms = vectors;
+    }
+
+    /* renumber the vertices by first use; unused ones go last, still in
+       Morton order.  keys[] maps the new index to the Morton index */
+    keys = (GLuint *)realloc(keys, sizeof(GLuint) * (model->numvertices + 1));
+    for (i = 1; i <= model->numvertices; i++)
+        remap[i] = 0;
+    first = 0;
+    for (i = 0; i < model->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            v = T(i).vindices[j];
+            if (!remap[v]) {
+                remap[v] = ++first;
+                keys[first - 1] = v;
+            }
+            T(i).vindices[j] = remap[v];
+        }
+    }
+    for (i = 1; i <= model->numvertices; i++) {
+        if (!remap[i]) {
+            remap[i] = ++first;
+            keys[first - 1] = i;
+        }
+    }
+
+    /* gather the vertices through both permutations in a single pass */
+    vectors = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    memcpy(vectors, model->vertices, sizeof(GLfloat) * 3);
+    for (i = 0; i < model->numvertices; i++)
+        memcpy(&vectors[3 * (i + 1)], &model->vertices[3 * order[keys[i] - 1]],
+               sizeof(GLfloat) * 3);
+    free(model->vertices);
+    model->vertices = vectors;
+
+    free(keys);
+    free(remap);
+    free(order);
+    model->buffermode = GLM_NOBUFFERS;
+}
+
+/* _GLMshape: canonical form of a group used by glmDetectInstances */
+typedef struct _GLMshape {
+    GLMgroup *group;              /* group the shape was taken from */
+    GLuint    hash;               /* signature of the triangle layout */
+    GLuint    numlocal;           /* number of distinct vertices */
+    GLuint   *local;              /* model vertex index of each local vertex */
+    GLuint   *topology;           /* local vertex indices, 3 per triangle */
+    GLfloat   centroid[3];        /* average of the local vertices */
+    GLfloat   frame[9];           /* orthonormal frame (columns) */
+    GLuint    axes[2];            /* local vertices the frame was built from */
+    struct _GLMshape *next;       /* next shape in the hash bucket */
+} GLMshape;
+
+/* glmShapeFrame: builds the orthonormal frame of a shape from the
+ * local vertices axes[0] and axes[1], searching for suitable ones if
+ * search is set.  Returns GL_FALSE if the shape is flat along a line.
+ */
+static GLboolean
+glmShapeFrame(GLMmodel *model, GLMshape *shape, GLboolean search, GLfloat epsilon)
+{
+    GLfloat *e1 = &shape->frame[0], *e2 = &shape->frame[3], *e3 = &shape->frame[6];
+    GLfloat  d, *p;
+    GLuint   i, j;
+
+    for (i = search ? 0 : shape->axes[0]; i < shape->numlocal; i++) {
+        p = &model->vertices[3 * shape->local[i]];
+        for (j = 0; j < 3; j++)
+            e1[j] = p[j] - shape->centroid[j];
+        if (glmDot(e1, e1) > epsilon * epsilon || !search)
+            break;
+    }
+    if (i >= shape->numlocal || glmDot(e1, e1) <= epsilon * epsilon)
+        return GL_FALSE;
+    shape->axes[0] = i;
+    glmNormalize(e1);
+
+    for (i = search ? 0 : shape->axes[1]; i < shape->numlocal; i++) {
+        p = &model->vertices[3 * shape->local[i]];
+        for (j = 0; j < 3; j++)
+            e2[j] = p[j] - shape->centroid[j];
+        d = glmDot(e1, e2);
+        for (j = 0; j < 3; j++)
+            e2[j] -= d * e1[j];
+        if (glmDot(e2, e2) > epsilon * epsilon || !search)
+            break;
+    }
+    if (i >= shape->numlocal || glmDot(e2, e2) <= epsilon * epsilon)
+        return GL_FALSE;
+    shape->axes[1] = i;
+    glmNormalize(e2);
+    glmCross(e1, e2, e3);
+
+    return GL_TRUE;
+}
+
+/* glmShapeBuild: fills in the canonical form of a group.  stamp and
+ * slot are scratch arrays of numvertices + 1 entries; stamp must not
+ * contain the value tag yet.
+ */
+static GLvoid
+glmShapeBuild(GLMmodel *model, GLMgroup *group, GLMshape *shape,
+              GLuint *stamp, GLuint *slot, GLuint tag)
+{
+    GLfloat *p;
+    GLuint   i, j, v, h;
+
+    shape->group = group;
+    shape->local = (GLuint *)malloc(sizeof(GLuint) * 3 * group->numtriangles);
+    shape->topology = (GLuint *)malloc(sizeof(GLuint) * 3 * group->numtriangles);
+    shape->numlocal = 0;
+    shape->centroid[0] = shape->centroid[1] = shape->centroid[2] = 0.0;
+    shape->next = NULL;
+
+    for (i = 0; i < group->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            v = T(group->triangles[i]).vindices[j];
+            if (stamp[v] != tag) {
+                stamp[v] = tag;
+                slot[v] = shape->numlocal;
+                shape->local[shape->numlocal++] = v;
+                p = &model->vertices[3 * v];
+                shape->centroid[0] += p[0];
+                shape->centroid[1] += p[1];
+                shape->centroid[2] += p[2];
+            }
+            shape->topology[3 * i + j] = slot[v];
+        }
+    }
+    shape->centroid[0] /= shape->numlocal;
+    shape->centroid[1] /= shape->numlocal;
+    shape->centroid[2] /= shape->numlocal;
+
+    /* FNV-1a over the counts and the topology only; positions read
+       back from text differ in the last digits, so glmShapeMatch
+       compares them within epsilon */
+    h = 2166136261u;
+    h = (h ^ group->numtriangles) * 16777619u;
+    h = (h ^ shape->numlocal) * 16777619u;
+    for (i = 0; i < 3 * group->numtriangles; i++)
+        h = (h ^ shape->topology[i]) * 16777619u;
+    shape->hash = h;
+}
+
+/* glmShapeMatch: checks that shape b is shape a moved by a rotation and
+ * a translation, and returns that transform (column-major) in matrix.
+ */
+static GLboolean
+glmShapeMatch(GLMmodel *model, GLMshape *a, GLMshape *b, GLfloat epsilon,
+              GLfloat *matrix)
+{
+    GLMtriangle *ta, *tb;
+    GLfloat      R[9], q[3], *pa, *pb, *na, *nb;
+    GLuint       i, j, k;
+
+    if (a->numlocal != b->numlocal || a->group->numtriangles != b->group->numtriangles)
+        return GL_FALSE;
+    if (memcmp(a->topology, b->topology, sizeof(GLuint) * 3 * a->group->numtriangles))
+        return GL_FALSE;
+
+    /* build the frame of b from the same local vertices as a */
+    b->axes[0] = a->axes[0];
+    b->axes[1] = a->axes[1];
+    if (!glmShapeFrame(model, b, GL_FALSE, epsilon))
+        return GL_FALSE;
+
+    /* R = Fb * Fa^T */
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 3; j++)
+            R[3 * j + i] = b->frame[i] * a->frame[j] +
+                           b->frame[3 + i] * a->frame[3 + j] +
+                           b->frame[6 + i] * a->frame[6 + j];
+
+    /* every vertex must land on its counterpart */
+    for (k = 0; k < a->numlocal; k++) {
+        pa = &model->vertices[3 * a->local[k]];
+        pb = &model->vertices[3 * b->local[k]];
+        for (i = 0; i < 3; i++)
+            q[i] = R[i] * (pa[0] - a->centroid[0]) +
+                   R[3 + i] * (pa[1] - a->centroid[1]) +
+                   R[6 + i] * (pa[2] - a->centroid[2]) + b->centroid[i] - pb[i];
+        if (glmDot(q, q) > epsilon * epsilon)
+            return GL_FALSE;
     }
-    if (mode & GLM_COLOR && mode & GLM_MATERIAL) {
-        printf("glmDraw() warning: color and material render mode requested "
-               "using only material mode.\n");
-        mode &= ~GLM_COLOR;
+
+    /* and so must the texture coordinates and (rotated) normals */
+    for (k = 0; k < a->group->numtriangles; k++) {
+        ta = &T(a->group->triangles[k]);
+        tb = &T(b->group->triangles[k]);
+        for (j = 0; j < 3; j++) {
+            if (model->texcoords &&
+                    ta->tindices[j] <= model->numtexcoords && tb->tindices[j] <= model->numtexcoords) {
+                pa = &model->texcoords[2 * ta->tindices[j]];
+                pb = &model->texcoords[2 * tb->tindices[j]];
+                if (glmAbs(pa[0] - pb[0]) > epsilon || glmAbs(pa[1] - pb[1]) > epsilon)
+                    return GL_FALSE;
+            }
+            if (model->normals &&
+                    ta->nindices[j] <= model->numnormals && tb->nindices[j] <= model->numnormals) {
+                na = &model->normals[3 * ta->nindices[j]];
+                nb = &model->normals[3 * tb->nindices[j]];
+                for (i = 0; i < 3; i++)
+                    q[i] = R[i] * na[0] + R[3 + i] * na[1] + R[6 + i] * na[2] - nb[i];
+                if (glmDot(q, q) > 1e-4)
+                    return GL_FALSE;
+            }
+        }
     }
-    if (mode & GLM_COLOR)
-        glEnable(GL_COLOR_MATERIAL);
-    else if (mode & GLM_MATERIAL)
-        glDisable(GL_COLOR_MATERIAL);
-    if (mode & GLM_TEXTURE) {
-        glEnable(GL_TEXTURE_2D);
-        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < 3; i++)
+            matrix[4 * j + i] = R[3 * j + i];
+        matrix[4 * j + 3] = 0.0;
     }
-    /* perhaps this loop should be unrolled into material, color, flat,
-       smooth, etc. loops?  since most cpu's have good branch prediction
-       schemes (and these branches will always go one way), probably
-       wouldn't gain too much?  */
+    for (i = 0; i < 3; i++)
+        matrix[12 + i] = b->centroid[i] - (R[i] * a->centroid[0] +
+                                           R[3 + i] * a->centroid[1] +
+                                           R[6 + i] * a->centroid[2]);
+    matrix[15] = 1.0;
+
+    return GL_TRUE;
+}
+
+/* glmDetectInstances: Finds groups that are rigidly moved (translated
+ * and rotated) copies of another group, with the same triangle layout.
+ * Each such group keeps its name and material but drops its triangles
+ * and instead draws the triangles of its prototype group through a
+ * transform.  Returns the number of groups turned into instances; run
+ * glmCompact afterwards to release the geometry they no longer use.
+ * glmWriteOBJ writes instanced groups out as placed copies again.
+ *
+ * model   - initialized GLMmodel structure
+ * epsilon - maximum distance between a vertex and its transformed
+ *           prototype vertex
+ */
+GLuint
+glmDetectInstances(GLMmodel *model, GLfloat epsilon)
+{
+    GLMgroup  *group;
+    GLMshape **table, *shapes, *shape, *candidate;
+    GLuint    *stamp, *slot;
+    GLuint     tablesize, numshapes, numinstances, tag;
+
+    assert(model);
+    assert(model->vertices);
+
+    /* instances draw the levels of their prototypes */
+    glmDeleteLODs(model);
+
+    for (tablesize = 1; tablesize < 2 * model->numgroups; tablesize <<= 1);
+    table = (GLMshape **)calloc(tablesize, sizeof(GLMshape *));
+    shapes = (GLMshape *)malloc(sizeof(GLMshape) * (model->numgroups + 1));
+    stamp = (GLuint *)calloc(model->numvertices + 1, sizeof(GLuint));
+    slot = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
 
-    IDTextura = -1;
+    numshapes = numinstances = 0;
+    tag = 0;
     group = model->groups;
     while (group) {
-        if (drawonly)
-            if (strcmp(group->name,drawonly)) {
-                group=group->next;
-                continue;
-            }
+        if (!group->numtriangles || group->prototype) {
+            group = group->next;
+            continue;
+        }
 
-        material = &model->materials[group->material];
-        if (material)
-            IDTextura = material->IDTextura;
-        else IDTextura=-1;
+        shape = &shapes[numshapes];
+        glmShapeBuild(model, group, shape, stamp, slot, ++tag);
 
-        if (mode & GLM_MATERIAL) {
-            glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
-            glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+        candidate = table[shape->hash & (tablesize - 1)];
+        while (candidate) {
+            if (candidate->hash == shape->hash &&
+                    glmShapeMatch(model, candidate, shape, epsilon, group->transform))
+                break;
+            candidate = candidate->next;
         }
 
-        if (mode & GLM_TEXTURE) {
-            if (IDTextura == -1)
-                glBindTexture(GL_TEXTURE_2D, 0);
-            else
-                glBindTexture(GL_TEXTURE_2D, model->textures[IDTextura].id);
+        if (candidate) {
+            /* an instance: draw the prototype instead */
+            group->prototype = candidate->group;
+            free(group->triangles);
+            group->triangles = NULL;
+            group->numtriangles = 0;
+            free(shape->local);
+            free(shape->topology);
+            numinstances++;
+        } else if (glmShapeFrame(model, shape, GL_TRUE, epsilon)) {
+            /* a new prototype */
+            shape->next = table[shape->hash & (tablesize - 1)];
+            table[shape->hash & (tablesize - 1)] = shape;
+            numshapes++;
+        } else {
+            free(shape->local);
+            free(shape->topology);
         }
+        group = group->next;
+    }
 
-        if (mode & GLM_COLOR) {
-            glColor3fv(material->diffuse);
+    while (numshapes--) {
+        free(shapes[numshapes].local);
+        free(shapes[numshapes].topology);
+    }
+    free(shapes);
+    free(table);
+    free(stamp);
+    free(slot);
+
+    if (numinstances)
+        model->buffermode = GLM_NOBUFFERS;
+
+    return numinstances;
+}
+
+/* glmClusterVertices: maps every vertex to the vertex closest to the
+ * mean of the vertices in the same cell of a grid
+ *
+ * bounds  - bounding box of the model, where the grid starts
+ * cell    - size of the cells
+ * cluster - mapping, one per vertex (1 based)
+ */
+static GLvoid
+glmClusterVertices(GLMmodel *model, GLfloat *bounds, GLfloat cell, GLuint *cluster)
+{
+    GLuint  *hash, *cells, *counts, *slot, *best;
+    GLfloat *sums, *distances, *p, mean[3], d;
+    GLuint   hashsize, numcells, h, key[3], c, i, j;
+
+    /* open addressing table of cell index + 1 keyed by the cell */
+    for (hashsize = 1; hashsize < 2 * model->numvertices; hashsize <<= 1);
+    hash = (GLuint *)calloc(hashsize, sizeof(GLuint));
+    cells = (GLuint *)malloc(sizeof(GLuint) * 3 * model->numvertices);
+    sums = (GLfloat *)calloc(3 * model->numvertices, sizeof(GLfloat));
+    counts = (GLuint *)calloc(model->numvertices, sizeof(GLuint));
+    slot = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+
+    numcells = 0;
+    for (i = 1; i <= model->numvertices; i++) {
+        p = &model->vertices[3 * i];
+        for (j = 0; j < 3; j++)
+            key[j] = (GLuint)((p[j] - bounds[j]) / cell);
+        h = (key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u) & (hashsize - 1);
+        while (hash[h] && memcmp(&cells[3 * (hash[h] - 1)], key, sizeof(key)))
+            h = (h + 1) & (hashsize - 1);
+        if (!hash[h]) {
+            memcpy(&cells[3 * numcells], key, sizeof(key));
+            hash[h] = ++numcells;
         }
+        c = hash[h] - 1;
+        slot[i] = c;
+        for (j = 0; j < 3; j++)
+            sums[3 * c + j] += p[j];
+        counts[c]++;
+    }
 
-        glBegin(GL_TRIANGLES);
+    best = (GLuint *)calloc(numcells, sizeof(GLuint));
+    distances = (GLfloat *)malloc(sizeof(GLfloat) * numcells);
+    for (i = 1; i <= model->numvertices; i++) {
+        p = &model->vertices[3 * i];
+        c = slot[i];
+        d = 0.0;
+        for (j = 0; j < 3; j++) {
+            mean[j] = sums[3 * c + j] / counts[c] - p[j];
+            d += mean[j] * mean[j];
+        }
+        if (!best[c] || d < distances[c]) {
+            best[c] = i;
+            distances[c] = d;
+        }
+    }
+    cluster[0] = 0;
+    for (i = 1; i <= model->numvertices; i++)
+        cluster[i] = best[slot[i]];
+
+    free(hash);
+    free(cells);
+    free(sums);
+    free(counts);
+    free(slot);
+    free(best);
+    free(distances);
+}
+
+/* glmBuildLODs: Builds coarser levels of detail of every group by
+ * clustering the vertices of the model on grids of 256, 128, 64...
+ * cells across.
+ *
+ * model     - initialized GLMmodel structure
+ * numlevels - levels to build, up to GLM_MAXLODS - 1
+ */
+GLvoid
+glmBuildLODs(GLMmodel *model, GLuint numlevels)
+{
+    GLMgroup    *group;
+    GLMlod      *lod;
+    GLMtriangle  clustered, stored, *triangle;
+    GLfloat      bounds[6], box[6], size, cell, d, *p;
+    GLuint      *cluster, *hash, hashsize, h, key[3], other[3];
+    GLuint       level, i, j, k;
+
+    assert(model);
+    assert(model->vertices);
+
+    glmDeleteLODs(model);
+    if (numlevels > GLM_MAXLODS - 1)
+        numlevels = GLM_MAXLODS - 1;
+    if (!model->numvertices || !numlevels)
+        return;
+
+    glmBounds(model, bounds);
+    size = glmMax(glmMax(bounds[3] - bounds[0], bounds[4] - bounds[1]), bounds[5] - bounds[2]);
+    if (size <= 0.0)
+        return;
+
+    /* the bounding spheres the levels are chosen by */
+    for (group = model->groups; group; group = group->next) {
+        box[0] = box[1] = box[2] = 0.0;
+        box[3] = box[4] = box[5] = 0.0;
         for (i = 0; i < group->numtriangles; i++) {
             triangle = &T(group->triangles[i]);
-#ifdef DebugVisibleSurfaces
-            if (!triangle->visible) continue;
-#endif
-            if (mode & GLM_FLAT)
-                glNormal3fv(&model->facetnorms[3 * triangle->findex]);
+            for (j = 0; j < 3; j++) {
+                p = &model->vertices[3 * triangle->vindices[j]];
+                for (k = 0; k < 3; k++) {
+                    if ((!i && !j) || p[k] < box[k])
+                        box[k] = p[k];
+                    if ((!i && !j) || p[k] > box[k + 3])
+                        box[k + 3] = p[k];
+                }
+            }
+        }
+        for (k = 0; k < 3; k++)
+            group->sphere[k] = (box[k] + box[k + 3]) / 2.0;
+        group->sphere[3] = 0.0;
+        for (i = 0; i < group->numtriangles; i++) {
+            triangle = &T(group->triangles[i]);
+            for (j = 0; j < 3; j++) {
+                p = &model->vertices[3 * triangle->vindices[j]];
+                d = sqrt((p[0] - group->sphere[0]) * (p[0] - group->sphere[0]) +
+                         (p[1] - group->sphere[1]) * (p[1] - group->sphere[1]) +
+                         (p[2] - group->sphere[2]) * (p[2] - group->sphere[2]));
+                if (d > group->sphere[3])
+                    group->sphere[3] = d;
+            }
+        }
+    }
 
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[0]]);
-            if (mode & GLM_TEXTURE)
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[0]]);
-            glVertex3fv(&model->vertices[3 * triangle->vindices[0]]);
+    cluster = (GLuint *)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    for (level = 1; level <= numlevels; level++) {
+        cell = size / (256 >> (level - 1));
+        glmClusterVertices(model, bounds, cell, cluster);
 
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[1]]);
-            if (mode & GLM_TEXTURE) {
-                //if (IDTextura==-1) printf("Warning: GLM_TEXTURE este on dar nu este setata nici o textura in material!");
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[1]]);
+        for (group = model->groups; group; group = group->next) {
+            /* instances are drawn at the levels of their prototype */
+            if (group->prototype)
+                continue;
+
+            group->lods = (GLMlod *)realloc(group->lods, sizeof(GLMlod) * level);
+            group->numlods = level;
+            lod = &group->lods[level - 1];
+            lod->numtriangles = 0;
+            lod->triangles = (GLuint *)malloc(sizeof(GLuint) * (group->numtriangles + 1));
+            lod->vindices = (GLuint *)malloc(sizeof(GLuint) * 3 * (group->numtriangles + 1));
+            lod->error = cell * sqrt(3.0);
+            lod->first = 0;
+
+            /* open addressing table of triangle + 1 keyed by its vertices */
+            for (hashsize = 1; hashsize < 2 * group->numtriangles; hashsize <<= 1);
+            hash = (GLuint *)calloc(hashsize, sizeof(GLuint));
+
+            for (i = 0; i < group->numtriangles; i++) {
+                triangle = &T(group->triangles[i]);
+                for (j = 0; j < 3; j++)
+                    clustered.vindices[j] = cluster[triangle->vindices[j]];
+                if (clustered.vindices[0] == clustered.vindices[1] ||
+                        clustered.vindices[1] == clustered.vindices[2] ||
+                        clustered.vindices[2] == clustered.vindices[0])
+                    continue;
+
+                /* triangles collapsing onto the same corners are drawn once */
+                glmTriangleKey(&clustered, key);
+                h = (key[0] * 73856093u ^ key[1] * 19349663u ^ key[2] * 83492791u) & (hashsize - 1);
+                while (hash[h]) {
+                    memcpy(stored.vindices, &lod->vindices[3 * (hash[h] - 1)], sizeof(key));
+                    glmTriangleKey(&stored, other);
+                    if (!memcmp(other, key, sizeof(key)))
+                        break;
+                    h = (h + 1) & (hashsize - 1);
+                }
+                if (hash[h])
+                    continue;
+                hash[h] = lod->numtriangles + 1;
+
+                /* corners keep their order, they pair with the normals and texcoords */
+                lod->triangles[lod->numtriangles] = group->triangles[i];
+                memcpy(&lod->vindices[3 * lod->numtriangles], clustered.vindices, sizeof(key));
+                lod->numtriangles++;
             }
-            glVertex3fv(&model->vertices[3 * triangle->vindices[1]]);
+            free(hash);
+        }
+        model->numlods = level;
+    }
+    free(cluster);
 
-            if (mode & GLM_SMOOTH)
-                glNormal3fv(&model->normals[3 * triangle->nindices[2]]);
-            if (mode & GLM_TEXTURE)
-                glTexCoord2fv(&model->texcoords[2 * triangle->tindices[2]]);
-            glVertex3fv(&model->vertices[3 * triangle->vindices[2]]);
+    /* the levels go into the index buffer */
+    model->buffermode = GLM_NOBUFFERS;
+
+#if 0
+    printf("glmBuildLODs(): %d levels\n", model->numlods);
+#endif
+}
+
+/* glmDeleteLODs: Deletes the levels of detail of a model.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmDeleteLODs(GLMmodel *model)
+{
+    GLMgroup *group;
+    GLuint    i;
+
+    assert(model);
 
+    if (!model->numlods)
+        return;
+
+    for (group = model->groups; group; group = group->next) {
+        for (i = 0; i < group->numlods; i++) {
+            free(group->lods[i].triangles);
+            free(group->lods[i].vindices);
         }
-        glEnd();
+        if (group->lods)
+            free(group->lods);
+        group->lods = NULL;
+        group->numlods = 0;
+        group->lod = 0;
+    }
+    model->numlods = 0;
+    memset(model->lodtriangles, 0, sizeof(model->lodtriangles));
 
-        group = group->next;
+    /* the index buffer holds the levels */
+    model->buffermode = GLM_NOBUFFERS;
+}
+
+/* glmBuildPointNode: adds the octree node of the points order[begin]
+ * to order[end - 1] of a point cloud, which are sorted by their Morton
+ * keys and fall in the cube at center with half edge size, depth levels
+ * below the root.  Every stride-th point along the curve is stored in
+ * the node, an even subsample of its cube; the others are compacted in
+ * place and passed on to the children.  Returns the index of the node.
+ */
+static GLuint
+glmBuildPointNode(GLMpointcloud *cloud, GLuint *keys, GLuint *order, GLuint begin,
+                  GLuint end, GLuint depth, GLfloat *center, GLfloat size,
+                  GLfloat *positions, GLubyte *colors)
+{
+    static const GLuint nodepoints = 4096;
+    GLMpointnode *node;
+    GLMpoint     *point;
+    GLfloat       childcenter[3], *p, q;
+    GLuint        index, stride, rest, child, shift, octant, i, j, k;
+
+    /* the nodes grow by doubling */
+    index = cloud->numnodes++;
+    if (index && !(index & (index - 1)))
+        cloud->nodes = (GLMpointnode *)realloc(cloud->nodes, sizeof(GLMpointnode) * 2 * index);
+
+    node = &cloud->nodes[index];
+    memcpy(node->center, center, sizeof(GLfloat) * 3);
+    node->size = size;
+    node->first = cloud->numpoints;
+    memset(node->children, 0, sizeof(node->children));
+
+    /* the keys run out of bits 10 levels down */
+    stride = 1;
+    if (depth < 10 && end - begin > nodepoints)
+        stride = (end - begin + nodepoints - 1) / nodepoints;
+
+    rest = begin;
+    for (i = begin; i < end; i++) {
+        if ((i - begin) % stride) {
+            keys[rest] = keys[i];
+            order[rest] = order[i];
+            rest++;
+            continue;
+        }
+        point = &cloud->points[cloud->numpoints++];
+        p = &positions[3 * order[i]];
+        for (j = 0; j < 3; j++) {
+            q = (p[j] - center[j]) / size * 32767.0;
+            q = q < -32767.0 ? -32767.0 : q > 32767.0 ? 32767.0 : q;
+            point->position[j] = (GLshort)floor(q + 0.5);
+        }
+        point->position[3] = 0;
+        memcpy(point->color, &colors[4 * order[i]], sizeof(GLubyte) * 4);
     }
+    node->numpoints = cloud->numpoints - node->first;
+    /* scans are surfaces, n points over a cube are about edge / sqrt(n) apart */
+    node->spacing = 2.0 * size / sqrt((GLfloat)node->numpoints);
+
+    /* the points left come in runs of the same octant at this depth */
+    shift = 3 * (9 - depth);
+    for (i = begin; i < rest; i = j) {
+        octant = (keys[i] >> shift) & 7;
+        for (j = i + 1; j < rest && ((keys[j] >> shift) & 7) == octant; j++);
+        for (k = 0; k < 3; k++)
+            childcenter[k] = center[k] + ((octant >> k) & 1 ? 0.5 : -0.5) * size;
+        child = glmBuildPointNode(cloud, keys, order, i, j, depth + 1, childcenter,
+                                  size / 2.0, positions, colors);
+        cloud->nodes[index].children[octant] = child;
+    }
+
+    return index;
 }
 
-/* glmList: Generates and returns a display list for the model using
- * the mode specified.
+/* glmReadPoints: reads the vertices of a Wavefront OBJ file without
+ * faces into the octree of a point cloud.  Every vertex is kept up to
+ * maxpoints of them, beyond that an even subsample of the file.
  *
- * model - initialized GLMmodel structure
- * mode  - a bitwise OR of values describing what is to be rendered.
- *             GLM_NONE     -  render with only vertices
- *             GLM_FLAT     -  render with facet normals
- *             GLM_SMOOTH   -  render with vertex normals
- *             GLM_TEXTURE  -  render with texture coords
- *             GLM_COLOR    -  render with colors (color material)
- *             GLM_MATERIAL -  render with materials
- *             GLM_COLOR and GLM_MATERIAL should not both be specified.
- * GLM_FLAT and GLM_SMOOTH should not both be specified.
+ * model     - model counted by glmFirstPass
+ * file      - (fopen'd) file descriptor, rewound
+ * maxpoints - points to keep at most
  */
-GLuint
-glmList(GLMmodel *model, GLuint mode)
+static GLvoid
+glmReadPoints(GLMmodel *model, FILE *file, GLuint maxpoints)
 {
-    GLuint list;
+    GLMpointcloud *cloud;
+    GLfloat  *positions, *p, value[6], center[3], size, scale;
+    GLubyte  *colors, *c;
+    GLuint   *keys, *order, numpoints, line, cell, i, j, n;
+    char      buf[256], *s, *e;
+
+    cloud = (GLMpointcloud *)malloc(sizeof(GLMpointcloud));
+    cloud->totalpoints = model->numvertices;
+    cloud->numpoints = 0;
+    cloud->numnodes = 0;
+    cloud->nodes = NULL;
+    cloud->colors = GL_FALSE;
+    cloud->pointbuffer = 0;
+    memset(cloud->bounds, 0, sizeof(cloud->bounds));
+    model->pointcloud = cloud;
+
+    numpoints = cloud->totalpoints < maxpoints ? cloud->totalpoints : maxpoints;
+    positions = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (numpoints + 1));
+    colors = (GLubyte *)malloc(sizeof(GLubyte) * 4 * (numpoints + 1));
+
+    n = line = 0;
+    while (n < numpoints && fgets(buf, sizeof(buf), file)) {
+        if (buf[0] != 'v' || (buf[1] != ' ' && buf[1] != '\t'))
+            continue;
+        /* keep the vertex if it takes the count kept to the next integer */
+        line++;
+        if ((unsigned long long)line * numpoints / cloud->totalpoints ==
+                (unsigned long long)(line - 1) * numpoints / cloud->totalpoints)
+            continue;
 
-    list = glGenLists(1);
-    glNewList(list, GL_COMPILE);
-    glmDraw(model, mode);
-    glEndList();
+        /* x y z, perhaps followed by r g b */
+        s = buf + 2;
+        for (i = 0; i < 6; i++, s = e) {
+            value[i] = strtod(s, &e);
+            if (e == s)
+                break;
+        }
+        if (i < 3)
+            continue;
 
-    return list;
+        p = &positions[3 * n];
+        c = &colors[4 * n];
+        p[0] = value[0];
+        p[1] = value[1];
+        p[2] = value[2];
+        c[0] = c[1] = c[2] = c[3] = 255;
+        if (i == 6) {
+            cloud->colors = GL_TRUE;
+            scale = (value[3] > 1.0 || value[4] > 1.0 || value[5] > 1.0) ? 1.0 : 255.0;
+            for (j = 0; j < 3; j++) {
+                value[3 + j] *= scale;
+                c[j] = value[3 + j] < 0.0 ? 0 : value[3 + j] > 255.0 ? 255 : (GLubyte)(value[3 + j] + 0.5);
+            }
+        }
+        n++;
+    }
+    if (n < cloud->totalpoints)
+        printf("glmReadOBJ() warning: %u of the %u points of \"%s\" kept.\n",
+               n, cloud->totalpoints, model->pathname);
+
+    if (n) {
+        cloud->bounds[0] = cloud->bounds[3] = positions[0];
+        cloud->bounds[1] = cloud->bounds[4] = positions[1];
+        cloud->bounds[2] = cloud->bounds[5] = positions[2];
+        for (i = 1; i < n; i++) {
+            p = &positions[3 * i];
+            for (j = 0; j < 3; j++) {
+                if (cloud->bounds[j] > p[j]) cloud->bounds[j] = p[j];
+                if (cloud->bounds[3 + j] < p[j]) cloud->bounds[3 + j] = p[j];
+            }
+        }
+
+        /* the root is the cube around the box */
+        size = 0.0;
+        for (j = 0; j < 3; j++) {
+            center[j] = (cloud->bounds[j] + cloud->bounds[3 + j]) / 2.0;
+            size = glmMax(size, (cloud->bounds[3 + j] - cloud->bounds[j]) / 2.0);
+        }
+        if (size <= 0.0)
+            size = 1.0;
+
+        /* sort the points by the Morton code of their cell in a 1024^3
+           grid over the cube, the nodes are then runs of the codes */
+        keys = (GLuint *)malloc(sizeof(GLuint) * (n + 1));
+        order = (GLuint *)malloc(sizeof(GLuint) * (n + 1));
+        for (i = 0; i < n; i++) {
+            p = &positions[3 * i];
+            keys[i] = 0;
+            for (j = 0; j < 3; j++) {
+                cell = (GLuint)glmMax((p[j] - center[j] + size) / (2.0 * size) * 1024.0, 0.0);
+                keys[i] |= glmMortonSpread(cell) << j;
+            }
+            order[i] = i;
+        }
+        glmRadixSort(keys, order, n, 30);
+
+        cloud->points = (GLMpoint *)malloc(sizeof(GLMpoint) * n);
+        cloud->nodes = (GLMpointnode *)malloc(sizeof(GLMpointnode));
+        glmBuildPointNode(cloud, keys, order, 0, n, 0, center, size, positions, colors);
+
+        free(keys);
+        free(order);
+    } else {
+        cloud->points = (GLMpoint *)malloc(sizeof(GLMpoint));
+    }
+
+    free(positions);
+    free(colors);
 }
 
-/* glmWeld: eliminate (weld) vectors that are within an epsilon of
- * each other.
- *
- * model   - initialized GLMmodel structure
- * epsilon     - maximum difference between vertices
- *               ( 0.00001 is a good start for a unitized model)
+/* glmMovePoints: translates the points of a point cloud by offset and
+ * then scales them, by moving the cubes of the nodes they are stored in.
+ */
+static GLvoid
+glmMovePoints(GLMpointcloud *cloud, GLfloat *offset, GLfloat scale)
+{
+    GLMpointnode *node;
+    GLuint i, j;
+
+    for (i = 0; i < cloud->numnodes; i++) {
+        node = &cloud->nodes[i];
+        for (j = 0; j < 3; j++)
+            node->center[j] = (node->center[j] + offset[j]) * scale;
+        node->size *= scale;
+        node->spacing *= scale;
+    }
+    for (j = 0; j < 6; j++)
+        cloud->bounds[j] = (cloud->bounds[j] + offset[j % 3]) * scale;
+}
+
+/* glmPointSpacing: returns how far apart the points of a node are in
+ * pixels at the point of its cube nearest to the eye, a huge value if
+ * the cube reaches the eye, or -1 if it is out of the view.
  *
+ * node       - node of a point cloud
+ * modelview  - modelview matrix
+ * projection - projection matrix
+ * planes     - planes of the view volume in model units, facing in
+ * scale      - model units to eye units
+ * pixels     - eye units to pixels at w = 1
  */
-GLvoid
-glmWeld(GLMmodel *model, GLfloat epsilon)
+static GLfloat
+glmPointSpacing(GLMpointnode *node, GLfloat *modelview, GLfloat *projection,
+                GLfloat planes[6][4], GLfloat scale, GLfloat pixels)
 {
-    GLfloat *vectors;
-    GLfloat *copies;
-    GLuint   numvectors;
-    GLuint   i;
+    GLfloat radius, eye[3], w;
+    GLuint  i;
 
-    /* vertices */
-    numvectors = model->numvertices;
-    vectors  = model->vertices;
-    copies = glmWeldVectors(vectors, &numvectors, epsilon);
+    radius = node->size * sqrt(3.0);
+    for (i = 0; i < 6; i++)
+        if (planes[i][0] * node->center[0] + planes[i][1] * node->center[1] +
+                planes[i][2] * node->center[2] + planes[i][3] < -radius)
+            return -1.0;
+
+    for (i = 0; i < 3; i++)
+        eye[i] = modelview[i] * node->center[0] + modelview[4 + i] * node->center[1] +
+                 modelview[8 + i] * node->center[2] + modelview[12 + i];
+    w = projection[3] * eye[0] + projection[7] * eye[1] + projection[11] * eye[2] +
+        projection[15] - fabs(projection[11]) * radius * scale;
+    if (w <= 0.0)
+        return 1e30;
+    return node->spacing * pixels / w;
+}
 
-#if 0
-    printf("glmWeld(): %d redundant vertices.\n",
-           model->numvertices - numvectors - 1);
-#endif
+/* glmDrawPointNodes: draws the nodes of a point cloud whose points are
+ * furthest apart on screen first, going down the octree wherever they
+ * are more than a pixel apart, until budget points are drawn.  The
+ * vertex arrays must be set up.  Returns the number of points drawn.
+ */
+static GLuint
+glmDrawPointNodes(GLMmodel *model, GLuint budget)
+{
+    GLMpointcloud *cloud;
+    GLMpointnode  *node;
+    GLfloat        modelview[16], projection[16], clip[16], planes[6][4];
+    GLfloat        scale, pixels, spacing, length, *heapspacing;
+    GLint          viewport[4];
+    GLuint        *heap, heapsize, drawn, index, child, i, j, k;
+
+    cloud = model->pointcloud;
+
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    /* model units to eye units (the transforms scale uniformly), and
+       eye units to pixels at w = 1 */
+    scale = sqrt(modelview[0] * modelview[0] + modelview[1] * modelview[1] +
+                 modelview[2] * modelview[2]);
+    pixels = scale * fabs(projection[5]) * viewport[3] / 2.0;
+
+    /* the planes of the view volume come from the rows of the
+       projection times the modelview (left, right, bottom, top, near,
+       far), scaled to give distances in model units */
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++) {
+            clip[4 * i + j] = 0.0;
+            for (k = 0; k < 4; k++)
+                clip[4 * i + j] += projection[4 * k + j] * modelview[4 * i + k];
+        }
+    for (i = 0; i < 6; i++) {
+        for (j = 0; j < 4; j++)
+            planes[i][j] = clip[4 * j + 3] + (i & 1 ? -1.0 : 1.0) * clip[4 * j + i / 2];
+        length = sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] +
+                      planes[i][2] * planes[i][2]);
+        for (j = 0; j < 4 && length > 0.0; j++)
+            planes[i][j] /= length;
+    }
 
-    for (i = 0; i < model->numtriangles; i++) {
-        T(i).vindices[0] = (GLuint)vectors[3 * T(i).vindices[0] + 0];
-        T(i).vindices[1] = (GLuint)vectors[3 * T(i).vindices[1] + 0];
-        T(i).vindices[2] = (GLuint)vectors[3 * T(i).vindices[2] + 0];
+    /* a max heap of the nodes in view by their spacing on screen */
+    heap = (GLuint *)malloc(sizeof(GLuint) * cloud->numnodes);
+    heapspacing = (GLfloat *)malloc(sizeof(GLfloat) * cloud->numnodes);
+    heapsize = 0;
+    spacing = glmPointSpacing(&cloud->nodes[0], modelview, projection, planes, scale, pixels);
+    if (spacing >= 0.0) {
+        heap[0] = 0;
+        heapspacing[0] = spacing;
+        heapsize = 1;
     }
 
-    /* free space for old vertices */
-    free(vectors);
+    drawn = 0;
+    while (heapsize) {
+        index = heap[0];
+        spacing = heapspacing[0];
+        node = &cloud->nodes[index];
+        if (drawn + node->numpoints > budget)
+            break;
 
-    /* allocate space for the new vertices */
-    model->numvertices = numvectors;
-    model->vertices = (GLfloat *)malloc(sizeof(GLfloat) *
-                                        3 * (model->numvertices + 1));
+        /* pop */
+        heapsize--;
+        for (i = 0; 2 * i + 1 < heapsize; i = j) {
+            j = 2 * i + 1;
+            if (j + 1 < heapsize && heapspacing[j + 1] > heapspacing[j])
+                j++;
+            if (heapspacing[heapsize] >= heapspacing[j])
+                break;
+            heap[i] = heap[j];
+            heapspacing[i] = heapspacing[j];
+        }
+        heap[i] = heap[heapsize];
+        heapspacing[i] = heapspacing[heapsize];
+
+        /* the points are stored relative to the cube of the node */
+        glPushMatrix();
+        glTranslatef(node->center[0], node->center[1], node->center[2]);
+        glScalef(node->size / 32767.0, node->size / 32767.0, node->size / 32767.0);
+        glDrawArrays(GL_POINTS, node->first, node->numpoints);
+        glPopMatrix();
+        drawn += node->numpoints;
+        model->numdrawcalls++;
+
+        if (spacing <= 1.0)
+            continue;
 
-    /* copy the optimized vertices into the actual vertex list */
-    for (i = 1; i <= model->numvertices; i++) {
-        model->vertices[3 * i + 0] = copies[3 * i + 0];
-        model->vertices[3 * i + 1] = copies[3 * i + 1];
-        model->vertices[3 * i + 2] = copies[3 * i + 2];
+        /* push the children in view */
+        for (k = 0; k < 8; k++) {
+            child = node->children[k];
+            if (!child)
+                continue;
+            spacing = glmPointSpacing(&cloud->nodes[child], modelview, projection, planes,
+                                      scale, pixels);
+            if (spacing < 0.0)
+                continue;
+            for (i = heapsize++; i && heapspacing[(i - 1) / 2] < spacing; i = (i - 1) / 2) {
+                heap[i] = heap[(i - 1) / 2];
+                heapspacing[i] = heapspacing[(i - 1) / 2];
+            }
+            heap[i] = child;
+            heapspacing[i] = spacing;
+        }
     }
 
-    free(copies);
+    free(heap);
+    free(heapspacing);
+
+    return drawn;
+}
+
+/* glmDrawPoints: draws the point cloud of a model, unlit, at most
+ * model->pointbudget points of it over all of its instances.  The
+ * points are uploaded into a buffer object on the first call when the
+ * context has them, and drawn from client memory otherwise.
+ */
+static GLvoid
+glmDrawPoints(GLMmodel *model)
+{
+    GLMpointcloud *cloud;
+    GLubyte       *base;
+    GLuint         copies, i;
+    GLboolean      buffers;
+
+    cloud = model->pointcloud;
+    model->numdrawpoints = 0;
+    model->numdrawcalls = 0;
+    model->numdrawgroups = 0;
+    if (!cloud->numnodes)
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+
+    buffers = (glmExtensions() & GLM_EXT_BUFFERS) ? GL_TRUE : GL_FALSE;
+    base = (GLubyte *)cloud->points;
+    if (buffers) {
+        if (!cloud->pointbuffer) {
+            pglGenBuffers(1, &cloud->pointbuffer);
+            pglBindBuffer(GL_ARRAY_BUFFER, cloud->pointbuffer);
+            pglBufferData(GL_ARRAY_BUFFER, sizeof(GLMpoint) * cloud->numpoints,
+                          cloud->points, GL_STATIC_DRAW);
+        } else {
+            pglBindBuffer(GL_ARRAY_BUFFER, cloud->pointbuffer);
+        }
+        base = NULL;
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_SHORT, sizeof(GLMpoint), base + offsetof(GLMpoint, position));
+    if (cloud->colors) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GLMpoint), base + offsetof(GLMpoint, color));
+    }
+
+    copies = model->numinstances ? model->numinstances : 1;
+    for (i = 0; i < copies; i++) {
+        if (model->numinstances) {
+            glPushMatrix();
+            glMultMatrixf(&model->instances[16 * i]);
+        }
+        model->numdrawpoints += glmDrawPointNodes(model, model->pointbudget - model->numdrawpoints);
+        if (model->numinstances)
+            glPopMatrix();
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    if (buffers)
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopAttrib();
 }
 
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
@@ -2027,18 +4942,3 @@ if (model->numtexcoords)
     free(copies);
 }
 #endif
-
-#if 0
-/* look for unused vertices */
-/* look for unused normals */
-/* look for unused texcoords */
-for (i = 1; i <= model->numvertices; i++)
-{
-    for (j = 0; j < model->numtriangles; i++) {
-        if (T(j).vindices[0] == i ||
-                T(j).vindices[1] == i ||
-                T(j).vindices[1] == i)
-            break;
-    }
-}
-#endif
@@ -14,7 +14,11 @@
 
  */
 
+#ifndef GLM_H
+#define GLM_H
+
 #include <GL/gl.h>
+#include <stddef.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265f
@@ -26,6 +30,13 @@
 #define GLM_TEXTURE  (1 << 2)       /* render with texture coords */
 #define GLM_COLOR    (1 << 3)       /* render with colors */
 #define GLM_MATERIAL (1 << 4)       /* render with materials */
+#define GLM_SHADER   (1 << 5)       /* render with shaders (per pixel lighting) */
+#define GLM_WIREFRAME (1 << 6)      /* render only the triangle edges (shaders) */
+#define GLM_OVERLAY  (1 << 7)       /* render the triangle edges over the surface */
+
+#define GLM_NOBUFFERS ((GLuint)-1)  /* buffermode of a model without buffers */
+#define GLM_MAXLODS  8              /* levels of detail, the model itself included */
+#define GLM_MAXPOINTS (1 << 24)     /* points of a point cloud kept by glmReadOBJ */
 
 
 /* GLMmaterial: Structure that defines a material in a model.
@@ -59,8 +70,41 @@ typedef struct _GLMtexture {
     GLuint id;                    /* ID-ul texturii */
     GLfloat width;        /* width and height for texture coordinates */
     GLfloat height;
+    GLenum target;                /* GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY once packed */
+    GLuint layer;                 /* layer in the texture array */
 } GLMtexture;
 
+/* GLMtexturecache: Texture objects shared by the models whose
+ * textures are loaded through it, by file, so that an image used by
+ * many models is uploaded once.
+ */
+typedef struct _GLMcachedtexture {
+    char   *filename;             /* file the texture was loaded from */
+    GLuint  id;
+    GLfloat width;
+    GLfloat height;
+    GLenum  target;               /* GL_TEXTURE_2D, or an array once packed */
+    GLuint  layer;                /* layer in the texture array */
+    GLuint  references;           /* textures of models using it */
+} GLMcachedtexture;
+
+typedef struct _GLMtexturecache {
+    GLuint            numtextures;
+    GLMcachedtexture *textures;
+} GLMtexturecache;
+
+/* GLMlod: Structure that defines a coarser level of detail of a group:
+ * its triangles that survive clustering the vertices of the model,
+ * each drawn with the vertices of its corners replaced.
+ */
+typedef struct _GLMlod {
+    GLuint   numtriangles;        /* number of triangles left */
+    GLuint  *triangles;           /* triangle each comes from (normals, texcoords) */
+    GLuint  *vindices;            /* 3 clustered vertex indices per triangle */
+    GLfloat  error;               /* bound on how far a vertex moved (model units) */
+    GLuint   first;               /* first index of the level in the index buffer */
+} GLMlod;
+
 /* GLMgroup: Structure that defines a group in a model.
  */
 typedef struct _GLMgroup {
@@ -68,9 +112,62 @@ typedef struct _GLMgroup {
     GLuint            numtriangles;   /* number of triangles in this group */
     GLuint           *triangles;      /* array of triangle indices */
     GLuint            material;       /* index to material for group */
+    GLuint            first;          /* first index of the group in the index buffer */
+    struct _GLMgroup *prototype;      /* group drawn in place of this one (instances) */
+    GLfloat           transform[16];  /* prototype to instance transform (column-major) */
+    GLuint            numlods;        /* coarser levels of detail (glmBuildLODs) */
+    GLMlod           *lods;           /* array of levels, from fine to coarse */
+    GLfloat           sphere[4];      /* bounding sphere (center, radius) of the group */
+    GLuint            lod;            /* level drawn, 0 for the group itself */
+    GLuint            index;          /* order the group was added in (visiblegroups) */
     struct _GLMgroup *next;           /* pointer to next group in model */
 } GLMgroup;
 
+/* GLMbatch: Structure that defines a run of index ranges that share the
+ * state of one group and are submitted with a single draw call.
+ */
+typedef struct _GLMbatch {
+    GLMgroup *group;              /* group the state (and transform) is taken from */
+    GLuint    first;              /* first range in batchcounts/batchoffsets */
+    GLuint    numranges;          /* number of index ranges in the batch */
+} GLMbatch;
+
+/* GLMpoint: Structure that defines a point of a point cloud, its
+ * position quantized to the cube of the octree node it is stored in.
+ */
+typedef struct _GLMpoint {
+    GLshort position[4];          /* -32767..32767 across the node, w unused */
+    GLubyte color[4];             /* rgba */
+} GLMpoint;
+
+/* GLMpointnode: Structure that defines a node of the octree of a point
+ * cloud.  A node stores an even subsample of the points in its cube
+ * that are not stored by its ancestors, so that drawing a node and all
+ * of its ancestors draws every point once at a coarser density.
+ */
+typedef struct _GLMpointnode {
+    GLfloat center[3];            /* center of the cube of the node */
+    GLfloat size;                 /* half the edge of the cube */
+    GLfloat spacing;              /* typical distance between its points */
+    GLuint  first;                /* first point of the node in points */
+    GLuint  numpoints;            /* number of points of the node */
+    GLuint  children[8];          /* child nodes by octant (x, y, z bits), 0 for none */
+} GLMpointnode;
+
+/* GLMpointcloud: Structure that defines the points of a model without
+ * faces, node after node in the order of the octree.
+ */
+typedef struct _GLMpointcloud {
+    GLuint        numpoints;      /* number of points kept */
+    GLMpoint     *points;         /* array of points */
+    GLuint        numnodes;       /* number of octree nodes */
+    GLMpointnode *nodes;          /* array of nodes, the root first */
+    GLuint        totalpoints;    /* points in the file, some dropped if more than kept */
+    GLboolean     colors;         /* the file gave the points colors */
+    GLfloat       bounds[6];      /* bounding box of the points (min xyz, max xyz) */
+    GLuint        pointbuffer;    /* points uploaded for drawing */
+} GLMpointcloud;
+
 /* GLMmodel: Structure that defines a model.
  */
 typedef struct _GLMmodel {
@@ -101,8 +198,51 @@ typedef struct _GLMmodel {
     // textures
     GLuint       numtextures;
     GLMtexture  *textures;
+    GLuint       numtexturearrays; /* texture arrays used, see glmPackTextures */
+    GLMtexturecache *texturecache; /* cache sharing the textures, NULL if owned */
 
     GLfloat position[3];          /* position of the model */
+    GLfloat rotation[3];          /* rotation of the model (degrees about x, y, z) */
+    GLfloat scale;                /* uniform scale of the model */
+
+    GLfloat   bounds[6];          /* cached bounding box (min xyz, max xyz) */
+    GLboolean boundsvalid;        /* bounds are up to date with vertices */
+
+    // buffer objects
+    GLuint   buffermode;          /* render mode the buffers were built for */
+    GLuint   vertexbuffer;        /* interleaved vertices (see glmDraw) */
+    GLuint   indexbuffer;         /* triangle indices, group after group */
+
+    // draw batches over the buffer objects
+    GLuint     numbatches;        /* number of batches */
+    GLMbatch  *batches;           /* array of batches, NULL when out of date */
+    GLsizei   *batchcounts;       /* index count of each range */
+    GLvoid   **batchoffsets;      /* byte offset of each range in indexbuffer */
+    GLuint     batchserial;       /* visibleserial the batches were built for */
+    GLuint     numdrawgroups;     /* groups drawn by the last glmDraw */
+    GLuint     numdrawcalls;      /* draw calls issued by the last glmDraw */
+
+    // copies of the whole model
+    GLuint     numinstances;      /* number of instances, 0 draws the model once */
+    GLfloat   *instances;         /* 16 floats per instance (column-major) */
+    GLuint     instancebuffer;    /* instances uploaded for instanced draws */
+    GLboolean  instancesvalid;    /* instancebuffer is up to date */
+
+    GLuint     materialbuffer;    /* materials as a uniform buffer (GLM_SHADER) */
+
+    // levels of detail
+    GLuint     numlods;           /* levels built by glmBuildLODs, beyond the model */
+    GLfloat    lodtolerance;      /* screen space error allowed in pixels, 0 for none */
+    GLuint     lodtriangles[GLM_MAXLODS]; /* triangles drawn at each level */
+
+    // group visibility
+    GLuint    *visiblegroups;     /* one bit per group index, set for the groups drawn */
+    GLuint     visibleserial;     /* bumped whenever visiblegroups changes */
+
+    // points of a model without faces
+    GLMpointcloud *pointcloud;    /* octree of the points, NULL for other models */
+    GLuint     pointbudget;       /* points drawn per frame at most */
+    GLuint     numdrawpoints;     /* points drawn by the last glmDraw */
 
 } GLMmodel;
 
@@ -113,8 +253,6 @@ struct mycallback {
     char *text;
 };
 
-GLvoid glmDraw(GLMmodel *model, GLuint mode,char *drawonly);
-
 GLfloat glmDot(GLfloat *u, GLfloat *v);
 
 /* glmUnitize: "unitize" a model by translating it to the origin and
@@ -126,6 +264,35 @@ GLfloat glmDot(GLfloat *u, GLfloat *v);
 GLfloat
 glmUnitize(GLMmodel *model);
 
+/* glmUnitizeTransform: "unitize" a model like glmUnitize, but without
+ * touching the vertices.  The translation and scale are stored in the
+ * model transform (position, scale) and applied at draw time by
+ * glmApplyTransform.  Returns the scalefactor used.
+ *
+ * model - properly initialized GLMmodel structure
+ */
+GLfloat
+glmUnitizeTransform(GLMmodel *model);
+
+/* glmApplyTransform: Multiplies the current OpenGL matrix by the model
+ * transform (rotation, scale and position, in that order).
+ *
+ * model - properly initialized GLMmodel structure
+ */
+GLvoid
+glmApplyTransform(GLMmodel *model);
+
+/* glmBounds: Returns the bounding box of a model in model units,
+ * including the instanced groups placed by their transform.  The
+ * box is computed on the first call and cached until the vertices are
+ * changed by one of the glm functions.
+ *
+ * model  - initialized GLMmodel structure
+ * bounds - array of 6 GLfloats (min x, y, z followed by max x, y, z)
+ */
+GLvoid
+glmBounds(GLMmodel *model, GLfloat *bounds);
+
 /* glmDimensions: Calculates the dimensions (width, height, depth) of
  * a model.
  *
@@ -212,13 +379,61 @@ glmDelete(GLMmodel *model);
 
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
- * glmDelete().
+ * glmDelete(), or NULL (the reason on stderr) if the file, or the
+ * material library it names, can't be read or has an unknown token.
+ *
+ * A file with vertices but no faces (a scan) is read as a point cloud
+ * instead: model->pointcloud holds the points in an octree, with the
+ * colors given after the position of each vertex (0..1 or 0..255), and
+ * model->numvertices is left 0.  Beyond maxpoints points an even
+ * subsample of the file is kept, so that the memory used stays at 12
+ * bytes a point however large the file; reading it takes about four
+ * times that for a while.  glmDraw then draws at most
+ * model->pointbudget points, from the nodes whose points are furthest
+ * apart on screen with the current matrices and viewport.
  *
- * filename - name of the file containing the Wavefront .OBJ format data.
+ * filename  - name of the file containing the Wavefront .OBJ format data.
+ * textures  - GL_FALSE to leave the textures for glmLoadTextures, so that
+ *             the model can be read without a current context (on a
+ *             worker thread).
+ * maxpoints - points of a point cloud to keep, GLM_MAXPOINTS by default
  */
 //GLMmodel * glmReadOBJ(char* filename);
 GLMmodel *glmReadOBJ(char *filename);
 GLMmodel *glmReadOBJ(char *filename,mycallback *call);
+GLMmodel *glmReadOBJ(char *filename,mycallback *call,GLboolean textures);
+GLMmodel *glmReadOBJ(char *filename,mycallback *call,GLboolean textures,GLuint maxpoints);
+
+/* glmLoadTextures: Loads the textures of a model read with textures
+ * GL_FALSE.  Returns the number of textures loaded.
+ *
+ * model - initialized GLMmodel structure, its context current
+ */
+GLuint
+glmLoadTextures(GLMmodel *model);
+
+/* glmLoadTextures: Loads the textures of a model read with textures
+ * GL_FALSE through a cache, sharing the ones already loaded for other
+ * models.  glmDelete releases them; the cache must outlive the model.
+ * Returns the number of textures uploaded, not found in the cache.
+ *
+ * model - initialized GLMmodel structure, its context current
+ * cache - cache made by glmNewTextureCache
+ */
+GLuint
+glmLoadTextures(GLMmodel *model, GLMtexturecache *cache);
+
+/* glmNewTextureCache: Creates an empty texture cache. */
+GLMtexturecache *
+glmNewTextureCache(GLvoid);
+
+/* glmDeleteTextureCache: Deletes a texture cache and the textures
+ * still in it.  The models using them should be deleted first.
+ *
+ * cache - cache made by glmNewTextureCache, its context current
+ */
+GLvoid
+glmDeleteTextureCache(GLMtexturecache *cache);
 
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
@@ -236,7 +451,34 @@ GLvoid
 glmWriteOBJ(GLMmodel *model, char *filename, GLuint mode);
 
 /* glmDraw: Renders the model to the current OpenGL context using the
- * mode specified.
+ * mode specified.  If the context supports buffer objects the model is
+ * uploaded into a vertex and an index buffer on the first call (and
+ * again whenever the mode or the model changes).  Consecutive groups
+ * sharing their material and texture are then drawn together with one
+ * glMultiDrawElements, adjacent index ranges merged.  Without buffer
+ * objects the model is sent in immediate mode.
+ *
+ * If the context also has GLM_EXT_SHADERS, GLM_FLAT is done by a
+ * program that takes the normal of each triangle from the derivatives
+ * of its position: facetnorms are not needed then (glmFacetNormals can
+ * be skipped) and the vertices are shared as in GLM_NONE mode.  Should
+ * that program fail to build, glmDraw computes the facetnorms itself.
+ *
+ * With GLM_SHADER the model is drawn by glmRenderProgram instead of
+ * the fixed function pipeline: materials are uploaded once into a
+ * uniform buffer and lighting is done per pixel from the state of
+ * GL_LIGHT0.  Each batch then only sets the index of its material.
+ * This needs GLM_EXT_UNIFORMBUFFERS.
+ *
+ * GLM_WIREFRAME and GLM_OVERLAY imply GLM_SHADER and draw the edges of
+ * the triangles in the current color and line width, found per pixel
+ * in the same pass as the triangles: alone, in place of
+ * glPolygonMode(GL_LINE), or over the shaded surface.  They need
+ * GLM_EXT_GEOMETRY; a GLM_WIREFRAME the program can't draw (no support,
+ * a failed link, too many materials) falls back to glPolygonMode(GL_LINE).
+ *
+ * Point clouds (see glmReadOBJ) are drawn as unlit points whatever the
+ * mode, in their colors or else the current color.
  *
  * model    - initialized GLMmodel structure
  * mode     - a bitwise OR of values describing what is to be rendered.
@@ -244,6 +486,9 @@ glmWriteOBJ(GLMmodel *model, char *filename, GLuint mode);
  *            GLM_FLAT    -  render with facet normals
  *            GLM_SMOOTH  -  render with vertex normals
  *            GLM_TEXTURE -  render with texture coords
+ *            GLM_SHADER  -  render with shaders
+ *            GLM_WIREFRAME - render the edges only
+ *            GLM_OVERLAY -  render the edges over the surface
  *            GLM_FLAT and GLM_SMOOTH should not both be specified.
  */
 GLvoid
@@ -274,6 +519,66 @@ glmList(GLMmodel *model, GLuint mode);
 GLvoid
 glmWeld(GLMmodel *model, GLfloat epsilon);
 
+/* glmCompact: removes degenerate (zero area) and duplicate triangles,
+ * triangles that are not in any group, and vertices, normals and
+ * texcoords that are no longer referenced by a triangle.  All indices
+ * are remapped in place.  Returns the number of bytes reclaimed.
+ *
+ * model - initialized GLMmodel structure
+ */
+size_t
+glmCompact(GLMmodel *model);
+
+/* glmPackTextures: Packs the textures of a model that have the same
+ * size into 2D texture arrays, so that groups using different textures
+ * can still be drawn in one batch.  Needs GLM_EXT_TEXARRAYS and
+ * GLM_EXT_BUFFERS, and packs nothing unless the layered glmFixedProgram
+ * that glmDraw samples the arrays with builds.  Textures of a size
+ * used only once are left alone.  Of the textures from a texture cache
+ * only those no other model uses yet are packed; models loading them
+ * later share the layers.  Returns the number of textures packed.
+ *
+ * model - initialized GLMmodel structure, its context current
+ */
+GLuint
+glmPackTextures(GLMmodel *model);
+
+/* glmSortGroups: Sorts the groups of a model by texture and then by
+ * material, so that glmDraw changes state as rarely as possible.  The
+ * sort is stable; groups sharing both keep their relative order.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmSortGroups(GLMmodel *model);
+
+/* glmReorder: Reorders the vertices and triangles of a model for
+ * memory locality.  Vertices are first sorted along a 3D Morton (Z
+ * order) curve, the triangles of each group are sorted by their
+ * vertices and packed group by group, and finally the vertices are
+ * renumbered in the order the triangle list first uses them.  All
+ * indices are remapped in place.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmReorder(GLMmodel *model);
+
+/* glmDetectInstances: Finds groups that are rigidly moved (translated
+ * and rotated) copies of another group, with the same triangle layout.
+ * Each such group keeps its name and material but drops its triangles
+ * and instead draws the triangles of its prototype group through a
+ * transform.  Returns the number of groups turned into instances; run
+ * glmCompact afterwards to release the geometry they no longer use.
+ * glmWriteOBJ writes instanced groups out as placed copies again.
+ *
+ * model   - initialized GLMmodel structure
+ * epsilon - maximum distance between a vertex and its transformed
+ *           prototype vertex
+ */
+GLuint
+glmDetectInstances(GLMmodel *model, GLfloat epsilon);
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
@@ -307,3 +612,85 @@ glmReadPPM(char *filename, int *width, int *height);
 
 GLMgroup *
 glmFindGroup(GLMmodel *model, char *name);
+
+/* glmDeleteBuffers: Releases the buffer objects of a model; they are
+ * built again by the next glmDraw.  Requires the context the buffers
+ * were created in to be current.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmDeleteBuffers(GLMmodel *model);
+
+/* glmAddInstance: Adds a copy of the model placed by the given
+ * transform.  Once a model has instances glmDraw draws one copy per
+ * instance instead of the model itself; with GLM_EXT_INSTANCING the
+ * copies come from a single instanced draw per batch.  Returns the
+ * index of the new instance.
+ *
+ * model     - initialized GLMmodel structure
+ * transform - 4x4 column-major matrix applied before the model's own
+ *             position/rotation/scale (rigid or uniformly scaled)
+ */
+GLuint
+glmAddInstance(GLMmodel *model, GLfloat *transform);
+
+/* glmClearInstances: Removes all instances, the model is drawn once
+ * again.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmClearInstances(GLMmodel *model);
+
+/* glmBuildLODs: Builds coarser levels of detail of every group by
+ * clustering the vertices of the model on grids of 256, 128, 64...
+ * cells across; triangles whose corners fall into fewer than three
+ * cells are dropped.  Once built, glmDraw picks the coarsest level of
+ * each group whose error, projected with the current matrices and
+ * viewport, is within model->lodtolerance pixels.  Levels are only
+ * drawn from buffer objects.  Operations that move vertices or
+ * triangles around (glmCompact, glmReorder, ...) delete the levels.
+ *
+ * model     - initialized GLMmodel structure
+ * numlevels - levels to build, up to GLM_MAXLODS - 1
+ */
+GLvoid
+glmBuildLODs(GLMmodel *model, GLuint numlevels);
+
+/* glmDeleteLODs: Deletes the levels of detail of a model.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmDeleteLODs(GLMmodel *model);
+
+/* glmShowGroup: Shows or hides a group.  Hidden groups are left out
+ * when the draw batches are built, so changing any number of groups
+ * costs a single rebuild at the next glmDraw.  Display lists of the
+ * model must be compiled again once model->visibleserial changes.
+ *
+ * model   - initialized GLMmodel structure
+ * group   - group of the model
+ * visible - GL_TRUE to draw the group
+ */
+GLvoid
+glmShowGroup(GLMmodel *model, GLMgroup *group, GLboolean visible);
+
+/* glmShowAllGroups: Shows or hides every group of a model.
+ *
+ * model   - initialized GLMmodel structure
+ * visible - GL_TRUE to draw the groups
+ */
+GLvoid
+glmShowAllGroups(GLMmodel *model, GLboolean visible);
+
+/* glmGroupVisible: Returns GL_TRUE if a group is drawn.
+ *
+ * model - initialized GLMmodel structure
+ * group - group of the model
+ */
+GLboolean
+glmGroupVisible(GLMmodel *model, GLMgroup *group);
+
+#endif /* GLM_H */
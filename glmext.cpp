@@ -0,0 +1,286 @@
+/*
+      glmext.cpp
+
+      OpenGL entry points above version 1.1 used by the GLM renderer.
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <GL/glx.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glmext.h"
+
+PFNGLGENBUFFERSPROC      pglGenBuffers    = NULL;
+PFNGLDELETEBUFFERSPROC   pglDeleteBuffers = NULL;
+PFNGLBINDBUFFERPROC      pglBindBuffer    = NULL;
+PFNGLBUFFERDATAPROC      pglBufferData    = NULL;
+
+PFNGLMULTIDRAWELEMENTSPROC pglMultiDrawElements = NULL;
+
+PFNGLCREATESHADERPROC             pglCreateShader             = NULL;
+PFNGLDELETESHADERPROC             pglDeleteShader             = NULL;
+PFNGLSHADERSOURCEPROC             pglShaderSource             = NULL;
+PFNGLCOMPILESHADERPROC            pglCompileShader            = NULL;
+PFNGLGETSHADERIVPROC              pglGetShaderiv              = NULL;
+PFNGLGETSHADERINFOLOGPROC         pglGetShaderInfoLog         = NULL;
+PFNGLCREATEPROGRAMPROC            pglCreateProgram            = NULL;
+PFNGLDELETEPROGRAMPROC            pglDeleteProgram            = NULL;
+PFNGLATTACHSHADERPROC             pglAttachShader             = NULL;
+PFNGLBINDATTRIBLOCATIONPROC       pglBindAttribLocation       = NULL;
+PFNGLLINKPROGRAMPROC              pglLinkProgram              = NULL;
+PFNGLGETPROGRAMIVPROC             pglGetProgramiv             = NULL;
+PFNGLGETPROGRAMINFOLOGPROC        pglGetProgramInfoLog        = NULL;
+PFNGLUSEPROGRAMPROC               pglUseProgram               = NULL;
+PFNGLGETUNIFORMLOCATIONPROC       pglGetUniformLocation       = NULL;
+PFNGLUNIFORM1IPROC                pglUniform1i                = NULL;
+PFNGLUNIFORM1FPROC                pglUniform1f                = NULL;
+PFNGLUNIFORM2FPROC                pglUniform2f                = NULL;
+PFNGLUNIFORM4FVPROC               pglUniform4fv               = NULL;
+PFNGLUNIFORMMATRIX4FVPROC         pglUniformMatrix4fv         = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC  pglEnableVertexAttribArray  = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC      pglVertexAttribPointer      = NULL;
+PFNGLVERTEXATTRIB4FVPROC          pglVertexAttrib4fv          = NULL;
+
+PFNGLDRAWELEMENTSINSTANCEDPROC    pglDrawElementsInstanced    = NULL;
+PFNGLVERTEXATTRIBDIVISORPROC      pglVertexAttribDivisor      = NULL;
+
+PFNGLACTIVETEXTUREPROC            pglActiveTexture            = NULL;
+PFNGLTEXIMAGE3DPROC               pglTexImage3D               = NULL;
+PFNGLTEXSUBIMAGE3DPROC            pglTexSubImage3D            = NULL;
+PFNGLGENERATEMIPMAPPROC           pglGenerateMipmap           = NULL;
+
+PFNGLGETUNIFORMBLOCKINDEXPROC     pglGetUniformBlockIndex     = NULL;
+PFNGLUNIFORMBLOCKBINDINGPROC      pglUniformBlockBinding      = NULL;
+PFNGLBINDBUFFERBASEPROC           pglBindBufferBase           = NULL;
+
+PFNGLGENQUERIESPROC               pglGenQueries               = NULL;
+PFNGLDELETEQUERIESPROC            pglDeleteQueries            = NULL;
+PFNGLBEGINQUERYPROC               pglBeginQuery               = NULL;
+PFNGLENDQUERYPROC                 pglEndQuery                 = NULL;
+PFNGLGETQUERYOBJECTIVPROC         pglGetQueryObjectiv         = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC      pglGetQueryObjectui64v      = NULL;
+
+PFNGLMAPBUFFERPROC                pglMapBuffer                = NULL;
+PFNGLUNMAPBUFFERPROC              pglUnmapBuffer              = NULL;
+PFNGLFENCESYNCPROC                pglFenceSync                = NULL;
+PFNGLCLIENTWAITSYNCPROC           pglClientWaitSync           = NULL;
+PFNGLDELETESYNCPROC               pglDeleteSync               = NULL;
+
+static GLMprocaddress glmProcAddress = NULL;
+
+/* glmSetProcAddress: Sets the function used to look up entry points
+ * instead of wglGetProcAddress/glXGetProcAddressARB, for contexts the
+ * window system did not create (such as EGL ones).  Must be called
+ * before the first glmExtensions.
+ *
+ * proc - returns the entry point of the given name, or NULL
+ */
+GLvoid
+glmSetProcAddress(GLMprocaddress proc)
+{
+    glmProcAddress = proc;
+}
+
+/* glmGetProc: look up an entry point in the current context */
+static void *
+glmGetProc(const char *name)
+{
+    if (glmProcAddress)
+        return glmProcAddress(name);
+#ifdef _WIN32
+    return (void *)wglGetProcAddress(name);
+#else
+    return (void *)glXGetProcAddressARB((const GLubyte *)name);
+#endif
+}
+
+/* glmGetProcARB: look up a core entry point, falling back to the name
+ * with the given extension suffix */
+static void *
+glmGetProcARB(const char *name, const char *suffix)
+{
+    char  buf[128];
+    void *proc;
+
+    proc = glmGetProc(name);
+    if (!proc) {
+        sprintf(buf, "%s%s", name, suffix);
+        proc = glmGetProc(buf);
+    }
+    return proc;
+}
+
+/* glmHasExtension: returns GL_TRUE if the current context advertises
+ * the extension */
+static GLboolean
+glmHasExtension(const char *name)
+{
+    const char *extensions, *s;
+    size_t      length;
+
+    extensions = (const char *)glGetString(GL_EXTENSIONS);
+    if (!extensions)
+        return GL_FALSE;
+
+    length = strlen(name);
+    for (s = strstr(extensions, name); s; s = strstr(s + length, name)) {
+        if ((s == extensions || s[-1] == ' ') && (s[length] == ' ' || s[length] == '\0'))
+            return GL_TRUE;
+    }
+    return GL_FALSE;
+}
+
+/* glmVersion: returns the context version as major * 10 + minor */
+static GLuint
+glmVersion(GLvoid)
+{
+    const char *version;
+    int major, minor;
+
+    version = (const char *)glGetString(GL_VERSION);
+    if (!version || sscanf(version, "%d.%d", &major, &minor) != 2)
+        return 11;
+    return major * 10 + minor;
+}
+
+/* glmExtensions: Returns a bitwise OR of the GLM_EXT_* features the
+ * current context supports.  The entry points are resolved on the
+ * first call, so a context must be current by then.
+ */
+GLuint
+glmExtensions(GLvoid)
+{
+    static GLboolean resolved = GL_FALSE;
+    static GLuint    extensions = 0;
+    GLuint           version;
+
+    if (resolved)
+        return extensions;
+    resolved = GL_TRUE;
+
+    version = glmVersion();
+
+    if (version >= 15 || glmHasExtension("GL_ARB_vertex_buffer_object")) {
+        pglGenBuffers    = (PFNGLGENBUFFERSPROC)glmGetProcARB("glGenBuffers", "ARB");
+        pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)glmGetProcARB("glDeleteBuffers", "ARB");
+        pglBindBuffer    = (PFNGLBINDBUFFERPROC)glmGetProcARB("glBindBuffer", "ARB");
+        pglBufferData    = (PFNGLBUFFERDATAPROC)glmGetProcARB("glBufferData", "ARB");
+        if (pglGenBuffers && pglDeleteBuffers && pglBindBuffer && pglBufferData)
+            extensions |= GLM_EXT_BUFFERS;
+    }
+
+    if (version >= 14 || glmHasExtension("GL_EXT_multi_draw_arrays")) {
+        pglMultiDrawElements = (PFNGLMULTIDRAWELEMENTSPROC)glmGetProcARB("glMultiDrawElements", "EXT");
+        if (pglMultiDrawElements)
+            extensions |= GLM_EXT_MULTIDRAW;
+    }
+
+    /* only the 2.0 entry points, the ARB_shader_objects ones differ */
+    if (version >= 20) {
+        pglCreateShader             = (PFNGLCREATESHADERPROC)glmGetProc("glCreateShader");
+        pglDeleteShader             = (PFNGLDELETESHADERPROC)glmGetProc("glDeleteShader");
+        pglShaderSource             = (PFNGLSHADERSOURCEPROC)glmGetProc("glShaderSource");
+        pglCompileShader            = (PFNGLCOMPILESHADERPROC)glmGetProc("glCompileShader");
+        pglGetShaderiv              = (PFNGLGETSHADERIVPROC)glmGetProc("glGetShaderiv");
+        pglGetShaderInfoLog         = (PFNGLGETSHADERINFOLOGPROC)glmGetProc("glGetShaderInfoLog");
+        pglCreateProgram            = (PFNGLCREATEPROGRAMPROC)glmGetProc("glCreateProgram");
+        pglDeleteProgram            = (PFNGLDELETEPROGRAMPROC)glmGetProc("glDeleteProgram");
+        pglAttachShader             = (PFNGLATTACHSHADERPROC)glmGetProc("glAttachShader");
+        pglBindAttribLocation       = (PFNGLBINDATTRIBLOCATIONPROC)glmGetProc("glBindAttribLocation");
+        pglLinkProgram              = (PFNGLLINKPROGRAMPROC)glmGetProc("glLinkProgram");
+        pglGetProgramiv             = (PFNGLGETPROGRAMIVPROC)glmGetProc("glGetProgramiv");
+        pglGetProgramInfoLog        = (PFNGLGETPROGRAMINFOLOGPROC)glmGetProc("glGetProgramInfoLog");
+        pglUseProgram               = (PFNGLUSEPROGRAMPROC)glmGetProc("glUseProgram");
+        pglGetUniformLocation       = (PFNGLGETUNIFORMLOCATIONPROC)glmGetProc("glGetUniformLocation");
+        pglUniform1i                = (PFNGLUNIFORM1IPROC)glmGetProc("glUniform1i");
+        pglUniform1f                = (PFNGLUNIFORM1FPROC)glmGetProc("glUniform1f");
+        pglUniform2f                = (PFNGLUNIFORM2FPROC)glmGetProc("glUniform2f");
+        pglUniform4fv               = (PFNGLUNIFORM4FVPROC)glmGetProc("glUniform4fv");
+        pglUniformMatrix4fv         = (PFNGLUNIFORMMATRIX4FVPROC)glmGetProc("glUniformMatrix4fv");
+        pglEnableVertexAttribArray  = (PFNGLENABLEVERTEXATTRIBARRAYPROC)glmGetProc("glEnableVertexAttribArray");
+        pglDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)glmGetProc("glDisableVertexAttribArray");
+        pglVertexAttribPointer      = (PFNGLVERTEXATTRIBPOINTERPROC)glmGetProc("glVertexAttribPointer");
+        pglVertexAttrib4fv          = (PFNGLVERTEXATTRIB4FVPROC)glmGetProc("glVertexAttrib4fv");
+        if (pglCreateShader && pglDeleteShader && pglShaderSource && pglCompileShader &&
+                pglGetShaderiv && pglGetShaderInfoLog && pglCreateProgram && pglDeleteProgram &&
+                pglAttachShader && pglBindAttribLocation && pglLinkProgram && pglGetProgramiv &&
+                pglGetProgramInfoLog && pglUseProgram && pglGetUniformLocation && pglUniform1i &&
+                pglUniform1f && pglUniform2f && pglUniform4fv && pglUniformMatrix4fv && pglEnableVertexAttribArray &&
+                pglDisableVertexAttribArray && pglVertexAttribPointer && pglVertexAttrib4fv)
+            extensions |= GLM_EXT_SHADERS;
+    }
+
+    if ((extensions & GLM_EXT_SHADERS) &&
+            (version >= 33 || (glmHasExtension("GL_ARB_draw_instanced") &&
+                               glmHasExtension("GL_ARB_instanced_arrays")))) {
+        pglDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)glmGetProcARB("glDrawElementsInstanced", "ARB");
+        pglVertexAttribDivisor   = (PFNGLVERTEXATTRIBDIVISORPROC)glmGetProcARB("glVertexAttribDivisor", "ARB");
+        if (pglDrawElementsInstanced && pglVertexAttribDivisor)
+            extensions |= GLM_EXT_INSTANCING;
+    }
+
+    /* arrays are only sampled from shaders */
+    if ((extensions & GLM_EXT_SHADERS) &&
+            (version >= 30 || (glmHasExtension("GL_EXT_texture_array") &&
+                               glmHasExtension("GL_ARB_framebuffer_object")))) {
+        pglActiveTexture  = (PFNGLACTIVETEXTUREPROC)glmGetProc("glActiveTexture");
+        pglTexImage3D     = (PFNGLTEXIMAGE3DPROC)glmGetProcARB("glTexImage3D", "EXT");
+        pglTexSubImage3D  = (PFNGLTEXSUBIMAGE3DPROC)glmGetProcARB("glTexSubImage3D", "EXT");
+        pglGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)glmGetProc("glGenerateMipmap");
+        if (pglActiveTexture && pglTexImage3D && pglTexSubImage3D && pglGenerateMipmap)
+            extensions |= GLM_EXT_TEXARRAYS;
+    }
+
+    /* GLSL 1.40 comes with 3.1, the extension alone is not enough */
+    if ((extensions & GLM_EXT_SHADERS) && version >= 31) {
+        pglGetUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)glmGetProc("glGetUniformBlockIndex");
+        pglUniformBlockBinding  = (PFNGLUNIFORMBLOCKBINDINGPROC)glmGetProc("glUniformBlockBinding");
+        pglBindBufferBase       = (PFNGLBINDBUFFERBASEPROC)glmGetProc("glBindBufferBase");
+        if (pglGetUniformBlockIndex && pglUniformBlockBinding && pglBindBufferBase)
+            extensions |= GLM_EXT_UNIFORMBUFFERS;
+    }
+
+    /* no new entry points, glCreateShader takes GL_GEOMETRY_SHADER */
+    if ((extensions & GLM_EXT_UNIFORMBUFFERS) && version >= 32)
+        extensions |= GLM_EXT_GEOMETRY;
+
+    /* the query objects themselves are 1.5 (or ARB_occlusion_query) */
+    if (version >= 33 || glmHasExtension("GL_ARB_timer_query") ||
+            glmHasExtension("GL_EXT_timer_query")) {
+        pglGenQueries          = (PFNGLGENQUERIESPROC)glmGetProcARB("glGenQueries", "ARB");
+        pglDeleteQueries       = (PFNGLDELETEQUERIESPROC)glmGetProcARB("glDeleteQueries", "ARB");
+        pglBeginQuery          = (PFNGLBEGINQUERYPROC)glmGetProcARB("glBeginQuery", "ARB");
+        pglEndQuery            = (PFNGLENDQUERYPROC)glmGetProcARB("glEndQuery", "ARB");
+        pglGetQueryObjectiv    = (PFNGLGETQUERYOBJECTIVPROC)glmGetProcARB("glGetQueryObjectiv", "ARB");
+        pglGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)glmGetProcARB("glGetQueryObjectui64v", "EXT");
+        if (pglGenQueries && pglDeleteQueries && pglBeginQuery && pglEndQuery &&
+                pglGetQueryObjectiv && pglGetQueryObjectui64v)
+            extensions |= GLM_EXT_TIMERS;
+    }
+
+    /* pixel pack buffers are the buffer objects bound elsewhere */
+    if ((extensions & GLM_EXT_BUFFERS) &&
+            (version >= 32 || (glmHasExtension("GL_ARB_pixel_buffer_object") &&
+                               glmHasExtension("GL_ARB_sync")))) {
+        pglMapBuffer      = (PFNGLMAPBUFFERPROC)glmGetProcARB("glMapBuffer", "ARB");
+        pglUnmapBuffer    = (PFNGLUNMAPBUFFERPROC)glmGetProcARB("glUnmapBuffer", "ARB");
+        pglFenceSync      = (PFNGLFENCESYNCPROC)glmGetProc("glFenceSync");
+        pglClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)glmGetProc("glClientWaitSync");
+        pglDeleteSync     = (PFNGLDELETESYNCPROC)glmGetProc("glDeleteSync");
+        if (pglMapBuffer && pglUnmapBuffer && pglFenceSync && pglClientWaitSync && pglDeleteSync)
+            extensions |= GLM_EXT_PIXELBUFFERS;
+    }
+
+#if 0
+    printf("glmExtensions(): GL %d.%d, features 0x%x\n",
+           version / 10, version % 10, extensions);
+#endif
+
+    return extensions;
+}
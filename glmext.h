@@ -0,0 +1,110 @@
+/*
+      glmext.h
+
+      OpenGL entry points above version 1.1 used by the GLM renderer.
+      They are resolved at run time from the current context, since
+      the system OpenGL libraries (opengl32 on Windows in particular)
+      only export 1.1.
+*/
+
+#ifndef GLMEXT_H
+#define GLMEXT_H
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#define GLM_EXT_BUFFERS      (1 << 0)   /* vertex and index buffer objects (1.5) */
+#define GLM_EXT_MULTIDRAW    (1 << 1)   /* glMultiDrawElements (1.4) */
+#define GLM_EXT_SHADERS      (1 << 2)   /* GLSL program objects (2.0) */
+#define GLM_EXT_INSTANCING   (1 << 3)   /* instanced draws and attributes (3.3) */
+#define GLM_EXT_TEXARRAYS    (1 << 4)   /* 2D texture arrays and glGenerateMipmap (3.0) */
+#define GLM_EXT_UNIFORMBUFFERS (1 << 5) /* uniform buffer objects and GLSL 1.40 (3.1) */
+#define GLM_EXT_GEOMETRY     (1 << 6)   /* geometry shaders and GLSL 1.50 (3.2) */
+#define GLM_EXT_TIMERS       (1 << 7)   /* GL_TIME_ELAPSED timer queries (3.3) */
+#define GLM_EXT_PIXELBUFFERS (1 << 8)   /* pixel pack buffers and fence syncs (3.2) */
+
+/* glmSetProcAddress: Sets the function used to look up entry points
+ * instead of wglGetProcAddress/glXGetProcAddressARB, for contexts the
+ * window system did not create (such as EGL ones).  Must be called
+ * before the first glmExtensions.
+ *
+ * proc - returns the entry point of the given name, or NULL
+ */
+typedef void *(*GLMprocaddress)(const char *name);
+
+GLvoid
+glmSetProcAddress(GLMprocaddress proc);
+
+/* glmExtensions: Returns a bitwise OR of the GLM_EXT_* features the
+ * current context supports.  The entry points are resolved on the
+ * first call, so a context must be current by then.
+ */
+GLuint
+glmExtensions(GLvoid);
+
+/* GL_ARB_vertex_buffer_object / OpenGL 1.5 */
+extern PFNGLGENBUFFERSPROC      pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC   pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC      pglBindBuffer;
+extern PFNGLBUFFERDATAPROC      pglBufferData;
+
+/* GL_EXT_multi_draw_arrays / OpenGL 1.4 */
+extern PFNGLMULTIDRAWELEMENTSPROC pglMultiDrawElements;
+
+/* OpenGL 2.0 */
+extern PFNGLCREATESHADERPROC             pglCreateShader;
+extern PFNGLDELETESHADERPROC             pglDeleteShader;
+extern PFNGLSHADERSOURCEPROC             pglShaderSource;
+extern PFNGLCOMPILESHADERPROC            pglCompileShader;
+extern PFNGLGETSHADERIVPROC              pglGetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC         pglGetShaderInfoLog;
+extern PFNGLCREATEPROGRAMPROC            pglCreateProgram;
+extern PFNGLDELETEPROGRAMPROC            pglDeleteProgram;
+extern PFNGLATTACHSHADERPROC             pglAttachShader;
+extern PFNGLBINDATTRIBLOCATIONPROC       pglBindAttribLocation;
+extern PFNGLLINKPROGRAMPROC              pglLinkProgram;
+extern PFNGLGETPROGRAMIVPROC             pglGetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC        pglGetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC               pglUseProgram;
+extern PFNGLGETUNIFORMLOCATIONPROC       pglGetUniformLocation;
+extern PFNGLUNIFORM1IPROC                pglUniform1i;
+extern PFNGLUNIFORM1FPROC                pglUniform1f;
+extern PFNGLUNIFORM2FPROC                pglUniform2f;
+extern PFNGLUNIFORM4FVPROC               pglUniform4fv;
+extern PFNGLUNIFORMMATRIX4FVPROC         pglUniformMatrix4fv;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC  pglEnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC pglDisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBPOINTERPROC      pglVertexAttribPointer;
+extern PFNGLVERTEXATTRIB4FVPROC          pglVertexAttrib4fv;
+
+/* GL_ARB_draw_instanced + GL_ARB_instanced_arrays / OpenGL 3.3 */
+extern PFNGLDRAWELEMENTSINSTANCEDPROC    pglDrawElementsInstanced;
+extern PFNGLVERTEXATTRIBDIVISORPROC      pglVertexAttribDivisor;
+
+/* GL_EXT_texture_array + GL_ARB_framebuffer_object / OpenGL 3.0 */
+extern PFNGLACTIVETEXTUREPROC            pglActiveTexture;
+extern PFNGLTEXIMAGE3DPROC               pglTexImage3D;
+extern PFNGLTEXSUBIMAGE3DPROC            pglTexSubImage3D;
+extern PFNGLGENERATEMIPMAPPROC           pglGenerateMipmap;
+
+/* GL_ARB_uniform_buffer_object / OpenGL 3.1 */
+extern PFNGLGETUNIFORMBLOCKINDEXPROC     pglGetUniformBlockIndex;
+extern PFNGLUNIFORMBLOCKBINDINGPROC      pglUniformBlockBinding;
+extern PFNGLBINDBUFFERBASEPROC           pglBindBufferBase;
+
+/* GL_ARB_timer_query or GL_EXT_timer_query / OpenGL 3.3 */
+extern PFNGLGENQUERIESPROC               pglGenQueries;
+extern PFNGLDELETEQUERIESPROC            pglDeleteQueries;
+extern PFNGLBEGINQUERYPROC               pglBeginQuery;
+extern PFNGLENDQUERYPROC                 pglEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC         pglGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC      pglGetQueryObjectui64v;
+
+/* GL_ARB_pixel_buffer_object + GL_ARB_sync / OpenGL 3.2 */
+extern PFNGLMAPBUFFERPROC                pglMapBuffer;
+extern PFNGLUNMAPBUFFERPROC              pglUnmapBuffer;
+extern PFNGLFENCESYNCPROC                pglFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC           pglClientWaitSync;
+extern PFNGLDELETESYNCPROC               pglDeleteSync;
+
+#endif // GLMEXT_H
@@ -0,0 +1,411 @@
+/*
+      glmshader.cpp
+
+      GLSL programs used by the GLM renderer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glmext.h"
+#include "glmshader.h"
+
+/* GL_LIGHT0 lighting of an eye space position and normal, shared by
+   the vertex (smooth) and the fragment (flat) shader */
+static const char *glmFixedLighting =
+    "uniform bool glm_lighting;\n"
+    "uniform bool glm_flat;\n"
+    "varying vec3 glm_eye;\n"
+    "vec4 glmLighting(vec3 eye, vec3 n)\n"
+    "{\n"
+    "    vec4 p = gl_LightSource[0].position;\n"
+    "    vec3 l = normalize(p.w == 0.0 ? p.xyz : p.xyz - eye);\n"
+    "    vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n"
+    "    float d = max(dot(n, l), 0.0);\n"
+    "    vec4 color = gl_FrontLightModelProduct.sceneColor +\n"
+    "                 gl_FrontLightProduct[0].ambient + d * gl_FrontLightProduct[0].diffuse;\n"
+    "    if (d > 0.0)\n"
+    "        color += pow(max(dot(n, h), 0.0), gl_FrontMaterial.shininess) *\n"
+    "                 gl_FrontLightProduct[0].specular;\n"
+    "    color.a = gl_FrontMaterial.diffuse.a;\n"
+    "    return clamp(color, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *glmFixedVertex =
+    "#ifdef GLM_INSTANCED\n"
+    "attribute mat4 glm_instance;\n"
+    "#else\n"
+    "const mat4 glm_instance = mat4(1.0);\n"
+    "#endif\n"
+    "uniform mat4 glm_group;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = gl_ModelViewMatrix * (glm_instance * (glm_group * gl_Vertex));\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    glm_eye = eye.xyz;\n"
+    "    if (!glm_lighting || glm_flat) {\n"
+    "        gl_FrontColor = gl_BackColor = gl_Color;\n"
+    "        return;\n"
+    "    }\n"
+    "    vec3 n = normalize(gl_NormalMatrix * (mat3(glm_instance) * (mat3(glm_group) * gl_Normal)));\n"
+    "    gl_FrontColor = gl_BackColor = glmLighting(eye.xyz, n);\n"
+    "}\n";
+
+static const char *glmFixedFragment =
+    "#ifdef GLM_LAYERED\n"
+    "uniform sampler2DArray glm_layers;\n"
+    "#endif\n"
+    "uniform int glm_texturing;\n"
+    "uniform sampler2D glm_texture;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = gl_Color;\n"
+    "    if (glm_lighting && glm_flat)\n"
+    "        gl_FragColor = glmLighting(glm_eye, normalize(cross(dFdx(glm_eye), dFdy(glm_eye))));\n"
+    "    if (glm_texturing == 1)\n"
+    "        gl_FragColor *= texture2D(glm_texture, gl_TexCoord[0].st);\n"
+    "#ifdef GLM_LAYERED\n"
+    "    else if (glm_texturing == 2)\n"
+    "        gl_FragColor *= texture2DArray(glm_layers, gl_TexCoord[0].stp);\n"
+    "#endif\n"
+    "}\n";
+
+static const char *glmRenderVertex =
+    "#ifdef GLM_WIREFRAME\n"
+    "#define glm_eye glm_vertexeye\n"
+    "#define glm_eyenormal glm_vertexnormal\n"
+    "#define glm_uv glm_vertexuv\n"
+    "#endif\n"
+    "in vec3 glm_position;\n"
+    "in vec3 glm_normal;\n"
+    "in vec3 glm_texcoord;\n"
+    "in mat4 glm_instance;\n"
+    "uniform mat4 glm_modelview;\n"
+    "uniform mat4 glm_projection;\n"
+    "uniform mat4 glm_group;\n"
+    "out vec3 glm_eye;\n"
+    "out vec3 glm_eyenormal;\n"
+    "out vec3 glm_uv;\n"
+    "void main()\n"
+    "{\n"
+    "    mat4 model = glm_modelview * glm_instance * glm_group;\n"
+    "    vec4 eye = model * vec4(glm_position, 1.0);\n"
+    "    glm_eye = eye.xyz;\n"
+    "    glm_eyenormal = mat3(model) * glm_normal;\n"
+    "    glm_uv = glm_texcoord;\n"
+    "    gl_Position = glm_projection * eye;\n"
+    "}\n";
+
+/* passes the triangle through, adding the distance in pixels of each
+   vertex to the opposite side; interpolated linearly in screen space
+   the smallest of the three is the distance of a pixel to the edges */
+static const char *glmRenderGeometry =
+    "layout(triangles) in;\n"
+    "layout(triangle_strip, max_vertices = 3) out;\n"
+    "uniform vec2 glm_viewport;\n"
+    "in vec3 glm_vertexeye[];\n"
+    "in vec3 glm_vertexnormal[];\n"
+    "in vec3 glm_vertexuv[];\n"
+    "out vec3 glm_eye;\n"
+    "out vec3 glm_eyenormal;\n"
+    "out vec3 glm_uv;\n"
+    "noperspective out vec3 glm_edge;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 p0 = glm_viewport * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
+    "    vec2 p1 = glm_viewport * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
+    "    vec2 p2 = glm_viewport * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
+    "    vec2 e1 = p1 - p0, e2 = p2 - p0;\n"
+    "    float area = abs(e1.x * e2.y - e1.y * e2.x);\n"
+    "    vec3 heights = area / vec3(length(p2 - p1), length(e2), length(e1));\n"
+    "    for (int i = 0; i < 3; i++) {\n"
+    "        gl_Position = gl_in[i].gl_Position;\n"
+    "        glm_eye = glm_vertexeye[i];\n"
+    "        glm_eyenormal = glm_vertexnormal[i];\n"
+    "        glm_uv = glm_vertexuv[i];\n"
+    "        glm_edge = vec3(0.0);\n"
+    "        glm_edge[i] = heights[i];\n"
+    "        EmitVertex();\n"
+    "    }\n"
+    "    EndPrimitive();\n"
+    "}\n";
+
+static const char *glmRenderFragment =
+    "struct glmMaterial {\n"
+    "    vec4 diffuse;\n"
+    "    vec4 ambient;\n"
+    "    vec4 specular;\n"
+    "    vec4 params;\n"
+    "};\n"
+    "layout(std140) uniform glm_materials {\n"
+    "    glmMaterial glm_material_data[GLM_MATERIALS];\n"
+    "};\n"
+    "uniform int glm_material;\n"
+    "uniform bool glm_lighting;\n"
+    "uniform bool glm_flat;\n"
+    "uniform bool glm_textures;\n"
+    "uniform vec4 glm_light;\n"
+    "uniform vec4 glm_lightambient;\n"
+    "uniform vec4 glm_lightdiffuse;\n"
+    "uniform vec4 glm_lightspecular;\n"
+    "uniform vec4 glm_sceneambient;\n"
+    "uniform vec4 glm_color;\n"
+    "uniform sampler2D glm_texture;\n"
+    "uniform sampler2DArray glm_layers;\n"
+    "in vec3 glm_eye;\n"
+    "in vec3 glm_eyenormal;\n"
+    "in vec3 glm_uv;\n"
+    "out vec4 glm_fragcolor;\n"
+    "#ifdef GLM_WIREFRAME\n"
+    "noperspective in vec3 glm_edge;\n"
+    "uniform float glm_wirewidth;\n"
+    "#endif\n"
+    "void main()\n"
+    "{\n"
+    "#ifdef GLM_WIREFRAME\n"
+    "    float edge = min(glm_edge.x, min(glm_edge.y, glm_edge.z));\n"
+    "#ifndef GLM_OVERLAY\n"
+    "    if (edge > 0.5 * glm_wirewidth)\n"
+    "        discard;\n"
+    "    glm_fragcolor = glm_color;\n"
+    "    return;\n"
+    "#endif\n"
+    "#endif\n"
+    "    glmMaterial m = glm_material_data[glm_material];\n"
+    "    vec4 color = glm_color;\n"
+    "    if (glm_lighting) {\n"
+    "        vec3 n = normalize(glm_flat ? cross(dFdx(glm_eye), dFdy(glm_eye)) : glm_eyenormal);\n"
+    "        vec3 l = normalize(glm_light.w == 0.0 ? glm_light.xyz : glm_light.xyz - glm_eye);\n"
+    "        vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n"
+    "        float d = max(dot(n, l), 0.0);\n"
+    "        color = (glm_sceneambient + glm_lightambient) * m.ambient +\n"
+    "                d * glm_lightdiffuse * m.diffuse;\n"
+    "        if (d > 0.0)\n"
+    "            color += pow(max(dot(n, h), 0.0), m.params.x) * glm_lightspecular * m.specular;\n"
+    "        color = clamp(color, 0.0, 1.0);\n"
+    "        color.a = m.diffuse.a;\n"
+    "    }\n"
+    "    if (glm_textures && m.params.y == 1.0)\n"
+    "        color *= texture(glm_texture, glm_uv.st);\n"
+    "    else if (glm_textures && m.params.y == 2.0)\n"
+    "        color *= texture(glm_layers, glm_uv);\n"
+    "#ifdef GLM_OVERLAY\n"
+    "    /* blend the edges into the surface over one pixel */\n"
+    "    color = mix(color, glm_color, 1.0 - smoothstep(0.5 * glm_wirewidth - 0.5,\n"
+    "                                                   0.5 * glm_wirewidth + 0.5, edge));\n"
+    "#endif\n"
+    "    glm_fragcolor = color;\n"
+    "}\n";
+
+/* glmCompileShader: compiles a shader from a header and a body,
+ * returns 0 on failure */
+static GLuint
+glmCompileShader(GLenum type, const char *header, const char *source)
+{
+    const char *sources[2];
+    GLuint shader;
+    GLint  status;
+    char   log[1024];
+
+    sources[0] = header ? header : "";
+    sources[1] = source;
+
+    shader = pglCreateShader(type);
+    pglShaderSource(shader, 2, sources, NULL);
+    pglCompileShader(shader);
+    pglGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        pglGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "glmCompileShader() failed: %s\n", log);
+        pglDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+/* glmShaderProgram: Compiles and links a program from a vertex, an
+ * optional geometry and a fragment shader.  Returns the program, or 0
+ * after printing the compiler or linker log.
+ *
+ * header     - text put in front of every shader (#version, #defines)
+ * vertex     - source of the vertex shader
+ * geometry   - source of the geometry shader, or NULL for none
+ * fragment   - source of the fragment shader
+ * attributes - NULL terminated list of attribute names (or NULL)
+ * locations  - location each attribute is bound to
+ */
+GLuint
+glmShaderProgram(const char *header, const char *vertex, const char *geometry,
+                 const char *fragment, const char **attributes, const GLuint *locations)
+{
+    GLuint program, vs, gs, fs, i;
+    GLint  status;
+    char   log[1024];
+
+    if (!(glmExtensions() & GLM_EXT_SHADERS))
+        return 0;
+    if (geometry && !(glmExtensions() & GLM_EXT_GEOMETRY))
+        return 0;
+
+    vs = glmCompileShader(GL_VERTEX_SHADER, header, vertex);
+    gs = geometry ? glmCompileShader(GL_GEOMETRY_SHADER, header, geometry) : 0;
+    fs = glmCompileShader(GL_FRAGMENT_SHADER, header, fragment);
+    if (!vs || (geometry && !gs) || !fs) {
+        if (vs) pglDeleteShader(vs);
+        if (gs) pglDeleteShader(gs);
+        if (fs) pglDeleteShader(fs);
+        return 0;
+    }
+
+    program = pglCreateProgram();
+    pglAttachShader(program, vs);
+    if (gs)
+        pglAttachShader(program, gs);
+    pglAttachShader(program, fs);
+    for (i = 0; attributes && attributes[i]; i++)
+        pglBindAttribLocation(program, locations[i], attributes[i]);
+    pglLinkProgram(program);
+
+    /* the program keeps the shaders alive */
+    pglDeleteShader(vs);
+    if (gs)
+        pglDeleteShader(gs);
+    pglDeleteShader(fs);
+
+    pglGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        pglGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "glmShaderProgram() link failed: %s\n", log);
+        pglDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/* glmFixedProgram: Returns a program standing in for the fixed
+ * function pipeline where it falls short.  It reproduces the lighting
+ * of GL_LIGHT0 and modulated texturing, with every vertex transformed
+ * by the glm_group uniform (and with GLM_PROGRAM_INSTANCED, then by the
+ * per-instance glm_instance attribute).  Uniforms:
+ *
+ *   glm_group     - mat4 applied first
+ *   glm_lighting  - bool, GL_LIGHTING is enabled
+ *   glm_flat      - bool, light each pixel with the normal of its
+ *                   triangle, taken from the screen space derivatives
+ *                   of the eye position (no normals needed)
+ *   glm_texturing - int, 0 none, 1 glm_texture (2D, unit 0),
+ *                   2 glm_layers (array, unit 1, layer in texcoord p)
+ *
+ * Each combination of features is built on first use; 0 is returned
+ * if that failed.
+ *
+ * features - bitwise OR of GLM_PROGRAM_* values
+ */
+GLuint
+glmFixedProgram(GLuint features)
+{
+    static GLboolean built[4] = { GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE };
+    static GLuint    programs[4] = { 0, 0, 0, 0 };
+    static const char  *attributes[] = { "glm_instance", NULL };
+    static const GLuint locations[] = { GLM_ATTRIB_INSTANCE };
+    char header[2048];
+
+    features &= 3;
+    if (!built[features]) {
+        built[features] = GL_TRUE;
+        strcpy(header, "#version 120\n");
+        if (features & GLM_PROGRAM_INSTANCED)
+            strcat(header, "#define GLM_INSTANCED\n");
+        if (features & GLM_PROGRAM_LAYERED)
+            strcat(header, "#define GLM_LAYERED\n"
+                           "#extension GL_EXT_texture_array : require\n");
+        strcat(header, glmFixedLighting);
+        programs[features] = glmShaderProgram(header, glmFixedVertex, NULL, glmFixedFragment,
+                                              attributes, locations);
+    }
+    return programs[features];
+}
+
+/* glmRenderProgram: Returns the program of the GLM_SHADER render mode
+ * (GLSL 1.40, no fixed function state); each combination of features
+ * is built on first use and 0 is returned if that failed.  Vertices
+ * come from the GLM_ATTRIB_* attributes and lighting is per pixel.
+ * Materials are read from the glm_materials uniform block (binding 0),
+ * an array of
+ *
+ *   struct { vec4 diffuse, ambient, specular, params; }
+ *
+ * in std140 layout, params holding the shininess and the kind of
+ * texture (0 none, 1 2D on unit 0, 2 array on unit 1).  Uniforms:
+ *
+ *   glm_modelview, glm_projection, glm_group - mat4
+ *   glm_light      - vec4 eye space position of the light
+ *   glm_lightambient, glm_lightdiffuse, glm_lightspecular,
+ *   glm_sceneambient, glm_color - vec4
+ *   glm_lighting, glm_textures - bool
+ *   glm_flat       - bool, normals from the derivatives of the eye
+ *                    position, one per triangle (as glmFixedProgram)
+ *   glm_material   - int, index of the material drawn
+ *
+ * GLM_PROGRAM_WIREFRAME draws only the edges of the triangles, in
+ * glm_color, and GLM_PROGRAM_OVERLAY draws them over the shaded
+ * triangles.  Both find the edges from the distance of each pixel to
+ * the sides of its triangle (GLSL 1.50 geometry shader) and add:
+ *
+ *   glm_viewport   - vec2, half the viewport size in pixels
+ *   glm_wirewidth  - float, width of the edges in pixels
+ *
+ * features     - GLM_PROGRAM_WIREFRAME, GLM_PROGRAM_OVERLAY or 0
+ * maxmaterials - if not NULL, the size of the material array
+ */
+GLuint
+glmRenderProgram(GLuint features, GLuint *maxmaterials)
+{
+    static GLboolean built[3] = { GL_FALSE, GL_FALSE, GL_FALSE };
+    static GLuint    programs[3] = { 0, 0, 0 };
+    static GLuint    materials = 0;
+    static const char  *attributes[] = { "glm_position", "glm_normal", "glm_texcoord",
+                                         "glm_instance", NULL };
+    static const GLuint locations[] = { GLM_ATTRIB_POSITION, GLM_ATTRIB_NORMAL,
+                                        GLM_ATTRIB_TEXCOORD, GLM_ATTRIB_INSTANCE };
+    GLint  blocksize;
+    GLuint block, program, wire;
+    char   header[128];
+
+    /* 0 shaded, 1 edges only, 2 edges over the shaded triangles */
+    wire = (features & GLM_PROGRAM_OVERLAY) ? 2 : (features & GLM_PROGRAM_WIREFRAME) ? 1 : 0;
+    if (!built[wire]) {
+        built[wire] = GL_TRUE;
+        if (!(glmExtensions() & GLM_EXT_UNIFORMBUFFERS))
+            return 0;
+
+        /* as many materials as a uniform block holds, 64 bytes each */
+        glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &blocksize);
+        materials = blocksize / 64;
+        if (materials > 4096)
+            materials = 4096;
+        sprintf(header, "#version %d\n#define GLM_MATERIALS %u\n", wire ? 150 : 140, materials);
+        if (wire)
+            strcat(header, "#define GLM_WIREFRAME\n");
+        if (wire == 2)
+            strcat(header, "#define GLM_OVERLAY\n");
+
+        program = glmShaderProgram(header, glmRenderVertex, wire ? glmRenderGeometry : NULL,
+                                   glmRenderFragment, attributes, locations);
+        if (program) {
+            /* the edges alone use no material */
+            block = pglGetUniformBlockIndex(program, "glm_materials");
+            if (block != GL_INVALID_INDEX)
+                pglUniformBlockBinding(program, block, 0);
+            pglUseProgram(program);
+            pglUniform1i(pglGetUniformLocation(program, "glm_texture"), 0);
+            pglUniform1i(pglGetUniformLocation(program, "glm_layers"), 1);
+            pglUseProgram(0);
+        }
+        programs[wire] = program;
+    }
+    if (maxmaterials)
+        *maxmaterials = programs[wire] ? materials : 0;
+    return programs[wire];
+}
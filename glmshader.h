@@ -0,0 +1,95 @@
+/*
+      glmshader.h
+
+      GLSL programs used by the GLM renderer.  They need the
+      GLM_EXT_SHADERS feature (see glmext.h).
+*/
+
+#ifndef GLMSHADER_H
+#define GLMSHADER_H
+
+#include <GL/gl.h>
+
+#define GLM_ATTRIB_POSITION  0          /* vec3 position */
+#define GLM_ATTRIB_NORMAL    1          /* vec3 normal */
+#define GLM_ATTRIB_TEXCOORD  2          /* vec3 texcoord (s, t, layer) */
+#define GLM_ATTRIB_INSTANCE  4          /* mat4 instance transform (4 to 7) */
+
+#define GLM_PROGRAM_INSTANCED (1 << 0)  /* per-instance glm_instance attribute */
+#define GLM_PROGRAM_LAYERED   (1 << 1)  /* texture arrays (EXT_texture_array) */
+#define GLM_PROGRAM_WIREFRAME (1 << 2)  /* triangle edges only */
+#define GLM_PROGRAM_OVERLAY   (1 << 3)  /* triangle edges over the shaded triangles */
+
+/* glmShaderProgram: Compiles and links a program from a vertex, an
+ * optional geometry and a fragment shader.  Returns the program, or 0
+ * after printing the compiler or linker log.
+ *
+ * header     - text put in front of every shader (#version, #defines)
+ * vertex     - source of the vertex shader
+ * geometry   - source of the geometry shader, or NULL for none
+ * fragment   - source of the fragment shader
+ * attributes - NULL terminated list of attribute names (or NULL)
+ * locations  - location each attribute is bound to
+ */
+GLuint
+glmShaderProgram(const char *header, const char *vertex, const char *geometry,
+                 const char *fragment, const char **attributes, const GLuint *locations);
+
+/* glmFixedProgram: Returns a program standing in for the fixed
+ * function pipeline where it falls short.  It reproduces the lighting
+ * of GL_LIGHT0 and modulated texturing, with every vertex transformed
+ * by the glm_group uniform (and with GLM_PROGRAM_INSTANCED, then by the
+ * per-instance glm_instance attribute).  Uniforms:
+ *
+ *   glm_group     - mat4 applied first
+ *   glm_lighting  - bool, GL_LIGHTING is enabled
+ *   glm_flat      - bool, light each pixel with the normal of its
+ *                   triangle, taken from the screen space derivatives
+ *                   of the eye position (no normals needed)
+ *   glm_texturing - int, 0 none, 1 glm_texture (2D, unit 0),
+ *                   2 glm_layers (array, unit 1, layer in texcoord p)
+ *
+ * Each combination of features is built on first use; 0 is returned
+ * if that failed.
+ *
+ * features - bitwise OR of GLM_PROGRAM_* values
+ */
+GLuint
+glmFixedProgram(GLuint features);
+
+/* glmRenderProgram: Returns the program of the GLM_SHADER render mode
+ * (GLSL 1.40, no fixed function state); each combination of features
+ * is built on first use and 0 is returned if that failed.  Vertices
+ * come from the GLM_ATTRIB_* attributes and lighting is per pixel.
+ * Materials are read from the glm_materials uniform block (binding 0),
+ * an array of
+ *
+ *   struct { vec4 diffuse, ambient, specular, params; }
+ *
+ * in std140 layout, params holding the shininess and the kind of
+ * texture (0 none, 1 2D on unit 0, 2 array on unit 1).  Uniforms:
+ *
+ *   glm_modelview, glm_projection, glm_group - mat4
+ *   glm_light      - vec4 eye space position of the light
+ *   glm_lightambient, glm_lightdiffuse, glm_lightspecular,
+ *   glm_sceneambient, glm_color - vec4
+ *   glm_lighting, glm_textures - bool
+ *   glm_flat       - bool, normals from the derivatives of the eye
+ *                    position, one per triangle (as glmFixedProgram)
+ *   glm_material   - int, index of the material drawn
+ *
+ * GLM_PROGRAM_WIREFRAME draws only the edges of the triangles, in
+ * glm_color, and GLM_PROGRAM_OVERLAY draws them over the shaded
+ * triangles.  Both find the edges from the distance of each pixel to
+ * the sides of its triangle (GLSL 1.50 geometry shader) and add:
+ *
+ *   glm_viewport   - vec2, half the viewport size in pixels
+ *   glm_wirewidth  - float, width of the edges in pixels
+ *
+ * features     - GLM_PROGRAM_WIREFRAME, GLM_PROGRAM_OVERLAY or 0
+ * maxmaterials - if not NULL, the size of the material array
+ */
+GLuint
+glmRenderProgram(GLuint features, GLuint *maxmaterials);
+
+#endif // GLMSHADER_H
@@ -23,18 +23,34 @@
 /*======================================== HEADERS =======================================*/
 
 #include "glwidget.h"
+#include "glmext.h"
+#include "frametimer.h"
+#include "framecapture.h"
+#include "framewriter.h"
+#include "rasterizer.h"
+#include "scene.h"
+#include "shading.h"
+#include "textoverlay.h"
 
 #include <QtGui/QMouseEvent>
 #include <QtGui/QWheelEvent>
+#include <QtOpenGL/QGLFramebufferObject>
 
 #include <QtCore/QTime>
+#include <QtCore/QTimer>
 
 #include <QtCore/QDebug>
 
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <GL/glu.h>
 
+/*======================================== DEFINES =======================================*/
+
+static const int CapturePollInterval = 15;  // milliseconds between checks for readbacks
+static const int RecordFps = 30;            // frame rate of recorded videos
+static const int StatsInterval = 500;       // milliseconds between updates of the statistics
 
 /*======================================== PUBLIC ========================================*/
 
@@ -48,16 +64,55 @@ GLWidget::GLWidget(QWidget *parent) :
 
     perspective = false;
     wireframe   = false;
+    overlay     = false;
     stats       = false;
     smooth      = false;
-    model       = NULL;
-    pmodel1     = NULL;
+    shaders     = false;
+    lod         = true;
+    scene       = new Scene;
+
+    software = false;
+    rasterizer = new Rasterizer;
 
     fpsTime = new QTime;
+    statsOverlay = new TextOverlay;
+    statsTime = 0;
+    statsTimer = new QTimer(this);
+    statsTimer->setSingleShot(true);
+    connect(statsTimer, SIGNAL(timeout()), this, SLOT(updateGL()));
+    frameTimer = new FrameTimer;
+    frameCapture = new FrameCapture;
+
+    captureTimer = new QTimer(this);
+    captureTimer->setInterval(CapturePollInterval);
+    connect(captureTimer, SIGNAL(timeout()), this, SLOT(finishCaptures()));
+
+    // frames are recorded as fast as they are drawn
+    recorder = NULL;
+    recordFbo = NULL;
+    recordTimer = new QTimer(this);
+    recordTimer->setInterval(0);
+    connect(recordTimer, SIGNAL(timeout()), this, SLOT(recordFrame()));
 
     bgColor = QColor::fromRgb(0,0,0,0);
 }
 
+GLWidget::~GLWidget()
+{
+    // screenshots still in flight are saved before the context goes
+    makeCurrent();
+    frameCapture->finish();
+    delete frameCapture;
+    delete frameTimer;
+    // the models, their lists, buffers and shared textures go with it
+    clearLists();
+    delete scene;
+    delete recorder;
+    delete recordFbo;
+    delete rasterizer;
+    delete statsOverlay;
+}
+
 QSize GLWidget::minimumSizeHint() const
 {
     return QSize(50, 50);
@@ -68,18 +123,138 @@ QSize GLWidget::sizeHint() const
     return QSize(400, 400);
 }
 
-void GLWidget::readFromFile(char *file)
+bool GLWidget::saveTimings(const QString &fileName) const
 {
-    if (file != model) {
-        model = file;
-        pmodel1 = glmReadOBJ(model);
-        glmUnitize(pmodel1);
-        glmFacetNormals(pmodel1);
-        printf("model loaded \"%s\"\n", model);
-    }
+    return frameTimer->writeCsv(fileName);
+}
+
+void GLWidget::saveScreenshot(const QString &fileName, int scale)
+{
+    Capture capture = { fileName, NULL, width() * scale, height() * scale };
+    captures.append(capture);
     updateGL();
 }
 
+bool GLWidget::record(const QString &target, int numFrames, int frameWidth, int frameHeight)
+{
+    if (recorder || numFrames < 1)
+        return false;
+
+    // video encoders want even sizes
+    recordWidth = qMax(frameWidth & ~1, 2);
+    recordHeight = qMax(frameHeight & ~1, 2);
+    recordFrames = numFrames;
+    recordedFrames = 0;
+    recordStart = currentView();
+    recorder = new FrameWriter(target, RecordFps);
+    recordTime.start();
+    recordTimer->start();
+    return true;
+}
+
+bool GLWidget::isRecording() const
+{
+    return recorder != NULL;
+}
+
+void GLWidget::addKeyframe()
+{
+    keyframes.append(currentView());
+}
+
+void GLWidget::clearKeyframes()
+{
+    keyframes.clear();
+}
+
+int GLWidget::keyframeCount() const
+{
+    return keyframes.size();
+}
+
+void GLWidget::openFiles(const QStringList &files)
+{
+    // the buffer objects, lists and textures belong to our context
+    makeCurrent();
+    clearLists();
+    scene->clear();
+    addFiles(files);
+}
+
+void GLWidget::addFiles(const QStringList &files)
+{
+    makeCurrent();
+    scene->load(files);
+    updateGL();
+}
+
+int GLWidget::modelCount() const
+{
+    return scene->count();
+}
+
+GLMmodel *GLWidget::model(int index) const
+{
+    return scene->model(index);
+}
+
+QString GLWidget::modelFile(int index) const
+{
+    return scene->fileName(index);
+}
+
+GLMmodel *GLWidget::loadModel(char *file)
+{
+    GLMmodel *model = readModel(file);
+    if (model)
+        setupModel(model);
+    return model;
+}
+
+GLMmodel *GLWidget::readModel(char *file)
+{
+    GLMmodel *model = glmReadOBJ(file, NULL, GL_FALSE);
+    if (!model)
+        return NULL;
+
+    // repeated parts are matched to a ten-thousandth of the model size,
+    // well above the precision the OBJ text keeps
+    GLfloat dimensions[3];
+    glmDimensions(model, dimensions);
+    GLuint instances = glmDetectInstances(model, 1e-4 *
+                       sqrt(dimensions[0] * dimensions[0] +
+                            dimensions[1] * dimensions[1] +
+                            dimensions[2] * dimensions[2]));
+
+    size_t reclaimed = glmCompact(model);
+    glmUnitizeTransform(model);
+    printf("model loaded \"%s\"\n", file);
+    printf("%u instanced groups, compacted, %lu bytes reclaimed\n",
+           instances, (unsigned long)reclaimed);
+    if (model->pointcloud)
+        printf("%u points in %u octree nodes\n", model->pointcloud->numpoints,
+               model->pointcloud->numnodes);
+    return model;
+}
+
+void GLWidget::setupModel(GLMmodel *model, GLMtexturecache *textures)
+{
+    if (textures)
+        glmLoadTextures(model, textures);
+    else
+        glmLoadTextures(model);
+    GLuint packed = glmPackTextures(model);
+    glmSortGroups(model);
+    // the triangles are laid out in the order the groups are drawn
+    glmReorder(model);
+    // flat shading only needs facet normals without shaders
+    if ((glmExtensions() & (GLM_EXT_BUFFERS | GLM_EXT_SHADERS)) !=
+        (GLM_EXT_BUFFERS | GLM_EXT_SHADERS))
+        glmFacetNormals(model);
+    printf("%u textures packed into %u texture arrays\n",
+           packed, model->numtexturearrays);
+}
+
 static void qNormalizeAngle(int &angle)
 {
     while (angle < 0)
@@ -96,12 +271,36 @@ void GLWidget::setWireframe(bool value)
     updateGL();
 }
 
+void GLWidget::setOverlay(bool value)
+{
+    overlay = value;
+    updateGL();
+}
+
 void GLWidget::setSmooth(bool value)
 {
     smooth = value;
     updateGL();
 }
 
+void GLWidget::setShaders(bool value)
+{
+    shaders = value;
+    updateGL();
+}
+
+void GLWidget::setLod(bool value)
+{
+    lod = value;
+    updateGL();
+}
+
+void GLWidget::setSoftware(bool value)
+{
+    software = value;
+    updateGL();
+}
+
 void GLWidget::setStats(bool value)
 {
     stats = value;
@@ -161,8 +360,59 @@ void GLWidget::setDistance(int dis)
     updateGL(); // calls glDraw() -> paintGL()
 }
 
+void GLWidget::setInstanceGrid(int rows, int columns)
+{
+    if (!scene->count())
+        return;
+
+    // display lists hold the copies too
+    makeCurrent();
+    scene->setInstanceGrid(rows, columns);
+    clearLists();
+    updateGL();
+}
+
 /*===================================== PRIVATE SLOTS ====================================*/
 
+void GLWidget::finishCaptures()
+{
+    makeCurrent();
+    if (!frameCapture->poll())
+        captureTimer->stop();
+}
+
+void GLWidget::recordFrame()
+{
+    if (recordedFrames < recordFrames) {
+        // a turn comes back to where it started, a path ends on its last keyframe
+        double t = keyframes.size() < 2 ? (double)recordedFrames / recordFrames :
+                   recordFrames > 1 ? (double)recordedFrames / (recordFrames - 1) : 0.0;
+        setView(pathView(t));
+        Capture capture = { QString(), recorder, recordWidth, recordHeight };
+        captures.append(capture);
+        updateGL();
+        recordedFrames++;
+        return;
+    }
+
+    recordTimer->stop();
+    makeCurrent();
+    frameCapture->finish();
+    bool ok = recorder->close();
+    delete recorder;
+    recorder = NULL;
+    delete recordFbo;
+    recordFbo = NULL;
+
+    double seconds = recordTime.elapsed() / 1000.0;
+    printf("recorded %d frames of %dx%d in %.1f s (%.1f fps)\n", recordFrames,
+           recordWidth, recordHeight, seconds, seconds > 0.0 ? recordFrames / seconds : 0.0);
+
+    setView(recordStart);
+    updateGL();
+    emit recordingFinished(ok);
+}
+
 /*======================================= PROTECTED ======================================*/
 
 void GLWidget::initializeGL()
@@ -172,12 +422,17 @@ void GLWidget::initializeGL()
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_LIGHT0);
 
-    static GLfloat lightPosition[4] = { 0.5, 5.0, 7.0, 1.0 };
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+    // the model transform scales the modelview matrix, renormalize normals
+    glEnable(GL_NORMALIZE);
+
+    glLightfv(GL_LIGHT0, GL_POSITION, LightPosition);
 }
 
 void GLWidget::paintGL()
 {
+    frameTimer->beginFrame();
+    frameTimer->beginPhase(FrameTimer::Setup);
+
     qglClearColor(bgColor);
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -197,8 +452,13 @@ void GLWidget::paintGL()
     glRotatef(yRot / 16.0, 0.0, 1.0, 0.0);
     glRotatef(zRot / 16.0, 0.0, 0.0, 1.0);
 
+    // with geometry shaders the edges are found per pixel in one pass,
+    // much cheaper than rasterizing every edge as a line; glmDraw goes
+    // back to lines itself for a model its program can't draw
+    bool wireShader = (glmExtensions() & GLM_EXT_GEOMETRY) != 0;
+
     if (wireframe) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glPolygonMode(GL_FRONT_AND_BACK, wireShader ? GL_FILL : GL_LINE);
         glLineWidth(1);
         glDisable(GL_LIGHTING);
         glDisable(GL_CULL_FACE);
@@ -209,34 +469,108 @@ void GLWidget::paintGL()
     }
 
     int numvertices(0), numtriangles(0), nummaterials(0),
-        numtextures(0), numnormals(0), numgroups(0);
+        numtextures(0), numnormals(0), numgroups(0),
+        numdrawgroups(0), numdrawcalls(0), numlods(0),
+        numpoints(0), numdrawpoints(0);
+    int lodtriangles[GLM_MAXLODS] = { 0 };
+
+    frameTimer->beginPhase(FrameTimer::Draw);
+
+    GLuint mode = GLM_TEXTURE | GLM_MATERIAL;
+    mode |= smooth ? GLM_SMOOTH : GLM_FLAT;
+    if (shaders)
+        mode |= GLM_SHADER;
+    if (wireframe && wireShader)
+        mode |= GLM_WIREFRAME;
+    else if (overlay && wireShader)
+        mode |= GLM_OVERLAY;
+
+    int nummodels = scene->count();
+    if (nummodels) {
+        drawScene(mode);
+        for (int i = 0; i < nummodels; i++) {
+            GLMmodel *model = scene->model(i);
+            numvertices += model->numvertices;
+            numtriangles += model->numtriangles;
+            nummaterials += model->nummaterials;
+            numtextures += model->numtextures;
+            numnormals += model->numnormals;
+            numgroups += model->numgroups;
+            numdrawgroups += model->numdrawgroups;
+            numdrawcalls += model->numdrawcalls;
+            numlods = qMax(numlods, (int)model->numlods);
+            for (GLuint level = 0; level <= model->numlods; level++)
+                lodtriangles[level] += model->lodtriangles[level];
+            if (model->pointcloud) {
+                numpoints += model->pointcloud->numpoints;
+                numdrawpoints += model->numdrawpoints;
+            }
+        }
+    }
 
-    bool isLoaded = (model != NULL) ? true : false;
-    if (isLoaded) {
-        if (smooth)
-            glmDraw(pmodel1, GLM_SMOOTH | GLM_TEXTURE | GLM_MATERIAL);
-        else
-            glmDraw(pmodel1, GLM_FLAT | GLM_TEXTURE | GLM_MATERIAL);
-
-        numvertices = pmodel1->numvertices;
-        numtriangles = pmodel1->numtriangles;
-        nummaterials = pmodel1->nummaterials;
-        numtextures = pmodel1->numtextures;
-        numnormals = pmodel1->numnormals;
-        numgroups = pmodel1->numgroups;
+    // screenshots leave out the statistics
+    if (!captures.isEmpty())
+        captureFrames(mode);
+
+    frameTimer->beginPhase(FrameTimer::Overlay);
+
+    // the timings change every frame, they are taken a few times a second
+    // so that the overlay is only painted again when something changed
+    if (stats && qAbs(elapsedTime - statsTime) >= StatsInterval) {
+        statsTime = elapsedTime;
+        statsTimings.clear();
+        statsTimings << QString("fps: ") + QString::number(fps);
+
+        // averages of the last frames, the gpu ones trail a few frames
+        QString cpuText = QString("cpu ms: %1 (").arg(frameTimer->cpuFrameAverage(), 0, 'f', 2);
+        QString gpuText = QString("gpu ms: %1 (").arg(frameTimer->gpuFrameAverage(), 0, 'f', 2);
+        for (int i = 0; i < FrameTimer::Phases; i++) {
+            FrameTimer::Phase phase = FrameTimer::Phase(i);
+            QString separator = (i + 1 < FrameTimer::Phases) ? ", " : ")";
+            cpuText += QString("%1 %2").arg(FrameTimer::phaseName(phase))
+                       .arg(frameTimer->cpuAverage(phase), 0, 'f', 2) + separator;
+            gpuText += QString("%1 %2").arg(FrameTimer::phaseName(phase))
+                       .arg(frameTimer->gpuAverage(phase), 0, 'f', 2) + separator;
+        }
+        statsTimings << cpuText;
+        statsTimings << (frameTimer->hasGpu() ? gpuText : QString("gpu ms: no timer queries"));
+    } else if (stats && !statsTimer->isActive()) {
+        // nothing may repaint later, the skipped timings are drawn then
+        statsTimer->start(qMax(StatsInterval - qAbs(elapsedTime - statsTime), 1));
     }
 
+    // the counts are cheap and follow every change of the scene
     if (stats) {
-        renderText(20,20, isLoaded ? QString("Model is loaded") :
-                   QString("Model is not loaded"), QFont("TypeWriter", 10, QFont::Bold));
-        renderText(20,35,   QString("vertices: ")   + QString::number(numvertices));
-        renderText(20,50,   QString("triangles: ")  + QString::number(numtriangles));
-        renderText(20,65,   QString("materials: ")  + QString::number(nummaterials));
-        renderText(20,80,   QString("textures: ")   + QString::number(numtextures));
-        renderText(20,95,   QString("normals: ")    + QString::number(numnormals));
-        renderText(20,110,  QString("groups: ")     + QString::number(numgroups));
-        renderText(20,125,  QString("fps: ")        + QString::number(fps));
+        QStringList lines;
+        lines << (nummodels > 1 ? QString("%1 models are loaded").arg(nummodels) :
+                  nummodels ? QString("Model is loaded") : QString("Model is not loaded"));
+        lines << QString("vertices: ")   + QString::number(numvertices);
+        lines << QString("triangles: ")  + QString::number(numtriangles);
+        lines << QString("materials: ")  + QString::number(nummaterials);
+        lines << QString("textures: ")   + QString::number(numtextures);
+        lines << QString("normals: ")    + QString::number(numnormals);
+        lines << QString("groups: ")     + QString::number(numgroups);
+        lines << QString("draw calls: ") + QString::number(numdrawcalls) +
+                 QString(" (") + QString::number(numdrawgroups) + QString(" groups)");
+        lines << statsTimings;
+
+        // triangles drawn at each level of detail, the full one first
+        if (numlods) {
+            QString lodText("lod triangles: ");
+            for (int level = 0; level <= numlods; level++)
+                lodText += QString::number(lodtriangles[level]) + (level < numlods ? " / " : "");
+            lines << lodText;
+        }
+
+        // the points of the clouds are chosen by their spacing on screen
+        if (numpoints)
+            lines << QString("points: %1 of %2").arg(numdrawpoints).arg(numpoints);
+
+        statsOverlay->setLines(lines);
+        statsOverlay->draw(20, 20, width(), height());
     }
+
+    frameTimer->endFrame();
 }
 
 void GLWidget::resizeGL(int width, int height)
@@ -280,32 +614,237 @@ void GLWidget::wheelEvent(QWheelEvent *event)
 
 /*======================================== PRIVATE =======================================*/
 
+GLWidget::Keyframe GLWidget::currentView() const
+{
+    Keyframe view = { xRot, yRot, zRot, disPos };
+    return view;
+}
+
+void GLWidget::setView(const Keyframe &view)
+{
+    xRot = view.xRot;
+    yRot = view.yRot;
+    zRot = view.zRot;
+    if (disPos != view.disPos) {
+        disPos = view.disPos;
+        updateCamera();
+    }
+}
+
+// the view a fraction t along the keyframes, linearly between them; a
+// turn about the y axis from the first keyframe, or the view recording
+// started from, without two of them
+GLWidget::Keyframe GLWidget::pathView(double t) const
+{
+    if (keyframes.size() < 2) {
+        Keyframe view = keyframes.isEmpty() ? recordStart : keyframes.first();
+        view.yRot += qRound(t * 360 * 16);
+        return view;
+    }
+
+    double position = t * (keyframes.size() - 1);
+    int i = qMin(int(position), keyframes.size() - 2);
+    double f = position - i;
+    const Keyframe &a = keyframes.at(i), &b = keyframes.at(i + 1);
+    Keyframe view = { a.xRot + qRound(f * (b.xRot - a.xRot)),
+                      a.yRot + qRound(f * (b.yRot - a.yRot)),
+                      a.zRot + qRound(f * (b.zRot - a.zRot)),
+                      a.disPos + qRound(f * (b.disPos - a.disPos)) };
+    return view;
+}
+
+void GLWidget::drawScene(GLuint mode)
+{
+    if (software) {
+        drawSoftware(mode);
+        return;
+    }
+
+    glPushMatrix();
+    scene->applyTransform();
+    for (int i = 0; i < scene->count(); i++) {
+        GLMmodel *model = scene->model(i);
+        // coarser levels may be off by at most a pixel on screen
+        model->lodtolerance = lod ? 1.0 : 0.0;
+        glPushMatrix();
+        glmApplyTransform(model);
+        drawModel(model, mode);
+        glPopMatrix();
+    }
+    glPopMatrix();
+}
+
+// draws the scene with the rasterizer into the current viewport, taking
+// the matrices from GL so that both draw the same view; only the image
+// is handed to GL
+void GLWidget::drawSoftware(GLuint mode)
+{
+    GLint viewport[4];
+    GLfloat projection[16], modelview[16];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+
+    // the wireframe is drawn filled and unlit
+    rasterizer->begin(viewport[2], viewport[3], bgColor.rgba());
+    rasterizer->setProjection(projection);
+    rasterizer->setLight(LightPosition);
+    rasterizer->setLighting(!wireframe);
+    rasterizer->setCulling(!wireframe);
+
+    glPushMatrix();
+    scene->applyTransform();
+    for (int i = 0; i < scene->count(); i++) {
+        GLMmodel *model = scene->model(i);
+        glPushMatrix();
+        glmApplyTransform(model);
+        glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+        rasterizer->draw(model, modelview, mode);
+        glPopMatrix();
+    }
+    glPopMatrix();
+
+    QImage image = convertToGLFormat(rasterizer->end());
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glRasterPos2f(-1.0, -1.0);
+    glDrawPixels(image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// reads back the frame just drawn for each screenshot asked for, larger
+// ones are drawn again into a framebuffer object of their size
+void GLWidget::captureFrames(GLuint mode)
+{
+    GLint maxSize[2];
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxSize);
+
+    while (!captures.isEmpty()) {
+        Capture capture = captures.takeFirst();
+        if (capture.width == width() && capture.height == height()) {
+            if (capture.writer)
+                frameCapture->capture(0, 0, width(), height(), capture.writer);
+            else
+                frameCapture->capture(0, 0, width(), height(), capture.fileName);
+            continue;
+        }
+
+        // a recording keeps its object from frame to frame
+        QGLFramebufferObject *fbo = capture.writer ? recordFbo : NULL;
+        if (fbo && fbo->size() != QSize(capture.width, capture.height)) {
+            delete fbo;
+            fbo = recordFbo = NULL;
+        }
+        if (!fbo && capture.width <= maxSize[0] && capture.height <= maxSize[1])
+            fbo = new QGLFramebufferObject(capture.width, capture.height,
+                                           QGLFramebufferObject::Depth);
+        if (!fbo || !fbo->isValid()) {
+            fprintf(stderr, "can't draw a %dx%d capture\n", capture.width, capture.height);
+            delete fbo;
+            continue;
+        }
+        if (capture.writer)
+            recordFbo = fbo;
+
+        fbo->bind();
+        glViewport(0, 0, capture.width, capture.height);
+        updateCamera(capture.width, capture.height);
+        qglClearColor(bgColor);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawScene(mode);
+        if (capture.writer)
+            frameCapture->capture(0, 0, capture.width, capture.height, capture.writer);
+        else
+            frameCapture->capture(0, 0, capture.width, capture.height, capture.fileName);
+        fbo->release();
+        glViewport(0, 0, width(), height());
+        updateCamera();
+        // the readback was queued before a screenshot's object goes
+        if (fbo != recordFbo)
+            delete fbo;
+    }
+
+    // the readbacks are collected while the user goes on
+    captureTimer->start();
+}
+
+void GLWidget::drawModel(GLMmodel *model, GLuint mode)
+{
+    // buffer objects already keep the geometry on the GPU, and the
+    // points of a cloud are picked anew for every view
+    if (glmExtensions() & GLM_EXT_BUFFERS || model->pointcloud) {
+        glmDraw(model, mode);
+        return;
+    }
+
+    // lists are compiled again once groups are shown or hidden
+    QPair<GLMmodel *, GLuint> key(model, mode);
+    QPair<GLuint, GLuint> list = lists.value(key);
+    if (list.first && list.second != model->visibleserial) {
+        glDeleteLists(list.first, 1);
+        list.first = 0;
+    }
+    if (!list.first) {
+        list = qMakePair(glmList(model, mode), model->visibleserial);
+        lists.insert(key, list);
+    }
+    glCallList(list.first);
+}
+
+void GLWidget::clearLists()
+{
+    typedef QPair<GLuint, GLuint> List;
+    foreach (List list, lists)
+        glDeleteLists(list.first, 1);
+    lists.clear();
+}
+
 void GLWidget::updateCamera()
 {
+    updateCamera(width(), height());
+}
+
+// the projection of a view of the given size in pixels
+void GLWidget::updateCamera(int viewWidth, int viewHeight)
+{
+    double aspect = (double)viewWidth / (double)viewHeight;
+
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
     if(perspective)
 
 
-        if (width() > height()) {
-            glFrustum((-0.5 + disPos)*aspectRatio, (+0.5 - disPos)*aspectRatio,
+        if (viewWidth > viewHeight) {
+            glFrustum((-0.5 + disPos)*aspect, (+0.5 - disPos)*aspect,
                     -0.5 + disPos, +0.5 - disPos, 4.0, 15.0);
         } else {
-            glFrustum(-0.5 + disPos, +0.5 - disPos, (-0.5 + disPos)/aspectRatio,
-                    (+0.5 - disPos)/aspectRatio, 4.0, 15.0);
+            glFrustum(-0.5 + disPos, +0.5 - disPos, (-0.5 + disPos)/aspect,
+                    (+0.5 - disPos)/aspect, 4.0, 15.0);
         }
 
 
     else
 
 
-        if (width() > height()) {
-            glOrtho((-0.5 + disPos)*aspectRatio, (+0.5 - disPos)*aspectRatio,
+        if (viewWidth > viewHeight) {
+            glOrtho((-0.5 + disPos)*aspect, (+0.5 - disPos)*aspect,
                     -0.5 + disPos, +0.5 - disPos, 4.0, 15.0);
         } else {
-            glOrtho(-0.5 + disPos, +0.5 - disPos, (-0.5 + disPos)/aspectRatio,
-                    (+0.5 - disPos)/aspectRatio, 4.0, 15.0);
+            glOrtho(-0.5 + disPos, +0.5 - disPos, (-0.5 + disPos)/aspect,
+                    (+0.5 - disPos)/aspect, 4.0, 15.0);
         }
 
 
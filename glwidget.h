@@ -27,31 +27,76 @@
 
 #include <QtOpenGL/QGLWidget>
 
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
+#include <QtCore/QTime>
+
 #include "glm.h"
 
 /*======================================== CLASSES =======================================*/
 
 QT_BEGIN_NAMESPACE
-class QTime;
+class QGLFramebufferObject;
+class QTimer;
 QT_END_NAMESPACE
 
+class FrameTimer;
+class FrameCapture;
+class FrameWriter;
+class Rasterizer;
+class Scene;
+class TextOverlay;
+
 class GLWidget : public QGLWidget
 {
         Q_OBJECT
 
     public:
         GLWidget(QWidget *parent = 0);
+        ~GLWidget();
 
         QSize sizeHint() const;
         QSize minimumSizeHint() const;
-        void readFromFile(char *file);
+        // replaces the models shown, or adds to them
+        void openFiles(const QStringList &files);
+        void addFiles(const QStringList &files);
+        int modelCount() const;
+        GLMmodel *model(int index) const;
+        QString modelFile(int index) const;
+        bool saveTimings(const QString &fileName) const;
+        // saves the next frame as PNG, scale times the size of the
+        // widget; it is read back and encoded while drawing goes on
+        void saveScreenshot(const QString &fileName, int scale = 1);
+        // records numFrames frames of the given size along the camera
+        // keyframes, or a full turn about the y axis without two of them,
+        // into a video or an image sequence (see FrameWriter); returns at
+        // once, frames follow as fast as they are drawn
+        bool record(const QString &target, int numFrames, int frameWidth, int frameHeight);
+        bool isRecording() const;
+        void addKeyframe();
+        void clearKeyframes();
+        int keyframeCount() const;
+
+        // reads a model and prepares it for drawing, the context the
+        // textures and buffers belong to must be current
+        static GLMmodel *loadModel(char *file);
+        // the two halves of loadModel: reading needs no context and
+        // may run on any thread, the setup needs the context
+        static GLMmodel *readModel(char *file);
+        static void setupModel(GLMmodel *model, GLMtexturecache *textures = NULL);
 
     public slots:
         void setWireframe(bool value);
+        void setOverlay(bool value);
         void setSmooth(bool value);
+        void setShaders(bool value);
+        void setLod(bool value);
+        void setSoftware(bool value);
         void setStats(bool value);
         void setPerspective(bool value);
         void setBgColor(QColor value);
+        void setInstanceGrid(int rows, int columns);
         void setXRotation(int angle);
         void setYRotation(int angle);
         void setZRotation(int angle);
@@ -64,6 +109,12 @@ class GLWidget : public QGLWidget
 
         void distanceChanged(int dis);
 
+        void recordingFinished(bool ok);
+
+    private slots:
+        void finishCaptures();
+        void recordFrame();
+
     protected:
         void initializeGL();
         void paintGL();
@@ -82,19 +133,79 @@ class GLWidget : public QGLWidget
         double aspectRatio;
         QPoint lastPos;
 
+        // rotations and distance of the camera
+        struct Keyframe {
+            int xRot;
+            int yRot;
+            int zRot;
+            int disPos;
+        };
+
         void updateCamera();
+        void updateCamera(int viewWidth, int viewHeight);
+        Keyframe currentView() const;
+        void setView(const Keyframe &view);
+        Keyframe pathView(double t) const;
+        void drawScene(GLuint mode);
+        void drawSoftware(GLuint mode);
+        void captureFrames(GLuint mode);
+        void drawModel(GLMmodel *model, GLuint mode);
+        void clearLists();
 
         QColor bgColor;
 
         QTime *fpsTime;
         int fps, frames, elapsedTime, baseTime;
 
+        // the statistics drawn from a texture, the timings among them are
+        // taken now and then
+        TextOverlay *statsOverlay;
+        QStringList statsTimings;
+        int statsTime;
+        QTimer *statsTimer;
+
+        // per phase cpu and gpu times of the recent frames
+        FrameTimer *frameTimer;
+
+        // frames to read back after the next draw, into a file or
+        // the writer of a recording
+        struct Capture {
+            QString fileName;
+            FrameWriter *writer;
+            int width;
+            int height;
+        };
+        QList<Capture> captures;
+        FrameCapture *frameCapture;
+        QTimer *captureTimer;
+
+        // camera path and the recording along it
+        QList<Keyframe> keyframes;
+        Keyframe recordStart;
+        FrameWriter *recorder;
+        // where the frames are drawn when their size is not the window's
+        QGLFramebufferObject *recordFbo;
+        int recordWidth, recordHeight, recordFrames, recordedFrames;
+        QTimer *recordTimer;
+        QTime recordTime;
+
         bool perspective;
         bool wireframe;
+        bool overlay;
         bool stats;
         bool smooth;
-        char *model;
-        GLMmodel *pmodel1;
+        bool shaders;
+        bool lod;
+        Scene *scene;
+
+        // draws in place of GL when software is set
+        bool software;
+        Rasterizer *rasterizer;
+
+        // compiled display lists by model and render mode, with the
+        // visibleserial of the model they were compiled for, used when
+        // buffer objects are unavailable
+        QHash<QPair<GLMmodel *, GLuint>, QPair<GLuint, GLuint> > lists;
 };
 
 #endif // GLWIDGET_H
@@ -0,0 +1,112 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: modelreader.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "modelreader.h"
+#include "glwidget.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRunnable>
+
+/*======================================== GLOBAL ========================================*/
+
+class ReadTask : public QRunnable
+{
+    public:
+        ReadTask(ModelReader *reader, int index) :
+            reader(reader), index(index)
+        {
+        }
+
+        void run()
+        {
+            QByteArray name = QFile::encodeName(reader->files.at(index));
+            GLMmodel *model = GLWidget::readModel(name.data());
+            if (model && reader->vertexNormals && !model->numnormals && model->numtriangles) {
+                glmFacetNormals(model);
+                glmVertexNormals(model, 90.0);
+            }
+            reader->put(index, model);
+        }
+
+    private:
+        ModelReader *reader;
+        int index;
+};
+
+/*======================================== PUBLIC ========================================*/
+
+ModelReader::ModelReader(const QStringList &files, bool vertexNormals, int ahead) :
+    files(files), vertexNormals(vertexNormals), started(0), taken(0)
+{
+    if (ahead <= 0)
+        ahead = files.size();
+    while (started < files.size() && started < ahead)
+        start();
+}
+
+ModelReader::~ModelReader()
+{
+    pool.waitForDone();
+    while (!models.isEmpty())
+        glmDelete(models.takeFirst().second);
+}
+
+bool ModelReader::take(GLMmodel **model, int *index)
+{
+    if (taken == files.size())
+        return false;
+
+    QMutexLocker locker(&mutex);
+    while (models.isEmpty())
+        ready.wait(&mutex);
+    QPair<int, GLMmodel *> read = models.takeFirst();
+    locker.unlock();
+
+    // one read in for every model out
+    if (started < files.size())
+        start();
+    taken++;
+
+    if (index)
+        *index = read.first;
+    *model = read.second;
+    return true;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+void ModelReader::start()
+{
+    pool.start(new ReadTask(this, started));
+    started++;
+}
+
+void ModelReader::put(int index, GLMmodel *model)
+{
+    QMutexLocker locker(&mutex);
+    models.append(qMakePair(index, model));
+    ready.wakeOne();
+}
+
+/*========================================================================================*/
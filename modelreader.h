@@ -0,0 +1,74 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: modelreader.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef MODELREADER_H
+#define MODELREADER_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include "glm.h"
+
+/*======================================== CLASSES =======================================*/
+
+// Reads models on a pool of threads and hands them out in the order
+// they are done.  Only what needs no context is done on the pool (see
+// GLWidget::readModel), the rest is left to the thread taking them.
+class ModelReader
+{
+    public:
+        // vertexNormals - also compute normals for models without any
+        // ahead         - models read before they are taken, 0 for all
+        ModelReader(const QStringList &files, bool vertexNormals = false, int ahead = 0);
+        // waits for the reads in flight, models not taken are deleted
+        ~ModelReader();
+
+        // blocks until a model is read, false once all have been taken;
+        // the model is NULL if its file could not be read, index is its
+        // position in the list of files
+        bool take(GLMmodel **model, int *index);
+
+    private:
+        friend class ReadTask;
+
+        void start();
+        void put(int index, GLMmodel *model);
+
+        QStringList files;
+        bool vertexNormals;
+        int started;
+        int taken;
+
+        QMutex mutex;
+        QWaitCondition ready;
+        QList<QPair<int, GLMmodel *> > models;
+        QThreadPool pool;
+};
+
+#endif // MODELREADER_H
+
+/*========================================================================================*/
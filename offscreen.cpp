@@ -0,0 +1,291 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: offscreen.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+
+/*======================================== HEADERS =======================================*/
+
+#include "offscreen.h"
+#include "glmext.h"
+#include "rasterizer.h"
+#include "raytracer.h"
+#include "shading.h"
+
+#include <QtGui/QMatrix4x4>
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/*======================================== GLOBAL ========================================*/
+
+#ifndef _WIN32
+static void *eglProcAddress(const char *name)
+{
+    return (void *)eglGetProcAddress(name);
+}
+#endif
+
+/*======================================== PUBLIC ========================================*/
+
+OffscreenRenderer::OffscreenRenderer(int width, int height, bool software) :
+    width(width), height(height), xRot(0), yRot(0), zRot(0), smooth(false),
+    rayPasses(0), raySamples(0), display(NULL), surface(NULL), context(NULL), rasterizer(NULL)
+{
+    if (!software && createContext())
+        return;
+    if (!software)
+        fprintf(stderr, "offscreen: drawing in software instead\n");
+    rasterizer = new Rasterizer;
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    delete rasterizer;
+#ifndef _WIN32
+    if (!display)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglTerminate(display);
+#endif
+}
+
+bool OffscreenRenderer::isValid() const
+{
+    if (rasterizer)
+        return true;
+#ifdef _WIN32
+    return false;
+#else
+    return display && surface != EGL_NO_SURFACE && context != EGL_NO_CONTEXT;
+#endif
+}
+
+bool OffscreenRenderer::makeCurrent()
+{
+#ifdef _WIN32
+    return false;
+#else
+    return eglMakeCurrent(display, surface, surface, context);
+#endif
+}
+
+bool OffscreenRenderer::isSoftware() const
+{
+    return rasterizer != NULL;
+}
+
+void OffscreenRenderer::setRotation(float x, float y, float z)
+{
+    xRot = x;
+    yRot = y;
+    zRot = z;
+}
+
+void OffscreenRenderer::setSmooth(bool value)
+{
+    smooth = value;
+}
+
+void OffscreenRenderer::setRayTracing(int passes, int samples)
+{
+    rayPasses = qMax(passes, 0);
+    raySamples = qMax(samples, 0);
+}
+
+QImage OffscreenRenderer::render(GLMmodel *model)
+{
+    if (rayPasses)
+        return renderRayTraced(model);
+    if (rasterizer)
+        return renderSoftware(model);
+
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(0);
+    if (!isValid() || !makeCurrent())
+        return image;
+
+    // the state of GLWidget::initializeGL and its default camera
+    glViewport(0, 0, width, height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    double aspectRatio = (double)width / (double)height;
+    if (width > height)
+        glFrustum(-0.5 * aspectRatio, 0.5 * aspectRatio, -0.5, 0.5, 4.0, 15.0);
+    else
+        glFrustum(-0.5, 0.5, -0.5 / aspectRatio, 0.5 / aspectRatio, 4.0, 15.0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_NORMALIZE);
+    glLightfv(GL_LIGHT0, GL_POSITION, LightPosition);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_CULL_FACE);
+
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (model) {
+        glTranslatef(0.0, 0.0, -10.0);
+        glRotatef(xRot, 1.0, 0.0, 0.0);
+        glRotatef(yRot, 0.0, 1.0, 0.0);
+        glRotatef(zRot, 0.0, 0.0, 1.0);
+        glmApplyTransform(model);
+        glmDraw(model, GLM_TEXTURE | GLM_MATERIAL | (smooth ? GLM_SMOOTH : GLM_FLAT));
+    }
+
+    // BGRA in reversed words is ARGB32 on any byte order, rows bottom up
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image.bits());
+    return image.mirrored();
+}
+
+/*======================================== PRIVATE =======================================*/
+
+// the EGL display, pbuffer and context, false with the reason printed
+bool OffscreenRenderer::createContext()
+{
+#ifdef _WIN32
+    fprintf(stderr, "offscreen rendering needs EGL, not available on Windows\n");
+    return false;
+#else
+    // the surfaceless platform needs neither a display server nor a GPU
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+        fprintf(stderr, "offscreen: no EGL display\n");
+        return false;
+    }
+    display = eglDisplay;
+
+    static const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configs) || !configs) {
+        fprintf(stderr, "offscreen: no EGL config for desktop OpenGL pbuffers\n");
+        return false;
+    }
+
+    EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    surface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+    context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, NULL);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !makeCurrent()) {
+        fprintf(stderr, "offscreen: could not create a %dx%d context (0x%x)\n",
+                width, height, eglGetError());
+        return false;
+    }
+
+    // entry points of EGL contexts come from EGL, not GLX
+    glmSetProcAddress(eglProcAddress);
+    return true;
+#endif
+}
+
+// the view of render, drawn by the rasterizer
+QImage OffscreenRenderer::renderSoftware(GLMmodel *model)
+{
+    GLfloat projection[16], modelview[16];
+    viewMatrices(model, projection, modelview);
+
+    rasterizer->begin(width, height, 0);
+    rasterizer->setProjection(projection);
+    rasterizer->setLight(LightPosition);
+    if (model)
+        rasterizer->draw(model, modelview, GLM_MATERIAL | (smooth ? GLM_SMOOTH : GLM_FLAT));
+    return rasterizer->end();
+}
+
+// the view of render, ray traced; the speed is printed as a benchmark
+QImage OffscreenRenderer::renderRayTraced(GLMmodel *model)
+{
+    GLfloat projection[16], modelview[16];
+    viewMatrices(model, projection, modelview);
+
+    RayTracer tracer;
+    tracer.begin(width, height, 0);
+    tracer.setProjection(projection);
+    tracer.setLight(LightPosition);
+    tracer.setOcclusionSamples(raySamples);
+    if (model)
+        tracer.addModel(model, modelview, GLM_MATERIAL | (smooth ? GLM_SMOOTH : GLM_FLAT));
+
+    for (int pass = 0; pass < rayPasses; pass++)
+        tracer.refine();
+    printf("%d passes, %lld rays in %.2f s, %.2f million rays per second\n",
+           tracer.passCount(), tracer.rayCount(), tracer.seconds(),
+           tracer.seconds() > 0.0 ? tracer.rayCount() / tracer.seconds() * 1e-6 : 0.0);
+    return tracer.image();
+}
+
+// the matrices render leaves to GL, built here; qreal may be double, GL
+// matrices are float
+void OffscreenRenderer::viewMatrices(GLMmodel *model, GLfloat *projection, GLfloat *modelview) const
+{
+    QMatrix4x4 projectionMatrix, modelviewMatrix;
+    double aspectRatio = (double)width / (double)height;
+    if (width > height)
+        projectionMatrix.frustum(-0.5 * aspectRatio, 0.5 * aspectRatio, -0.5, 0.5, 4.0, 15.0);
+    else
+        projectionMatrix.frustum(-0.5, 0.5, -0.5 / aspectRatio, 0.5 / aspectRatio, 4.0, 15.0);
+
+    modelviewMatrix.translate(0.0, 0.0, -10.0);
+    modelviewMatrix.rotate(xRot, 1.0, 0.0, 0.0);
+    modelviewMatrix.rotate(yRot, 0.0, 1.0, 0.0);
+    modelviewMatrix.rotate(zRot, 0.0, 0.0, 1.0);
+    if (model) {
+        // glmApplyTransform
+        modelviewMatrix.rotate(model->rotation[0], 1.0, 0.0, 0.0);
+        modelviewMatrix.rotate(model->rotation[1], 0.0, 1.0, 0.0);
+        modelviewMatrix.rotate(model->rotation[2], 0.0, 0.0, 1.0);
+        modelviewMatrix.scale(model->scale);
+        modelviewMatrix.translate(model->position[0], model->position[1], model->position[2]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        projection[i] = projectionMatrix.constData()[i];
+        modelview[i] = modelviewMatrix.constData()[i];
+    }
+}
+
+/*========================================================================================*/
@@ -0,0 +1,90 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: offscreen.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <QtGui/QImage>
+
+#include "glm.h"
+
+class Rasterizer;
+
+/*======================================== CLASSES =======================================*/
+
+// Renders models the way GLWidget shows them, without a window or an X
+// display: into an EGL pbuffer, on the surfaceless Mesa platform where
+// there is one, so it also runs on machines with no GPU (llvmpipe).
+// Without EGL at all the models are drawn by the software rasterizer.
+// Ray traced previews are drawn on the CPU either way.
+class OffscreenRenderer
+{
+    public:
+        // software draws with the Rasterizer, which is also taken when
+        // no context can be created
+        OffscreenRenderer(int width, int height, bool software = false);
+        ~OffscreenRenderer();
+
+        // false if no context could be created, the reason is printed
+        bool isValid() const;
+        bool makeCurrent();
+        // true if drawing on the CPU, with no context to make current
+        bool isSoftware() const;
+
+        void setRotation(float x, float y, float z);
+        void setSmooth(bool value);
+        // casts rays in place of rasterizing, over passes refining the
+        // image with samples occlusion rays per pixel each; 0 passes
+        // turns it off
+        void setRayTracing(int passes, int samples);
+
+        QImage render(GLMmodel *model);
+
+    private:
+        bool createContext();
+        QImage renderSoftware(GLMmodel *model);
+        QImage renderRayTraced(GLMmodel *model);
+        void viewMatrices(GLMmodel *model, GLfloat *projection, GLfloat *modelview) const;
+
+        int width;
+        int height;
+        float xRot;
+        float yRot;
+        float zRot;
+        bool smooth;
+        int rayPasses;
+        int raySamples;
+
+        // EGLDisplay, EGLSurface and EGLContext
+        void *display;
+        void *surface;
+        void *context;
+
+        Rasterizer *rasterizer;
+};
+
+#endif // OFFSCREEN_H
+
+/*========================================================================================*/
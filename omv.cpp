@@ -27,20 +27,138 @@
 
 #include <QtCore/QFileInfo>
 
+#include <stdio.h>
+#include <string.h>
+
 #ifdef Q_OS_WIN
 #include <windows.h>
 #endif
 
 #include "window.h"
+#include "glwidget.h"
+#include "offscreen.h"
+#include "thumbnails.h"
 
 /*======================================== GLOBAL ========================================*/
 
+// viewer --render model.obj image.png [--size WxH] [--rotate X,Y,Z] [--smooth] [--software]
+//                 [--raytrace PASSES] [--occlusion SAMPLES]
+static int render(QStringList arguments)
+{
+    int width = 512, height = 512;
+    float xRot = 0, yRot = 0, zRot = 0;
+    bool smooth = false;
+    bool software = false;
+    int rayPasses = 0, raySamples = 0;
+
+    if (arguments.size() < 2) {
+        fprintf(stderr, "usage: --render model.obj image.png "
+                "[--size WxH] [--rotate X,Y,Z] [--smooth] [--software] "
+                "[--raytrace PASSES] [--occlusion SAMPLES]\n");
+        return 1;
+    }
+    QString model = arguments.takeFirst();
+    QString image = arguments.takeFirst();
+
+    while (!arguments.isEmpty()) {
+        QString option = arguments.takeFirst();
+        if (option == "--smooth") {
+            smooth = true;
+        } else if (option == "--software") {
+            software = true;
+        } else if (option == "--raytrace" && !arguments.isEmpty()) {
+            rayPasses = arguments.takeFirst().toInt();
+        } else if (option == "--occlusion" && !arguments.isEmpty()) {
+            raySamples = arguments.takeFirst().toInt();
+        } else if (option == "--size" && !arguments.isEmpty()) {
+            QStringList size = arguments.takeFirst().split('x');
+            width = size.value(0).toInt();
+            height = size.value(1).toInt();
+        } else if (option == "--rotate" && !arguments.isEmpty()) {
+            QStringList angles = arguments.takeFirst().split(',');
+            xRot = angles.value(0).toFloat();
+            yRot = angles.value(1).toFloat();
+            zRot = angles.value(2).toFloat();
+        } else {
+            fprintf(stderr, "unknown option %s\n", option.toUtf8().data());
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "invalid size %dx%d\n", width, height);
+        return 1;
+    }
+
+    // rays are cast on the CPU, they need no context
+    OffscreenRenderer renderer(width, height, software || rayPasses > 0);
+    if (!renderer.isValid())
+        return 1;
+    renderer.setRotation(xRot, yRot, zRot);
+    renderer.setSmooth(smooth);
+    renderer.setRayTracing(rayPasses, raySamples);
+
+    // the rest of the setup is for GL
+    GLMmodel *pmodel = renderer.isSoftware() ? GLWidget::readModel(model.toUtf8().data()) :
+                       GLWidget::loadModel(model.toUtf8().data());
+    if (!pmodel)
+        return 1;
+    bool saved = renderer.render(pmodel).save(image, "PNG");
+    glmDelete(pmodel);
+
+    if (!saved) {
+        fprintf(stderr, "could not write %s\n", image.toUtf8().data());
+        return 1;
+    }
+    return 0;
+}
+
+// viewer --thumbnails models/ thumbnails/ [--size N]
+static int thumbnails(QStringList arguments)
+{
+    int size = 256;
+
+    if (arguments.size() < 2) {
+        fprintf(stderr, "usage: --thumbnails directory output [--size N]\n");
+        return 1;
+    }
+    QString input = arguments.takeFirst();
+    QString output = arguments.takeFirst();
+
+    while (!arguments.isEmpty()) {
+        QString option = arguments.takeFirst();
+        if (option == "--size" && !arguments.isEmpty()) {
+            size = arguments.takeFirst().toInt();
+        } else {
+            fprintf(stderr, "unknown option %s\n", option.toUtf8().data());
+            return 1;
+        }
+    }
+    if (size <= 0) {
+        fprintf(stderr, "invalid size %d\n", size);
+        return 1;
+    }
+
+    return ThumbnailBatch(input, output, size).run();
+}
+
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    // headless renders must not connect to a display
+    bool headless = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--render") || !strcmp(argv[i], "--thumbnails"))
+            headless = true;
+    }
+
+    QApplication app(argc, argv, !headless);
     QStringList arguments = app.arguments();
     arguments.takeFirst();
 
+    if (arguments.contains("--thumbnails"))
+        return thumbnails(arguments.mid(arguments.indexOf("--thumbnails") + 1));
+    if (headless)
+        return render(arguments.mid(arguments.indexOf("--render") + 1));
+
     // debug step takes a priority
     #ifdef Q_OS_WIN
     foreach(QString argument, arguments) {
@@ -56,11 +174,14 @@ int main(int argc, char *argv[])
     Window *win = Window::Instance();
     win->resize(win->sizeHint());
 
+    // the models given are opened together, as one scene
+    QStringList files;
     foreach(QString argument, arguments) {
         QFileInfo file(argument);
         if (file.isFile())
-            win->openFile(file.canonicalFilePath());
+            files.append(file.canonicalFilePath());
     }
+    win->openFiles(files);
 
     int desktopArea = QApplication::desktop()->width() *
                       QApplication::desktop()->height();
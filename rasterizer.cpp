@@ -0,0 +1,569 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: rasterizer.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "rasterizer.h"
+#include "shading.h"
+
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QtAlgorithms>
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*======================================== DEFINES =======================================*/
+
+static const int TileSize       = 64;     // pixels across a tile, a multiple of 4
+static const int ChunkTriangles = 16384;  // triangles set up by one task
+
+/*======================================== GLOBAL ========================================*/
+
+// transforms, lights and bins one chunk of triangles
+class SetupTask : public QRunnable
+{
+    public:
+        SetupTask(Rasterizer *rasterizer, Rasterizer::Chunk *chunk) :
+            rasterizer(rasterizer), chunk(chunk)
+        {
+        }
+
+        void run()
+        {
+            rasterizer->setup(chunk);
+        }
+
+    private:
+        Rasterizer *rasterizer;
+        Rasterizer::Chunk *chunk;
+};
+
+// shades tiles until there are none left
+class TileTask : public QRunnable
+{
+    public:
+        TileTask(Rasterizer *rasterizer) :
+            rasterizer(rasterizer)
+        {
+        }
+
+        void run()
+        {
+            int numTiles = rasterizer->tilesX * rasterizer->tilesY;
+            int tile;
+            while ((tile = rasterizer->nextTile.fetchAndAddRelaxed(1)) < numTiles)
+                rasterizer->shadeTile(tile);
+        }
+
+    private:
+        Rasterizer *rasterizer;
+};
+
+/*======================================== PUBLIC ========================================*/
+
+Rasterizer::Rasterizer() :
+    width(0), height(0), clearColor(0), lighting(true), culling(true),
+    tilesX(0), tilesY(0), stride(0), numChunks(0), nextTile(0)
+{
+    static const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    memcpy(projection, identity, sizeof(projection));
+    lightPosition[0] = lightPosition[1] = 0.0f;
+    lightPosition[2] = 1.0f;
+}
+
+Rasterizer::~Rasterizer()
+{
+    pool.waitForDone();
+    qDeleteAll(chunks);
+}
+
+void Rasterizer::begin(int width, int height, QRgb color)
+{
+    pool.waitForDone();
+
+    this->width = qMax(width, 1);
+    this->height = qMax(height, 1);
+    clearColor = color;
+    numChunks = 0;
+
+    // the buffers cover whole tiles, so that shading never checks the edges
+    tilesX = (this->width + TileSize - 1) / TileSize;
+    tilesY = (this->height + TileSize - 1) / TileSize;
+    stride = tilesX * TileSize;
+    if (colors.size() < stride * tilesY * TileSize) {
+        colors.resize(stride * tilesY * TileSize);
+        depths.resize(stride * tilesY * TileSize);
+    }
+}
+
+void Rasterizer::setProjection(const GLfloat *matrix)
+{
+    memcpy(projection, matrix, sizeof(projection));
+}
+
+void Rasterizer::setLight(const GLfloat *position)
+{
+    memcpy(lightPosition, position, sizeof(lightPosition));
+}
+
+void Rasterizer::setLighting(bool value)
+{
+    lighting = value;
+}
+
+void Rasterizer::setCulling(bool value)
+{
+    culling = value;
+}
+
+void Rasterizer::draw(GLMmodel *model, const GLfloat *modelview, GLuint mode)
+{
+    if (!model->numtriangles)
+        return;
+
+    // the chunks are set up while the next models are drawn
+    int first = numChunks;
+    GLuint copies = model->numinstances ? model->numinstances : 1;
+    for (GLuint copy = 0; copy < copies; copy++) {
+        GLfloat view[16];
+        if (model->numinstances)
+            multiply(modelview, &model->instances[16 * copy], view);
+        else
+            memcpy(view, modelview, sizeof(view));
+
+        for (GLMgroup *group = model->groups; group; group = group->next) {
+            if (!glmGroupVisible(model, group))
+                continue;
+            // instanced groups draw the triangles of their prototype
+            GLMgroup *geometry = group->prototype ? group->prototype : group;
+            for (GLuint begin = 0; begin < geometry->numtriangles; begin += ChunkTriangles) {
+                Chunk *chunk = addChunk();
+                chunk->model = model;
+                chunk->group = group;
+                chunk->begin = begin;
+                chunk->end = qMin(begin + ChunkTriangles, geometry->numtriangles);
+                chunk->mode = mode;
+                if (group->prototype)
+                    multiply(view, group->transform, chunk->modelview);
+                else
+                    memcpy(chunk->modelview, view, sizeof(view));
+            }
+        }
+    }
+
+    for (int i = first; i < numChunks; i++)
+        pool.start(new SetupTask(this, chunks[i]));
+}
+
+QImage Rasterizer::end()
+{
+    pool.waitForDone();
+
+    // the tiles go to the threads as they ask for them
+    nextTile = 0;
+    int tasks = qMin(QThread::idealThreadCount(), tilesX * tilesY);
+    for (int i = 0; i < tasks; i++)
+        pool.start(new TileTask(this));
+    pool.waitForDone();
+
+    QImage image(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; y++)
+        memcpy(image.scanLine(height - 1 - y), &colors[y * stride], sizeof(quint32) * width);
+    return image;
+}
+
+int Rasterizer::triangleCount() const
+{
+    int count = 0;
+    for (int i = 0; i < numChunks; i++)
+        count += chunks[i]->numTriangles;
+    return count;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+Rasterizer::Chunk *Rasterizer::addChunk()
+{
+    if (numChunks == chunks.size()) {
+        Chunk *chunk = new Chunk;
+        chunk->numTriangles = 0;
+        chunks.append(chunk);
+    }
+    return chunks[numChunks++];
+}
+
+void Rasterizer::setup(Chunk *chunk)
+{
+    GLMmodel *model = chunk->model;
+    GLMgroup *geometry = chunk->group->prototype ? chunk->group->prototype : chunk->group;
+    const GLMmaterial *material = model->materials ? &model->materials[chunk->group->material] : NULL;
+    bool smooth = (chunk->mode & GLM_SMOOTH) && model->normals;
+
+    chunk->numTriangles = 0;
+    for (GLuint i = chunk->begin; i < chunk->end; i++) {
+        const GLMtriangle &triangle = model->triangles[geometry->triangles[i]];
+        Vertex vertices[3];
+        float eye[3][4], normal[3][3];
+        int outside[6] = { 0, 0, 0, 0, 0, 0 };
+
+        for (int j = 0; j < 3; j++) {
+            transform(chunk->modelview, &model->vertices[3 * triangle.vindices[j]], 1.0f, eye[j]);
+            transform(projection, eye[j], eye[j][3], vertices[j].position);
+            const float *p = vertices[j].position;
+            for (int k = 0; k < 3; k++) {
+                outside[2 * k] += p[k] < -p[3];
+                outside[2 * k + 1] += p[k] > p[3];
+            }
+        }
+
+        // triangles wholly out of the view, or facing away, are dropped
+        // before they are lit
+        bool rejected = false;
+        for (int k = 0; k < 6; k++)
+            rejected = rejected || outside[k] == 3;
+        if (rejected)
+            continue;
+        if (culling && vertices[0].position[3] > 0.0f && vertices[1].position[3] > 0.0f &&
+            vertices[2].position[3] > 0.0f) {
+            float x[3], y[3];
+            for (int j = 0; j < 3; j++) {
+                x[j] = vertices[j].position[0] / vertices[j].position[3];
+                y[j] = vertices[j].position[1] / vertices[j].position[3];
+            }
+            if ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]) <= 0.0f)
+                continue;
+        }
+
+        // normals scale uniformly with the modelview, like glmSelectLODs assumes
+        if (smooth) {
+            for (int j = 0; j < 3; j++) {
+                float n[4];
+                transform(chunk->modelview, &model->normals[3 * triangle.nindices[j]], 0.0f, n);
+                memcpy(normal[j], n, sizeof(normal[j]));
+                normalize(normal[j]);
+            }
+        } else {
+            float u[3], v[3];
+            for (int k = 0; k < 3; k++) {
+                u[k] = eye[1][k] - eye[0][k];
+                v[k] = eye[2][k] - eye[0][k];
+            }
+            normal[0][0] = u[1] * v[2] - u[2] * v[1];
+            normal[0][1] = u[2] * v[0] - u[0] * v[2];
+            normal[0][2] = u[0] * v[1] - u[1] * v[0];
+            normalize(normal[0]);
+            memcpy(normal[1], normal[0], sizeof(normal[0]));
+            memcpy(normal[2], normal[0], sizeof(normal[0]));
+        }
+        for (int j = 0; j < 3; j++)
+            light(chunk, material, eye[j], normal[j], vertices[j].color);
+
+        clip(chunk, vertices);
+    }
+
+    bin(chunk);
+}
+
+// the color of a vertex as GL_LIGHT0 (white) and the default scene
+// ambient light of the fixed function pipeline give it, local viewer off
+void Rasterizer::light(Chunk *chunk, const GLMmaterial *material, const float *eye,
+                       const float *normal, float *color) const
+{
+    MaterialColors colors = materialColors(material, chunk->mode);
+    if (!lighting) {
+        memcpy(color, colors.diffuse, sizeof(float) * 3);
+        return;
+    }
+
+    float toLight[3];
+    for (int k = 0; k < 3; k++)
+        toLight[k] = lightPosition[k] - eye[k];
+    normalize(toLight);
+    lightColor(colors, normal, toLight, 1.0f, 1.0f, color);
+}
+
+// clips a triangle against the near and far planes, the rest of the
+// view is left to the bounds of the triangles
+void Rasterizer::clip(Chunk *chunk, Vertex *vertices)
+{
+    bool inside = true;
+    for (int j = 0; j < 3; j++) {
+        const float *p = vertices[j].position;
+        inside = inside && p[2] >= -p[3] && p[2] <= p[3];
+    }
+    if (inside) {
+        addTriangle(chunk, &vertices[0], &vertices[1], &vertices[2]);
+        return;
+    }
+
+    // each plane cuts a corner off the polygon at most
+    Vertex polygons[2][5];
+    int count = 3;
+    memcpy(polygons[0], vertices, sizeof(Vertex) * 3);
+    for (int plane = 0; plane < 2; plane++) {
+        Vertex *in = polygons[plane], *out = polygons[1 - plane];
+        float sign = plane ? -1.0f : 1.0f;
+        int numOut = 0;
+        for (int j = 0; j < count; j++) {
+            const Vertex &a = in[j], &b = in[(j + 1) % count];
+            float da = a.position[3] + sign * a.position[2];
+            float db = b.position[3] + sign * b.position[2];
+            if (da >= 0.0f)
+                out[numOut++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                // from the inside end, so that the triangles on either
+                // side of the edge get the same vertex
+                const Vertex &from = da >= 0.0f ? a : b, &to = da >= 0.0f ? b : a;
+                float t = da >= 0.0f ? da / (da - db) : db / (db - da);
+                Vertex &v = out[numOut++];
+                for (int k = 0; k < 4; k++)
+                    v.position[k] = from.position[k] + t * (to.position[k] - from.position[k]);
+                for (int k = 0; k < 3; k++)
+                    v.color[k] = from.color[k] + t * (to.color[k] - from.color[k]);
+            }
+        }
+        count = numOut;
+        // the second pass reads what the first wrote
+        if (plane == 0)
+            memcpy(polygons[0], polygons[1], sizeof(Vertex) * count);
+    }
+
+    for (int j = 1; j + 1 < count; j++)
+        addTriangle(chunk, &polygons[0][0], &polygons[0][j], &polygons[0][j + 1]);
+}
+
+// projects a triangle to the pixels and sets up its planes
+void Rasterizer::addTriangle(Chunk *chunk, const Vertex *a, const Vertex *b, const Vertex *c)
+{
+    const Vertex *vertices[3] = { a, b, c };
+    float x[3], y[3];
+    for (int j = 0; j < 3; j++) {
+        const float *p = vertices[j]->position;
+        if (p[3] <= 0.0f)
+            return;
+        x[j] = (p[0] / p[3] * 0.5f + 0.5f) * width;
+        y[j] = (p[1] / p[3] * 0.5f + 0.5f) * height;
+    }
+
+    // counter-clockwise is front facing, as in GL
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f || (culling && area < 0.0f))
+        return;
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.0f) {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    // the pixels whose centers it may cover
+    float minX = qMin(x[0], qMin(x[1], x[2])), maxX = qMax(x[0], qMax(x[1], x[2]));
+    float minY = qMin(y[0], qMin(y[1], y[2])), maxY = qMax(y[0], qMax(y[1], y[2]));
+    int x0 = (int)ceil(qMax(minX - 0.5f, 0.0f)), x1 = (int)floor(qMin(maxX - 0.5f, width - 1.0f));
+    int y0 = (int)ceil(qMax(minY - 0.5f, 0.0f)), y1 = (int)floor(qMin(maxY - 0.5f, height - 1.0f));
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    if (chunk->numTriangles == chunk->triangles.size())
+        chunk->triangles.resize(qMax(2 * chunk->triangles.size(), 1024));
+    Triangle &triangle = chunk->triangles[chunk->numTriangles++];
+
+    // edge e is opposite corner e, and over the area it is the weight
+    // of that corner.  Both triangles on an edge measure it from the same
+    // end, so their values are exactly opposite and the top-left rule
+    // decides between them
+    for (int e = 0; e < 3; e++) {
+        int from = order[(e + 1) % 3], to = order[(e + 2) % 3];
+        int origin = (y[from] < y[to] || (y[from] == y[to] && x[from] < x[to])) ? from : to;
+        float *edge = triangle.edge[e];
+        edge[0] = y[from] - y[to];
+        edge[1] = x[to] - x[from];
+        edge[2] = x[origin];
+        edge[3] = y[origin];
+        triangle.topLeft[e] = (edge[0] > 0.0f || (edge[0] == 0.0f && edge[1] < 0.0f)) ? -1 : 0;
+    }
+
+    // the depth and color planes, through the first corner
+    float values[4][3];
+    for (int e = 0; e < 3; e++) {
+        const Vertex *v = vertices[order[e]];
+        values[0][e] = (v->position[2] / v->position[3]) * 0.5f + 0.5f;
+        for (int k = 0; k < 3; k++)
+            values[k + 1][e] = v->color[k];
+    }
+    float *planes[4] = { triangle.depth, triangle.color[0], triangle.color[1], triangle.color[2] };
+    for (int i = 0; i < 4; i++) {
+        float *plane = planes[i];
+        plane[0] = (triangle.edge[0][0] * values[i][0] + triangle.edge[1][0] * values[i][1] +
+                    triangle.edge[2][0] * values[i][2]) / area;
+        plane[1] = (triangle.edge[0][1] * values[i][0] + triangle.edge[1][1] * values[i][1] +
+                    triangle.edge[2][1] * values[i][2]) / area;
+        plane[2] = values[i][0] - plane[0] * x[order[0]] - plane[1] * y[order[0]];
+    }
+    triangle.bounds[0] = x0;
+    triangle.bounds[1] = y0;
+    triangle.bounds[2] = x1;
+    triangle.bounds[3] = y1;
+}
+
+// lists the triangles of a chunk by the tiles they touch
+void Rasterizer::bin(Chunk *chunk)
+{
+    int numTiles = tilesX * tilesY;
+    chunk->tileStart.fill(0, numTiles + 1);
+    int *start = chunk->tileStart.data();
+
+    for (int i = 0; i < chunk->numTriangles; i++) {
+        const short *bounds = chunk->triangles[i].bounds;
+        for (int ty = bounds[1] / TileSize; ty <= bounds[3] / TileSize; ty++)
+            for (int tx = bounds[0] / TileSize; tx <= bounds[2] / TileSize; tx++)
+                start[ty * tilesX + tx + 1]++;
+    }
+    for (int tile = 0; tile < numTiles; tile++)
+        start[tile + 1] += start[tile];
+
+    if (chunk->tileTriangles.size() < start[numTiles])
+        chunk->tileTriangles.resize(start[numTiles]);
+    QVector<int> next(chunk->tileStart);
+    for (int i = 0; i < chunk->numTriangles; i++) {
+        const short *bounds = chunk->triangles[i].bounds;
+        for (int ty = bounds[1] / TileSize; ty <= bounds[3] / TileSize; ty++)
+            for (int tx = bounds[0] / TileSize; tx <= bounds[2] / TileSize; tx++)
+                chunk->tileTriangles[next[ty * tilesX + tx]++] = i;
+    }
+}
+
+// clears a tile and shades the triangles binned into it, in the order
+// they were drawn
+void Rasterizer::shadeTile(int tile)
+{
+    int tileX = (tile % tilesX) * TileSize, tileY = (tile / tilesX) * TileSize;
+
+    for (int y = tileY; y < tileY + TileSize; y++) {
+        quint32 *colorRow = &colors[y * stride + tileX];
+        float *depthRow = &depths[y * stride + tileX];
+        for (int x = 0; x < TileSize; x++) {
+            colorRow[x] = clearColor;
+            depthRow[x] = 1.0f;
+        }
+    }
+
+    for (int c = 0; c < numChunks; c++) {
+        const Chunk *chunk = chunks[c];
+        const int *list = chunk->tileTriangles.constData();
+        for (int k = chunk->tileStart[tile]; k < chunk->tileStart[tile + 1]; k++) {
+            const Triangle &t = chunk->triangles[list[k]];
+            int x0 = qMax((int)t.bounds[0], tileX), x1 = qMin((int)t.bounds[2], tileX + TileSize - 1);
+            int y0 = qMax((int)t.bounds[1], tileY), y1 = qMin((int)t.bounds[3], tileY + TileSize - 1);
+
+            for (int y = y0; y <= y1; y++) {
+                quint32 *colorRow = &colors[y * stride];
+                float *depthRow = &depths[y * stride];
+                float py = y + 0.5f;
+
+                // the part of each plane that is the same along the row
+                float edgeRow[3], colorPlane[3];
+                for (int e = 0; e < 3; e++)
+                    edgeRow[e] = t.edge[e][1] * (py - t.edge[e][3]);
+                float depthRow0 = t.depth[1] * py + t.depth[2];
+                for (int k = 0; k < 3; k++)
+                    colorPlane[k] = t.color[k][1] * py + t.color[k][2];
+
+#ifdef __SSE2__
+                // four pixels at a time, from the group of four x0 is in
+                const __m128 zero = _mm_setzero_ps();
+                const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                const __m128i alpha = _mm_set1_epi32(0xff000000);
+                __m128 edgeA[3], edgeX[3], edgeC[3], topLeft[3], colorA[3], colorC[3];
+                for (int e = 0; e < 3; e++) {
+                    edgeA[e] = _mm_set1_ps(t.edge[e][0]);
+                    edgeX[e] = _mm_set1_ps(t.edge[e][2]);
+                    edgeC[e] = _mm_set1_ps(edgeRow[e]);
+                    topLeft[e] = _mm_castsi128_ps(_mm_set1_epi32(t.topLeft[e]));
+                }
+                for (int k = 0; k < 3; k++) {
+                    colorA[k] = _mm_set1_ps(t.color[k][0] * 255.0f);
+                    colorC[k] = _mm_set1_ps(colorPlane[k] * 255.0f + 0.5f);
+                }
+                __m128 depthA = _mm_set1_ps(t.depth[0]), depthC = _mm_set1_ps(depthRow0);
+
+                for (int x = x0 & ~3; x <= x1; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+                    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int e = 0; e < 3; e++) {
+                        __m128 value = _mm_add_ps(_mm_mul_ps(edgeA[e], _mm_sub_ps(px, edgeX[e])), edgeC[e]);
+                        mask = _mm_and_ps(mask, _mm_or_ps(_mm_cmpgt_ps(value, zero),
+                                          _mm_and_ps(_mm_cmpeq_ps(value, zero), topLeft[e])));
+                    }
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), depthC);
+                    __m128 oldDepth = _mm_loadu_ps(&depthRow[x]);
+                    mask = _mm_and_ps(mask, _mm_cmplt_ps(depth, oldDepth));
+                    if (!_mm_movemask_ps(mask))
+                        continue;
+                    _mm_storeu_ps(&depthRow[x], _mm_or_ps(_mm_and_ps(mask, depth),
+                                                           _mm_andnot_ps(mask, oldDepth)));
+
+                    __m128i pixel = alpha;
+                    for (int k = 0; k < 3; k++) {
+                        __m128 value = _mm_add_ps(_mm_mul_ps(colorA[k], px), colorC[k]);
+                        value = _mm_min_ps(_mm_max_ps(value, zero), _mm_set1_ps(255.0f));
+                        pixel = _mm_or_si128(pixel, _mm_slli_epi32(_mm_cvttps_epi32(value), 16 - 8 * k));
+                    }
+                    __m128i oldColor = _mm_loadu_si128((__m128i *)&colorRow[x]);
+                    __m128i select = _mm_castps_si128(mask);
+                    _mm_storeu_si128((__m128i *)&colorRow[x],
+                                     _mm_or_si128(_mm_and_si128(select, pixel),
+                                                  _mm_andnot_si128(select, oldColor)));
+                }
+#else
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f;
+                    bool covered = true;
+                    for (int e = 0; e < 3 && covered; e++) {
+                        float value = t.edge[e][0] * (px - t.edge[e][2]) + edgeRow[e];
+                        covered = value > 0.0f || (value == 0.0f && t.topLeft[e]);
+                    }
+                    float depth = t.depth[0] * px + depthRow0;
+                    if (!covered || !(depth < depthRow[x]))
+                        continue;
+                    depthRow[x] = depth;
+
+                    quint32 pixel = 0xff000000;
+                    for (int k = 0; k < 3; k++) {
+                        float value = (t.color[k][0] * px + colorPlane[k]) * 255.0f + 0.5f;
+                        value = value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value;
+                        pixel |= (quint32)value << (16 - 8 * k);
+                    }
+                    colorRow[x] = pixel;
+                }
+#endif
+            }
+        }
+    }
+}
+
+/*========================================================================================*/
@@ -0,0 +1,134 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: rasterizer.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+
+#include "glm.h"
+
+/*======================================== CLASSES =======================================*/
+
+// Draws models on the CPU, for machines without a usable GL.  The
+// triangles of the shown groups are transformed, lit per vertex like
+// GL_LIGHT0 of the fixed function pipeline and binned into screen tiles
+// in chunks on a pool of threads, then the tiles are shaded in parallel
+// with SSE2 edge functions against a depth buffer.  Textures and point
+// clouds are left out.  No GL context is needed.
+class Rasterizer
+{
+    public:
+        Rasterizer();
+        ~Rasterizer();
+
+        // starts a frame, cleared to color and the far depth
+        void begin(int width, int height, QRgb color);
+        // the matrices are column-major as in GL, the light is a point
+        // light in eye coordinates
+        void setProjection(const GLfloat *matrix);
+        void setLight(const GLfloat *position);
+        void setLighting(bool value);
+        void setCulling(bool value);
+        // transforms and bins the triangles of a model; mode takes
+        // GLM_FLAT or GLM_SMOOTH, and GLM_MATERIAL or GLM_COLOR
+        void draw(GLMmodel *model, const GLfloat *modelview, GLuint mode);
+        // shades the tiles, the image has the top row first
+        QImage end();
+
+        // triangles binned since begin
+        int triangleCount() const;
+
+    private:
+        friend class SetupTask;
+        friend class TileTask;
+
+        // a triangle ready to shade: the edges, a * (x - x0) + b * (y - y0)
+        // positive inside, and the depth and color as planes a * x + b * y + c
+        struct Triangle {
+            float edge[3][4];
+            int topLeft[3];
+            float depth[3];
+            float color[3][3];
+            short bounds[4];
+        };
+
+        // triangles of a group set up by one task, and the ones in each
+        // tile (tileStart[tile] to tileStart[tile + 1] in tileTriangles)
+        struct Chunk {
+            GLMmodel *model;
+            GLMgroup *group;
+            GLuint begin;
+            GLuint end;
+            GLfloat modelview[16];
+            GLuint mode;
+
+            int numTriangles;
+            QVector<Triangle> triangles;
+            QVector<int> tileStart;
+            QVector<int> tileTriangles;
+        };
+
+        struct Vertex {
+            float position[4];
+            float color[3];
+        };
+
+        Chunk *addChunk();
+        void setup(Chunk *chunk);
+        void light(Chunk *chunk, const GLMmaterial *material, const float *eye,
+                   const float *normal, float *color) const;
+        void clip(Chunk *chunk, Vertex *vertices);
+        void addTriangle(Chunk *chunk, const Vertex *a, const Vertex *b, const Vertex *c);
+        void bin(Chunk *chunk);
+        void shadeTile(int tile);
+
+        int width;
+        int height;
+        QRgb clearColor;
+        GLfloat projection[16];
+        GLfloat lightPosition[3];
+        bool lighting;
+        bool culling;
+
+        // tiles and the padded buffers they cover, rows bottom up
+        int tilesX;
+        int tilesY;
+        int stride;
+        QVector<quint32> colors;
+        QVector<float> depths;
+
+        // chunks are kept from frame to frame with their storage
+        int numChunks;
+        QVector<Chunk *> chunks;
+        QThreadPool pool;
+        QAtomicInt nextTile;
+};
+
+#endif // RASTERIZER_H
+
+/*========================================================================================*/
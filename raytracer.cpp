@@ -0,0 +1,760 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: raytracer.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "raytracer.h"
+#include "shading.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QtAlgorithms>
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+/*======================================== DEFINES =======================================*/
+
+static const int TileSize = 16;           // pixels across a tile
+static const int PreviewBlock = 4;        // pixels across a ray of the first pass
+static const int LeafTriangles = 4;       // nodes with fewer are never split
+static const int MaxLeafTriangles = 16;   // nodes with more are always split
+static const int Bins = 12;               // split candidates per axis
+static const int StackSize = 64;          // deepest leaves of a hierarchy
+static const float RayOffset = 1e-4f;     // start of secondary rays, of the scene size
+static const float OcclusionReach = 0.1f; // length of occlusion rays, of the scene size
+
+/*======================================== GLOBAL ========================================*/
+
+// casts the rays of tiles until there are none left in the pass
+class TraceTask : public QRunnable
+{
+    public:
+        TraceTask(RayTracer *tracer) :
+            tracer(tracer)
+        {
+        }
+
+        void run()
+        {
+            int numTiles = tracer->tilesX * tracer->tilesY;
+            int rays = 0;
+            int tile;
+            while ((tile = tracer->nextTile.fetchAndAddRelaxed(1)) < numTiles)
+                tracer->traceTile(tile, &rays);
+            tracer->passRays.fetchAndAddRelaxed(rays);
+        }
+
+    private:
+        RayTracer *tracer;
+};
+
+// Gauss-Jordan elimination with partial pivoting, false if m is singular
+static bool invert(const GLfloat *m, GLfloat *out)
+{
+    double a[4][8];
+    for (int row = 0; row < 4; row++)
+        for (int column = 0; column < 4; column++) {
+            a[row][column] = m[4 * column + row];
+            a[row][4 + column] = row == column ? 1.0 : 0.0;
+        }
+
+    for (int column = 0; column < 4; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < 4; row++)
+            if (fabs(a[row][column]) > fabs(a[pivot][column]))
+                pivot = row;
+        if (a[pivot][column] == 0.0)
+            return false;
+        for (int k = 0; k < 8; k++) {
+            double swap = a[column][k];
+            a[column][k] = a[pivot][k];
+            a[pivot][k] = swap;
+        }
+        double scale = 1.0 / a[column][column];
+        for (int k = 0; k < 8; k++)
+            a[column][k] *= scale;
+        for (int row = 0; row < 4; row++) {
+            if (row == column)
+                continue;
+            double factor = a[row][column];
+            for (int k = 0; k < 8; k++)
+                a[row][k] -= factor * a[column][k];
+        }
+    }
+
+    for (int row = 0; row < 4; row++)
+        for (int column = 0; column < 4; column++)
+            out[4 * column + row] = a[row][4 + column];
+    return true;
+}
+
+static float dot(const float *a, const float *b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const float *a, const float *b, float *out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// a normal of object coordinates in eye coordinates, by the transpose
+// of the inverse modelview
+static void transformNormal(const GLfloat *inverse, const float *normal, float *out)
+{
+    for (int i = 0; i < 3; i++)
+        out[i] = inverse[4 * i] * normal[0] + inverse[4 * i + 1] * normal[1] +
+                 inverse[4 * i + 2] * normal[2];
+    normalize(out);
+}
+
+static float area(const float *bounds)
+{
+    float x = bounds[3] - bounds[0], y = bounds[4] - bounds[1], z = bounds[5] - bounds[2];
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+static void emptyBounds(float *bounds)
+{
+    bounds[0] = bounds[1] = bounds[2] = FLT_MAX;
+    bounds[3] = bounds[4] = bounds[5] = -FLT_MAX;
+}
+
+static void growBounds(float *bounds, const float *other)
+{
+    for (int k = 0; k < 3; k++) {
+        bounds[k] = qMin(bounds[k], other[k]);
+        bounds[3 + k] = qMax(bounds[3 + k], other[3 + k]);
+    }
+}
+
+// a well mixed 32 bit hash, so that every pixel and pass has its own
+// random numbers whatever thread casts them
+static quint32 hash(quint32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// xorshift, in [0, 1)
+static float uniform(quint32 *state)
+{
+    quint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/*======================================== PUBLIC ========================================*/
+
+RayTracer::RayTracer() :
+    width(0), height(0), clearColor(0), shadows(true), occlusionSamples(0), sceneSize(0.0f),
+    tilesX(0), tilesY(0), passes(0), rays(0), nanoseconds(0), nextTile(0), passRays(0)
+{
+    static const GLfloat identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    memcpy(projection, identity, sizeof(projection));
+    memcpy(inverseProjection, identity, sizeof(inverseProjection));
+    lightPosition[0] = lightPosition[1] = 0.0f;
+    lightPosition[2] = 1.0f;
+}
+
+RayTracer::~RayTracer()
+{
+    pool.waitForDone();
+    qDeleteAll(meshes);
+}
+
+void RayTracer::begin(int width, int height, QRgb color)
+{
+    pool.waitForDone();
+    qDeleteAll(meshes);
+    meshes.clear();
+    objects.clear();
+    sceneSize = 0.0f;
+
+    this->width = qMax(width, 1);
+    this->height = qMax(height, 1);
+    clearColor = color;
+    tilesX = (this->width + TileSize - 1) / TileSize;
+    tilesY = (this->height + TileSize - 1) / TileSize;
+    colors.fill(0.0f, 3 * this->width * this->height);
+    passes = 0;
+    rays = 0;
+    nanoseconds = 0;
+}
+
+void RayTracer::setProjection(const GLfloat *matrix)
+{
+    memcpy(projection, matrix, sizeof(projection));
+    invert(projection, inverseProjection);
+}
+
+void RayTracer::setLight(const GLfloat *position)
+{
+    memcpy(lightPosition, position, sizeof(lightPosition));
+}
+
+void RayTracer::setShadows(bool value)
+{
+    shadows = value;
+}
+
+void RayTracer::setOcclusionSamples(int samples)
+{
+    occlusionSamples = qMax(samples, 0);
+}
+
+void RayTracer::addModel(GLMmodel *model, const GLfloat *modelview, GLuint mode)
+{
+    if (!model->numtriangles)
+        return;
+
+    Mesh *mesh = new Mesh;
+    mesh->model = model;
+    build(mesh);
+    if (mesh->triangles.isEmpty()) {
+        delete mesh;
+        return;
+    }
+    meshes.append(mesh);
+
+    // instances share the hierarchy of the model
+    GLuint copies = model->numinstances ? model->numinstances : 1;
+    for (GLuint copy = 0; copy < copies; copy++) {
+        Object object;
+        object.mesh = mesh;
+        object.mode = mode;
+        if (model->numinstances)
+            multiply(modelview, &model->instances[16 * copy], object.modelview);
+        else
+            memcpy(object.modelview, modelview, sizeof(object.modelview));
+        if (!invert(object.modelview, object.inverse))
+            continue;
+        objects.append(object);
+
+        const GLfloat *m = object.modelview;
+        float scale = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+        sceneSize = qMax(sceneSize, scale * mesh->size);
+    }
+}
+
+void RayTracer::refine()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    nextTile = 0;
+    passRays = 0;
+    int tasks = qMin(QThread::idealThreadCount(), tilesX * tilesY);
+    for (int i = 0; i < tasks; i++)
+        pool.start(new TraceTask(this));
+    pool.waitForDone();
+
+    passes++;
+    rays += (int)passRays;
+    nanoseconds += timer.nsecsElapsed();
+}
+
+QImage RayTracer::image() const
+{
+    // the first pass is shown until the second is done
+    float scale = passes > 1 ? 255.0f / (passes - 1) : 255.0f;
+    QImage image(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; y++) {
+        QRgb *row = (QRgb *)image.scanLine(height - 1 - y);
+        const float *color = &colors[3 * y * width];
+        for (int x = 0; x < width; x++, color += 3) {
+            int channels[3];
+            for (int k = 0; k < 3; k++)
+                channels[k] = qBound(0, (int)(color[k] * scale + 0.5f), 255);
+            row[x] = qRgb(channels[0], channels[1], channels[2]);
+        }
+    }
+    return image;
+}
+
+int RayTracer::passCount() const
+{
+    return passes;
+}
+
+qint64 RayTracer::rayCount() const
+{
+    return rays;
+}
+
+double RayTracer::seconds() const
+{
+    return nanoseconds * 1e-9;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+// a bounding volume hierarchy over the shown triangles of a model, with
+// instanced groups in place of their prototypes, split where the surface
+// area heuristic is least over a few bins of each axis
+void RayTracer::build(Mesh *mesh)
+{
+    GLMmodel *model = mesh->model;
+    QVector<Triangle> triangles;
+    for (GLMgroup *group = model->groups; group; group = group->next) {
+        if (!glmGroupVisible(model, group))
+            continue;
+        GLMgroup *geometry = group->prototype ? group->prototype : group;
+        for (GLuint i = 0; i < geometry->numtriangles; i++) {
+            const GLMtriangle &triangle = model->triangles[geometry->triangles[i]];
+            float corners[3][4];
+            for (int j = 0; j < 3; j++) {
+                const float *vertex = &model->vertices[3 * triangle.vindices[j]];
+                if (group->prototype)
+                    transform(group->transform, vertex, 1.0f, corners[j]);
+                else
+                    memcpy(corners[j], vertex, sizeof(float) * 3);
+            }
+            Triangle t;
+            for (int k = 0; k < 3; k++) {
+                t.corner[k] = corners[0][k];
+                t.edge1[k] = corners[1][k] - corners[0][k];
+                t.edge2[k] = corners[2][k] - corners[0][k];
+            }
+            t.index = geometry->triangles[i];
+            t.group = group;
+            triangles.append(t);
+        }
+    }
+
+    int n = triangles.size();
+    if (!n)
+        return;
+
+    QVector<float> boxes(6 * n), centers(3 * n);
+    QVector<int> order(n);
+    for (int i = 0; i < n; i++) {
+        const Triangle &t = triangles[i];
+        float *box = &boxes[6 * i];
+        for (int k = 0; k < 3; k++) {
+            float a = t.corner[k], b = a + t.edge1[k], c = a + t.edge2[k];
+            box[k] = qMin(a, qMin(b, c));
+            box[3 + k] = qMax(a, qMax(b, c));
+            centers[3 * i + k] = 0.5f * (box[k] + box[3 + k]);
+        }
+        order[i] = i;
+    }
+
+    // nodes are split depth first, the children of each are made together;
+    // no leaf is deeper than the traversal stack of intersect is long
+    struct Range {
+        int node;
+        int begin;
+        int end;
+        int depth;
+    };
+    QVector<Range> ranges;
+    Range root = { 0, 0, n, 0 };
+    ranges.append(root);
+    mesh->nodes.reserve(2 * n / LeafTriangles + 1);
+    mesh->nodes.resize(1);
+
+    while (!ranges.isEmpty()) {
+        Range range = ranges.last();
+        ranges.pop_back();
+        int count = range.end - range.begin;
+
+        float bounds[6], centerBounds[6];
+        emptyBounds(bounds);
+        emptyBounds(centerBounds);
+        for (int i = range.begin; i < range.end; i++) {
+            const float *center = &centers[3 * order[i]];
+            float point[6] = { center[0], center[1], center[2], center[0], center[1], center[2] };
+            growBounds(bounds, &boxes[6 * order[i]]);
+            growBounds(centerBounds, point);
+        }
+        Node &node = mesh->nodes[range.node];
+        memcpy(node.bounds, bounds, sizeof(bounds));
+        node.index = range.begin;
+        node.count = count;
+        if (count <= LeafTriangles || range.depth >= StackSize)
+            continue;
+
+        // the cheapest split after one of the bins of an axis
+        int bestAxis = -1, bestBin = 0;
+        float bestCost = FLT_MAX;
+        for (int axis = 0; axis < 3; axis++) {
+            float low = centerBounds[axis], extent = centerBounds[3 + axis] - low;
+            if (extent <= 0.0f)
+                continue;
+            int binCounts[Bins] = { 0 };
+            float binBounds[Bins][6];
+            for (int b = 0; b < Bins; b++)
+                emptyBounds(binBounds[b]);
+            for (int i = range.begin; i < range.end; i++) {
+                int b = qMin((int)((centers[3 * order[i] + axis] - low) / extent * Bins), Bins - 1);
+                binCounts[b]++;
+                growBounds(binBounds[b], &boxes[6 * order[i]]);
+            }
+
+            float rightAreas[Bins];
+            float side[6];
+            emptyBounds(side);
+            for (int b = Bins - 1; b > 0; b--) {
+                growBounds(side, binBounds[b]);
+                rightAreas[b] = area(side);
+            }
+            emptyBounds(side);
+            int left = 0;
+            for (int b = 0; b < Bins - 1; b++) {
+                growBounds(side, binBounds[b]);
+                left += binCounts[b];
+                if (!left || left == count)
+                    continue;
+                float cost = area(side) * left + rightAreas[b + 1] * (count - left);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        // splitting must pay for the step through the node
+        float leafCost = area(bounds) * count;
+        if (count <= MaxLeafTriangles && (bestAxis < 0 || bestCost + area(bounds) >= leafCost))
+            continue;
+
+        int middle = range.begin;
+        if (bestAxis >= 0) {
+            float low = centerBounds[bestAxis], extent = centerBounds[3 + bestAxis] - low;
+            int end = range.end;
+            while (middle < end) {
+                int b = qMin((int)((centers[3 * order[middle] + bestAxis] - low) / extent * Bins),
+                             Bins - 1);
+                if (b <= bestBin) {
+                    middle++;
+                } else {
+                    end--;
+                    qSwap(order[middle], order[end]);
+                }
+            }
+        }
+        // all centers in one place, halved in any order
+        if (middle == range.begin || middle == range.end)
+            middle = range.begin + count / 2;
+
+        int children = mesh->nodes.size();
+        mesh->nodes[range.node].index = children;
+        mesh->nodes[range.node].count = 0;
+        mesh->nodes.resize(children + 2);
+        Range right = { children + 1, middle, range.end, range.depth + 1 };
+        Range left = { children, range.begin, middle, range.depth + 1 };
+        ranges.append(right);
+        ranges.append(left);
+    }
+
+    mesh->triangles.resize(n);
+    for (int i = 0; i < n; i++)
+        mesh->triangles[i] = triangles[order[i]];
+
+    const float *bounds = mesh->nodes[0].bounds;
+    float diagonal[3] = { bounds[3] - bounds[0], bounds[4] - bounds[1], bounds[5] - bounds[2] };
+    mesh->size = sqrt(dot(diagonal, diagonal));
+}
+
+// the nearest hit of a ray in object coordinates closer than hit->t, or
+// with any hit at all; cull leaves out triangles facing away
+bool RayTracer::intersect(const Mesh *mesh, const float *origin, const float *direction,
+                          bool cull, bool any, Hit *hit) const
+{
+    const Node *nodes = mesh->nodes.constData();
+    const Triangle *triangles = mesh->triangles.constData();
+    float inverse[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    bool found = false;
+
+    // nodes to visit with the distance the ray enters them
+    struct Entry {
+        int node;
+        float t;
+    };
+    Entry stack[StackSize];
+    int top = 0;
+
+    const Node *node = &nodes[0];
+    float entered = 0.0f;
+    for (;;) {
+        if (entered < hit->t) {
+            if (node->count) {
+                for (int i = node->index; i < node->index + node->count; i++) {
+                    // Moller-Trumbore; front faces wind counter-clockwise
+                    const Triangle &triangle = triangles[i];
+                    float p[3], s[3], q[3];
+                    cross(direction, triangle.edge2, p);
+                    float determinant = dot(triangle.edge1, p);
+                    if (cull ? determinant <= 0.0f : determinant == 0.0f)
+                        continue;
+                    float reciprocal = 1.0f / determinant;
+                    for (int k = 0; k < 3; k++)
+                        s[k] = origin[k] - triangle.corner[k];
+                    float u = dot(s, p) * reciprocal;
+                    if (u < 0.0f || u > 1.0f)
+                        continue;
+                    cross(s, triangle.edge1, q);
+                    float v = dot(direction, q) * reciprocal;
+                    if (v < 0.0f || u + v > 1.0f)
+                        continue;
+                    float t = dot(triangle.edge2, q) * reciprocal;
+                    if (t <= 0.0f || t >= hit->t)
+                        continue;
+                    hit->t = t;
+                    hit->u = u;
+                    hit->v = v;
+                    hit->triangle = &triangle;
+                    found = true;
+                    if (any)
+                        return true;
+                }
+            } else {
+                // the nearer child first, the other for later
+                float entry[2];
+                bool crossed[2];
+                for (int c = 0; c < 2; c++) {
+                    const float *bounds = nodes[node->index + c].bounds;
+                    float t0 = 0.0f, t1 = hit->t;
+                    for (int k = 0; k < 3; k++) {
+                        float a = (bounds[k] - origin[k]) * inverse[k];
+                        float b = (bounds[3 + k] - origin[k]) * inverse[k];
+                        t0 = qMax(t0, qMin(a, b));
+                        t1 = qMin(t1, qMax(a, b));
+                    }
+                    entry[c] = t0;
+                    crossed[c] = t0 <= t1;
+                }
+                if (crossed[0] && crossed[1]) {
+                    // fits, as build keeps the leaves within StackSize
+                    int first = entry[1] < entry[0];
+                    stack[top].node = node->index + 1 - first;
+                    stack[top].t = entry[1 - first];
+                    top++;
+                    node = &nodes[node->index + first];
+                    entered = entry[first];
+                    continue;
+                }
+                if (crossed[0] || crossed[1]) {
+                    int c = crossed[1];
+                    entered = entry[c];
+                    node = &nodes[node->index + c];
+                    continue;
+                }
+            }
+        }
+        if (!top)
+            break;
+        top--;
+        node = &nodes[stack[top].node];
+        entered = stack[top].t;
+    }
+    return found;
+}
+
+// the nearest front face along a ray in eye coordinates, up to its end
+bool RayTracer::trace(const float *origin, const float *direction, Hit *hit) const
+{
+    bool found = false;
+    hit->t = 1.0f;
+    for (int i = 0; i < objects.size(); i++) {
+        const Object &object = objects[i];
+        float o[4], d[4];
+        transform(object.inverse, origin, 1.0f, o);
+        transform(object.inverse, direction, 0.0f, d);
+        if (intersect(object.mesh, o, d, true, false, hit)) {
+            hit->object = &object;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// whether anything lies on a ray in eye coordinates before its end
+bool RayTracer::occluded(const float *origin, const float *direction) const
+{
+    for (int i = 0; i < objects.size(); i++) {
+        const Object &object = objects[i];
+        float o[4], d[4];
+        Hit hit;
+        hit.t = 1.0f;
+        transform(object.inverse, origin, 1.0f, o);
+        transform(object.inverse, direction, 0.0f, d);
+        if (intersect(object.mesh, o, d, false, true, &hit))
+            return true;
+    }
+    return false;
+}
+
+// the ray through a point of the image, from the near plane to the far
+// one in eye coordinates
+void RayTracer::eyeRay(float x, float y, float *origin, float *direction) const
+{
+    float point[3] = { 2.0f * x / width - 1.0f, 2.0f * y / height - 1.0f, -1.0f };
+    float nearPoint[4], farPoint[4];
+    transform(inverseProjection, point, 1.0f, nearPoint);
+    point[2] = 1.0f;
+    transform(inverseProjection, point, 1.0f, farPoint);
+    for (int k = 0; k < 3; k++) {
+        origin[k] = nearPoint[k] / nearPoint[3];
+        direction[k] = farPoint[k] / farPoint[3] - origin[k];
+    }
+}
+
+// the color of a hit as GL_LIGHT0 (white) and the default scene ambient
+// light give it, like Rasterizer, with the light blocked by shadows and
+// the ambient and diffuse terms by occlusion
+void RayTracer::shade(const Hit &hit, const float *origin, const float *direction,
+                      quint32 *seed, float *color, int *rays) const
+{
+    const Object &object = *hit.object;
+    GLMmodel *model = object.mesh->model;
+    const Triangle &triangle = *hit.triangle;
+    const GLMmaterial *material = model->materials ? &model->materials[triangle.group->material] : NULL;
+    MaterialColors colors = materialColors(material, object.mode);
+
+    // the point and its normals in eye coordinates
+    float point[3], faceNormal[3], normal[3], objectNormal[3];
+    for (int k = 0; k < 3; k++)
+        point[k] = origin[k] + hit.t * direction[k];
+    cross(triangle.edge1, triangle.edge2, objectNormal);
+    transformNormal(object.inverse, objectNormal, faceNormal);
+    if (object.mode & GLM_SMOOTH && model->normals) {
+        const GLMtriangle &source = model->triangles[triangle.index];
+        float weights[3] = { 1.0f - hit.u - hit.v, hit.u, hit.v };
+        objectNormal[0] = objectNormal[1] = objectNormal[2] = 0.0f;
+        for (int j = 0; j < 3; j++) {
+            float n[4];
+            const float *vertexNormal = &model->normals[3 * source.nindices[j]];
+            if (triangle.group->prototype)
+                transform(triangle.group->transform, vertexNormal, 0.0f, n);
+            else
+                memcpy(n, vertexNormal, sizeof(float) * 3);
+            for (int k = 0; k < 3; k++)
+                objectNormal[k] += weights[j] * n[k];
+        }
+        transformNormal(object.inverse, objectNormal, normal);
+    } else {
+        memcpy(normal, faceNormal, sizeof(normal));
+    }
+
+    // secondary rays start off the surface, on the side of the eye
+    float start[3];
+    for (int k = 0; k < 3; k++)
+        start[k] = point[k] + faceNormal[k] * RayOffset * sceneSize;
+
+    float toLight[3];
+    for (int k = 0; k < 3; k++)
+        toLight[k] = lightPosition[k] - start[k];
+    float visible = 1.0f;
+    if (shadows && dot(faceNormal, toLight) > 0.0f) {
+        (*rays)++;
+        if (occluded(start, toLight))
+            visible = 0.0f;
+    }
+    normalize(toLight);
+
+    // cosine weighted directions about the normal
+    float occlusion = 1.0f;
+    if (occlusionSamples) {
+        float tangent[3], bitangent[3];
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        axis[fabs(normal[0]) < 0.5f ? 0 : 1] = 1.0f;
+        cross(normal, axis, tangent);
+        normalize(tangent);
+        cross(normal, tangent, bitangent);
+        int blocked = 0;
+        for (int i = 0; i < occlusionSamples; i++) {
+            float radius = sqrt(uniform(seed)), angle = 6.2831853f * uniform(seed);
+            float a = radius * cos(angle), b = radius * sin(angle), c = sqrt(1.0f - radius * radius);
+            float ray[3];
+            for (int k = 0; k < 3; k++)
+                ray[k] = (a * tangent[k] + b * bitangent[k] + c * normal[k]) * OcclusionReach * sceneSize;
+            (*rays)++;
+            blocked += occluded(start, ray);
+        }
+        occlusion = 1.0f - (float)blocked / occlusionSamples;
+    }
+
+    lightColor(colors, normal, toLight, visible, occlusion, color);
+    for (int k = 0; k < 3; k++)
+        color[k] = qMin(color[k], 1.0f);
+}
+
+// casts the rays of a tile for the current pass
+void RayTracer::traceTile(int tile, int *rays)
+{
+    int tileX = (tile % tilesX) * TileSize, tileY = (tile / tilesX) * TileSize;
+    int endX = qMin(tileX + TileSize, width), endY = qMin(tileY + TileSize, height);
+    float background[3] = { qRed(clearColor) / 255.0f, qGreen(clearColor) / 255.0f,
+                            qBlue(clearColor) / 255.0f };
+    int step = passes ? 1 : PreviewBlock;
+
+    for (int y = tileY; y < endY; y += step) {
+        for (int x = tileX; x < endX; x += step) {
+            quint32 seed = hash(hash(y * width + x) ^ hash(passes)) | 1;
+
+            // the second pass through the centers, later ones anywhere in
+            // the pixel, which smooths the edges
+            float jitterX = 0.5f, jitterY = 0.5f;
+            if (passes > 1) {
+                jitterX = uniform(&seed);
+                jitterY = uniform(&seed);
+            }
+
+            float origin[3], direction[3], color[3];
+            Hit hit;
+            eyeRay(x + jitterX, y + jitterY, origin, direction);
+            (*rays)++;
+            if (trace(origin, direction, &hit))
+                shade(hit, origin, direction, &seed, color, rays);
+            else
+                memcpy(color, background, sizeof(color));
+
+            if (passes > 1) {
+                float *sum = &colors[3 * (y * width + x)];
+                for (int k = 0; k < 3; k++)
+                    sum[k] += color[k];
+                continue;
+            }
+            // the first two passes replace what was there
+            for (int by = y; by < qMin(y + step, endY); by++)
+                for (int bx = x; bx < qMin(x + step, endX); bx++)
+                    memcpy(&colors[3 * (by * width + bx)], color, sizeof(color));
+        }
+    }
+}
+
+/*========================================================================================*/
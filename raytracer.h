@@ -0,0 +1,160 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: raytracer.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+
+#include "glm.h"
+
+/*======================================== CLASSES =======================================*/
+
+// Renders models by casting rays on the CPU, for previews on machines
+// without a GPU.  Each model gets a bounding volume hierarchy over its
+// shown triangles, split by the surface area heuristic.  Rays from the
+// eye are shaded like GL_LIGHT0 of the fixed function pipeline, with
+// hard shadows and, if asked for, ambient occlusion.  Every pass refines
+// the image: the first casts a ray per block of pixels, the next one per
+// pixel, and the later ones jittered rays with new occlusion samples
+// that are averaged in.  The tiles of a pass go to the threads of a pool
+// as they ask for them.
+class RayTracer
+{
+    public:
+        RayTracer();
+        ~RayTracer();
+
+        // starts a new image, cleared to color, with no models
+        void begin(int width, int height, QRgb color);
+        // as for Rasterizer: column-major matrices, a point light in eye
+        // coordinates
+        void setProjection(const GLfloat *matrix);
+        void setLight(const GLfloat *position);
+        void setShadows(bool value);
+        // occlusion rays per pixel and pass, none by default
+        void setOcclusionSamples(int samples);
+        // builds the hierarchy of a model; mode takes GLM_FLAT or
+        // GLM_SMOOTH, and GLM_MATERIAL or GLM_COLOR
+        void addModel(GLMmodel *model, const GLfloat *modelview, GLuint mode);
+
+        // casts the rays of one more pass on all threads
+        void refine();
+        // the image so far, top row first
+        QImage image() const;
+
+        // passes, rays and seconds spent casting them since begin
+        int passCount() const;
+        qint64 rayCount() const;
+        double seconds() const;
+
+    private:
+        friend class TraceTask;
+
+        // a triangle as a corner and the two edges from it, with the
+        // one of the model and the group it is drawn with
+        struct Triangle {
+            float corner[3];
+            float edge1[3];
+            float edge2[3];
+            GLuint index;
+            GLMgroup *group;
+        };
+
+        // the children of an inner node are index and index + 1, a leaf
+        // has count triangles from index
+        struct Node {
+            float bounds[6];
+            int index;
+            int count;
+        };
+
+        struct Mesh {
+            GLMmodel *model;
+            float size;
+            QVector<Triangle> triangles;
+            QVector<Node> nodes;
+        };
+
+        // a mesh where the modelview puts it, one for each instance
+        struct Object {
+            Mesh *mesh;
+            GLfloat modelview[16];
+            GLfloat inverse[16];
+            GLuint mode;
+        };
+
+        struct Hit {
+            float t;
+            float u;
+            float v;
+            const Object *object;
+            const Triangle *triangle;
+        };
+
+        void build(Mesh *mesh);
+        bool intersect(const Mesh *mesh, const float *origin, const float *direction,
+                       bool cull, bool any, Hit *hit) const;
+        bool trace(const float *origin, const float *direction, Hit *hit) const;
+        bool occluded(const float *origin, const float *direction) const;
+        void eyeRay(float x, float y, float *origin, float *direction) const;
+        void shade(const Hit &hit, const float *origin, const float *direction,
+                   quint32 *seed, float *color, int *rays) const;
+        void traceTile(int tile, int *rays);
+
+        int width;
+        int height;
+        QRgb clearColor;
+        GLfloat projection[16];
+        GLfloat inverseProjection[16];
+        GLfloat lightPosition[3];
+        bool shadows;
+        int occlusionSamples;
+
+        // the scene, and its size in eye coordinates, which sets the
+        // offset of secondary rays and the reach of occlusion
+        QVector<Mesh *> meshes;
+        QVector<Object> objects;
+        float sceneSize;
+
+        // sums of the passes after the first, 3 floats per pixel, rows
+        // bottom up
+        QVector<float> colors;
+        int tilesX;
+        int tilesY;
+        int passes;
+        qint64 rays;
+        qint64 nanoseconds;
+
+        QThreadPool pool;
+        QAtomicInt nextTile;
+        QAtomicInt passRays;
+};
+
+#endif // RAYTRACER_H
+
+/*========================================================================================*/
@@ -0,0 +1,224 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: scene.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "scene.h"
+#include "modelreader.h"
+#include "glwidget.h"
+#include "glmext.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QVector>
+
+#include <math.h>
+#include <stdio.h>
+
+/*======================================== GLOBAL ========================================*/
+
+// rotates v about one axis (0 x, 1 y, 2 z)
+static void rotateAxis(GLfloat *v, int axis, GLfloat degrees)
+{
+    GLfloat angle = degrees * M_PI / 180.0;
+    GLfloat c = cos(angle), s = sin(angle);
+    int i = (axis + 1) % 3, j = (axis + 2) % 3;
+    GLfloat a = v[i], b = v[j];
+    v[i] = c * a - s * b;
+    v[j] = s * a + c * b;
+}
+
+// the rotation of glmApplyTransform, or its inverse
+static void rotateVector(const GLMmodel *model, GLfloat *v, bool inverse)
+{
+    if (inverse) {
+        for (int axis = 0; axis < 3; axis++)
+            rotateAxis(v, axis, -model->rotation[axis]);
+    } else {
+        for (int axis = 2; axis >= 0; axis--)
+            rotateAxis(v, axis, model->rotation[axis]);
+    }
+}
+
+/*======================================== PUBLIC ========================================*/
+
+Scene::Scene() :
+    textures(glmNewTextureCache()), scale(1.0)
+{
+    position[0] = position[1] = position[2] = 0.0;
+}
+
+Scene::~Scene()
+{
+    clear();
+    glmDeleteTextureCache(textures);
+}
+
+int Scene::load(const QStringList &files)
+{
+    QStringList readable;
+    foreach (QString file, files) {
+        if (QFileInfo(file).isReadable())
+            readable.append(file);
+        else
+            fprintf(stderr, "can't open \"%s\"\n", file.toUtf8().data());
+    }
+
+    // the models are set up here as they come, while the pool reads
+    // the next ones, and added in the order of the files
+    ModelReader reader(readable);
+    QVector<GLMmodel *> loaded(readable.size());
+    GLMmodel *model;
+    int index;
+    while (reader.take(&model, &index)) {
+        // the reason is already on stderr
+        if (!model)
+            continue;
+        GLWidget::setupModel(model, textures);
+        // coarser levels are only drawn from buffer objects
+        if (glmExtensions() & GLM_EXT_BUFFERS)
+            glmBuildLODs(model, 4);
+        model->position[0] = model->position[1] = model->position[2] = 0.0;
+        model->scale = 1.0;
+        loaded[index] = model;
+    }
+    int added = 0;
+    for (int i = 0; i < readable.size(); i++) {
+        if (!loaded[i])
+            continue;
+        models.append(loaded[i]);
+        this->files.append(readable[i]);
+        added++;
+    }
+
+    unitize();
+    printf("%d models in the scene, %u textures\n", models.size(), textures->numtextures);
+    return added;
+}
+
+void Scene::clear()
+{
+    foreach (GLMmodel *model, models)
+        glmDelete(model);
+    models.clear();
+    files.clear();
+}
+
+int Scene::count() const
+{
+    return models.size();
+}
+
+GLMmodel *Scene::model(int index) const
+{
+    return models.value(index);
+}
+
+QString Scene::fileName(int index) const
+{
+    return files.value(index);
+}
+
+void Scene::bounds(GLfloat *bounds) const
+{
+    bounds[0] = bounds[1] = bounds[2] = 0.0;
+    bounds[3] = bounds[4] = bounds[5] = 0.0;
+
+    bool first = true;
+    foreach (GLMmodel *model, models) {
+        if (!model->numvertices && !model->pointcloud)
+            continue;
+        GLfloat box[6];
+        glmBounds(model, box);
+
+        // the corners of the box of each model, as glmApplyTransform places them
+        for (int corner = 0; corner < 8; corner++) {
+            GLfloat v[3];
+            for (int i = 0; i < 3; i++) {
+                v[i] = box[(corner >> i & 1) ? i + 3 : i];
+                v[i] = (v[i] + model->position[i]) * model->scale;
+            }
+            rotateVector(model, v, false);
+            for (int i = 0; i < 3; i++) {
+                if (first || v[i] < bounds[i])
+                    bounds[i] = v[i];
+                if (first || v[i] > bounds[i + 3])
+                    bounds[i + 3] = v[i];
+            }
+            first = false;
+        }
+    }
+}
+
+void Scene::unitize()
+{
+    GLfloat box[6];
+    bounds(box);
+
+    GLfloat size = 0.0;
+    for (int i = 0; i < 3; i++) {
+        position[i] = -(box[i + 3] + box[i]) / 2.0;
+        size = qMax(size, box[i + 3] - box[i]);
+    }
+    scale = size > 0.0 ? 2.0 / size : 1.0;
+}
+
+void Scene::applyTransform() const
+{
+    glScalef(scale, scale, scale);
+    glTranslatef(position[0], position[1], position[2]);
+}
+
+void Scene::setInstanceGrid(int rows, int columns)
+{
+    foreach (GLMmodel *model, models)
+        glmClearInstances(model);
+    unitize();
+
+    if (rows * columns <= 1)
+        return;
+
+    // copies side by side, with a gap of a fifth of the scene
+    GLfloat box[6];
+    bounds(box);
+    GLfloat size = qMax(box[3] - box[0], box[4] - box[1]);
+    GLfloat spacing = 1.2 * size;
+
+    foreach (GLMmodel *model, models) {
+        GLfloat transform[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < columns; column++) {
+                // the offsets are in scene units, instances in those of the model
+                GLfloat offset[3] = { (GLfloat)((column - (columns - 1) / 2.0) * spacing),
+                                      (GLfloat)(((rows - 1) / 2.0 - row) * spacing), 0.0 };
+                rotateVector(model, offset, true);
+                for (int i = 0; i < 3; i++)
+                    transform[12 + i] = offset[i] / model->scale;
+                glmAddInstance(model, transform);
+            }
+        }
+    }
+
+    // shrink the grid to the size of a single scene
+    scale *= size / (spacing * (qMax(rows, columns) - 1) + size);
+}
+
+/*========================================================================================*/
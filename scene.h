@@ -0,0 +1,80 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: scene.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+
+#include "glm.h"
+
+/*======================================== CLASSES =======================================*/
+
+// Models drawn together, each placed by its own transform (the
+// position, rotation and scale of its GLMmodel) inside a transform of
+// the whole scene that fits it in view.  Textures used by several
+// models are loaded once.  The context the models belong to must be
+// current for anything but the accessors.
+class Scene
+{
+    public:
+        Scene();
+        ~Scene();
+
+        // reads the files on a pool of threads and adds their models,
+        // which keep the coordinates of their files so that parts fit
+        // together; returns the number of models added
+        int load(const QStringList &files);
+        void clear();
+
+        int count() const;
+        GLMmodel *model(int index) const;
+        QString fileName(int index) const;
+
+        // bounds of the models (min xyz, max xyz) in scene coordinates
+        void bounds(GLfloat *bounds) const;
+        // fits the scene in the cube from -1 to 1
+        void unitize();
+        void applyTransform() const;
+
+        // copies of the scene side by side in the xy plane, all of
+        // them fitted in view
+        void setInstanceGrid(int rows, int columns);
+
+    private:
+        Scene(const Scene &);
+        Scene &operator=(const Scene &);
+
+        QList<GLMmodel *> models;
+        QStringList files;
+        GLMtexturecache *textures;
+
+        GLfloat position[3];
+        GLfloat scale;
+};
+
+#endif // SCENE_H
+
+/*========================================================================================*/
@@ -0,0 +1,125 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: shading.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef SHADING_H
+#define SHADING_H
+
+#include <math.h>
+
+#include "glm.h"
+
+/*======================================== DEFINES =======================================*/
+
+// GL_LIGHT0 of the viewer, set with an identity modelview so in eye
+// coordinates; the software renderers are given the same
+static const GLfloat LightPosition[4] = { 0.5, 5.0, 7.0, 1.0 };
+
+/*======================================== GLOBAL ========================================*/
+
+// The matrix helpers and the GL_LIGHT0 shading shared by Rasterizer and
+// RayTracer, so that both match what glmDraw gets from the fixed function
+// pipeline.
+
+// out = m * (v, w), m column-major
+static inline void transform(const GLfloat *m, const float *v, float w, float *out)
+{
+    for (int i = 0; i < 4; i++)
+        out[i] = m[i] * v[0] + m[4 + i] * v[1] + m[8 + i] * v[2] + m[12 + i] * w;
+}
+
+// out = a * b, all column-major
+static inline void multiply(const GLfloat *a, const GLfloat *b, GLfloat *out)
+{
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++)
+            out[4 * column + row] = a[row] * b[4 * column] + a[4 + row] * b[4 * column + 1] +
+                                    a[8 + row] * b[4 * column + 2] + a[12 + row] * b[4 * column + 3];
+}
+
+static inline void normalize(float *v)
+{
+    float length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+// the colors glmDraw lights a material with in mode: its own with
+// GLM_MATERIAL, its diffuse one for ambient and diffuse with GLM_COLOR
+// (color material), and GL's defaults otherwise
+struct MaterialColors {
+    const GLfloat *ambient;
+    const GLfloat *diffuse;
+    const GLfloat *specular;
+    float shininess;
+};
+
+static inline MaterialColors materialColors(const GLMmaterial *material, GLuint mode)
+{
+    static const GLfloat defaultAmbient[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+    static const GLfloat defaultDiffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+    static const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    MaterialColors colors = { defaultAmbient, defaultDiffuse, black, 0.0f };
+    if (material && mode & GLM_MATERIAL) {
+        colors.ambient = material->ambient;
+        colors.diffuse = material->diffuse;
+        colors.specular = material->specular;
+        colors.shininess = material->shininess;
+    } else if (material && mode & GLM_COLOR) {
+        colors.ambient = colors.diffuse = material->diffuse;
+    }
+    return colors;
+}
+
+// the color GL_LIGHT0 (white) and the default scene ambient light give a
+// point, local viewer off; toLight is of unit length, lit scales the
+// light (0 in shadow) and occlusion the ambient and diffuse terms
+static inline void lightColor(const MaterialColors &colors, const float *normal,
+                              const float *toLight, float lit, float occlusion, float *color)
+{
+    float diffuseTerm = normal[0] * toLight[0] + normal[1] * toLight[1] + normal[2] * toLight[2];
+    diffuseTerm = diffuseTerm > 0.0f ? diffuseTerm * lit : 0.0f;
+
+    for (int k = 0; k < 3; k++)
+        color[k] = (0.2f * colors.ambient[k] + diffuseTerm * colors.diffuse[k]) * occlusion;
+
+    const GLfloat *specular = colors.specular;
+    if (diffuseTerm > 0.0f && (specular[0] > 0.0f || specular[1] > 0.0f || specular[2] > 0.0f)) {
+        float half[3] = { toLight[0], toLight[1], toLight[2] + 1.0f };
+        normalize(half);
+        float specularTerm = normal[0] * half[0] + normal[1] * half[1] + normal[2] * half[2];
+        if (specularTerm > 0.0f) {
+            specularTerm = pow(specularTerm, colors.shininess);
+            for (int k = 0; k < 3; k++)
+                color[k] += specularTerm * specular[k];
+        }
+    }
+}
+
+#endif // SHADING_H
+
+/*========================================================================================*/
@@ -0,0 +1,163 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: textoverlay.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "textoverlay.h"
+
+#include <QtGui/QFontMetrics>
+#include <QtGui/QImage>
+#include <QtGui/QPainter>
+#include <QtOpenGL/QGLWidget>
+
+/*======================================== DEFINES =======================================*/
+
+static const int LineSpacing = 15;  // pixels between baselines
+
+/*======================================== GLOBAL ========================================*/
+
+static int powerOfTwo(int n)
+{
+    int power = 1;
+    while (power < n)
+        power *= 2;
+    return power;
+}
+
+/*======================================== PUBLIC ========================================*/
+
+TextOverlay::TextOverlay() :
+    changed(false), titleFont("TypeWriter", 10, QFont::Bold),
+    texture(0), textureWidth(0), textureHeight(0), width(0), height(0), ascent(0)
+{
+}
+
+TextOverlay::~TextOverlay()
+{
+    if (texture)
+        glDeleteTextures(1, &texture);
+}
+
+void TextOverlay::setLines(const QStringList &lines)
+{
+    if (lines == this->lines)
+        return;
+    this->lines = lines;
+    changed = true;
+}
+
+void TextOverlay::draw(int x, int y, int viewWidth, int viewHeight)
+{
+    if (changed)
+        paint();
+    if (!texture || lines.isEmpty())
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_POLYGON_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+    // pixels from the top left
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0, viewWidth, viewHeight, 0.0, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    float s = (float)width / textureWidth, t = (float)height / textureHeight;
+    int top = y - ascent;
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0, 0.0);
+    glVertex2i(x, top + height);
+    glTexCoord2f(s, 0.0);
+    glVertex2i(x + width, top + height);
+    glTexCoord2f(s, t);
+    glVertex2i(x + width, top);
+    glTexCoord2f(0.0, t);
+    glVertex2i(x, top);
+    glEnd();
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+/*======================================== PRIVATE =======================================*/
+
+// paints the lines in white on a clear image and loads it into the
+// texture, which only grows
+void TextOverlay::paint()
+{
+    changed = false;
+    if (lines.isEmpty())
+        return;
+
+    QFontMetrics titleMetrics(titleFont), metrics(font);
+    ascent = titleMetrics.ascent();
+    width = titleMetrics.width(lines.first());
+    for (int i = 1; i < lines.size(); i++)
+        width = qMax(width, metrics.width(lines[i]));
+    width = qMax(width, 1);
+    height = ascent + (lines.size() - 1) * LineSpacing +
+             qMax(lines.size() > 1 ? metrics.descent() : 0, titleMetrics.descent());
+
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(0);
+    QPainter painter(&image);
+    painter.setPen(Qt::white);
+    for (int i = 0; i < lines.size(); i++) {
+        painter.setFont(i ? font : titleFont);
+        painter.drawText(0, ascent + i * LineSpacing, lines[i]);
+    }
+    painter.end();
+    image = QGLWidget::convertToGLFormat(image);
+
+    glPushAttrib(GL_TEXTURE_BIT);
+    if (!texture)
+        glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (width > textureWidth || height > textureHeight) {
+        // powers of two for GL 1.x
+        textureWidth = qMax(powerOfTwo(width), textureWidth);
+        textureHeight = qMax(powerOfTwo(height), textureHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    image.bits());
+    glPopAttrib();
+}
+
+/*========================================================================================*/
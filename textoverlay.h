@@ -0,0 +1,71 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: textoverlay.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef TEXTOVERLAY_H
+#define TEXTOVERLAY_H
+
+#include <QtCore/QStringList>
+#include <QtGui/QFont>
+
+#include <GL/gl.h>
+
+/*======================================== CLASSES =======================================*/
+
+// Draws lines of text over the frame as one textured quad.  The text is
+// painted into the texture only when it changes, where renderText would
+// lay out and rasterize every line with QPainter each frame.  All calls
+// but setLines must be made with the GL context current.
+class TextOverlay
+{
+    public:
+        TextOverlay();
+        ~TextOverlay();
+
+        // the first line is a title, in bold
+        void setLines(const QStringList &lines);
+        // the first baseline at x, y in pixels from the top left of a
+        // view of the given size
+        void draw(int x, int y, int viewWidth, int viewHeight);
+
+    private:
+        void paint();
+
+        QStringList lines;
+        bool changed;
+        QFont titleFont;
+        QFont font;
+
+        // the text fills width x height of the texture from its top
+        // left, rows are bottom up
+        GLuint texture;
+        int textureWidth;
+        int textureHeight;
+        int width;
+        int height;
+        int ascent;
+};
+
+#endif // TEXTOVERLAY_H
+
+/*========================================================================================*/
@@ -0,0 +1,309 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: thumbnails.cpp
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#include "thumbnails.h"
+#include "offscreen.h"
+#include "modelreader.h"
+#include "glwidget.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRegExp>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+
+#include <stdio.h>
+
+/*======================================== GLOBAL ========================================*/
+
+// the angles every model is shown from
+static const struct {
+    const char *name;
+    float xRot, yRot, zRot;
+} views[] = {
+    { "front",  0.0f,   0.0f, 0.0f },
+    { "side",   0.0f,  90.0f, 0.0f },
+    { "top",   90.0f,   0.0f, 0.0f },
+    { "iso",   30.0f, -45.0f, 0.0f },
+};
+static const int numViews = sizeof(views) / sizeof(views[0]);
+
+static QString jsonQuote(const QString &text)
+{
+    QString quoted("\"");
+    for (int i = 0; i < text.size(); i++) {
+        QChar c = text[i];
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c.unicode() < 0x20) {
+            quoted += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + '"';
+}
+
+// undoes jsonQuote, given the text between the quotes
+static QString jsonUnquote(const QString &text)
+{
+    QString plain;
+    for (int i = 0; i < text.size(); i++) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            i++;
+            if (text[i] == 'u') {
+                plain += QChar(text.mid(i + 1, 4).toUShort(0, 16));
+                i += 4;
+                continue;
+            }
+        }
+        plain += text[i];
+    }
+    return plain;
+}
+
+/*======================================== PUBLIC ========================================*/
+
+ThumbnailBatch::ThumbnailBatch(const QString &input, const QString &output, int size) :
+    input(input), output(output), size(size)
+{
+}
+
+int ThumbnailBatch::run()
+{
+    QDir inputDir(input);
+    QDir outputDir(output);
+    if (!inputDir.exists()) {
+        fprintf(stderr, "no directory %s\n", input.toUtf8().data());
+        return 1;
+    }
+    if (!outputDir.mkpath(".")) {
+        fprintf(stderr, "could not create %s\n", output.toUtf8().data());
+        return 1;
+    }
+
+    OffscreenRenderer renderer(size, size);
+    if (!renderer.isValid())
+        return 1;
+    renderer.setSmooth(true);
+
+    // models unchanged since the last run keep their thumbnails, the
+    // others are rendered; models that are gone drop out of the manifest
+    readManifest();
+    QMap<QString, Entry> previous = entries;
+    entries.clear();
+
+    QStringList pending;
+    QList<Entry> pendingEntries;
+    QDirIterator files(input, QStringList() << "*.obj" << "*.OBJ",
+                       QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (files.hasNext()) {
+        QFileInfo info(files.next());
+        QString file = inputDir.relativeFilePath(info.filePath());
+
+        Entry entry;
+        entry.size = info.size();
+        entry.mtime = info.lastModified().toTime_t();
+        entry.triangles = 0;
+        entry.failed = false;
+
+        QMap<QString, Entry>::const_iterator old = previous.constFind(file);
+        if (old != previous.constEnd() && old->size == entry.size &&
+            old->mtime == entry.mtime && upToDate(*old)) {
+            entries.insert(file, *old);
+        } else {
+            pending.append(file);
+            pendingEntries.append(entry);
+        }
+    }
+    printf("%d models up to date, %d to render\n", entries.size(), pending.size());
+
+    // a few models per thread are read ahead of the renderer, no more,
+    // so that large directories do not have to fit in memory
+    QStringList paths;
+    foreach (QString file, pending)
+        paths.append(inputDir.filePath(file));
+    // thumbnails are smooth, also of models that have no normals
+    ModelReader reader(paths, true, 2 * QThread::idealThreadCount());
+
+    int result = 0;
+    for (int done = 0; done < pending.size(); done++) {
+        int index;
+        GLMmodel *model;
+        reader.take(&model, &index);
+        const QString &file = pending[index];
+        Entry &entry = pendingEntries[index];
+
+        // one broken file does not stop the batch, it is listed as failed
+        // (the reason is on stderr) and its thumbnails are left out
+        bool saved = true;
+        bool read = model != NULL;
+        if (read) {
+            // textures and buffers belong to the one context, so the
+            // rest of the setup and the rendering are done here
+            if (!renderer.isSoftware())
+                GLWidget::setupModel(model);
+            entry.triangles = model->numtriangles;
+
+            for (int i = 0; i < numViews; i++) {
+                QString name = thumbnailName(file, views[i].name);
+                QString path = outputDir.filePath(name);
+                outputDir.mkpath(QFileInfo(path).path());
+
+                renderer.setRotation(views[i].xRot, views[i].yRot, views[i].zRot);
+                if (!renderer.render(model).save(path, "PNG")) {
+                    fprintf(stderr, "could not write %s\n", path.toUtf8().data());
+                    saved = false;
+                }
+                entry.thumbnails.append(name);
+            }
+            glmDelete(model);
+        } else {
+            entry.failed = true;
+            result = 1;
+        }
+
+        printf("[%d/%d] %s%s\n", done + 1, pending.size(), file.toUtf8().data(),
+               read ? "" : " failed");
+        if (saved)
+            entries.insert(file, entry);
+        else
+            result = 1;
+
+        // a run cut short does not start over
+        if ((done + 1) % 100 == 0)
+            writeManifest();
+    }
+
+    if (!writeManifest())
+        result = 1;
+    return result;
+}
+
+/*======================================== PRIVATE =======================================*/
+
+bool ThumbnailBatch::upToDate(const Entry &entry) const
+{
+    if (entry.failed)
+        return true;
+    if (entry.thumbnails.size() != numViews)
+        return false;
+    QDir outputDir(output);
+    foreach (QString name, entry.thumbnails) {
+        if (!QFile::exists(outputDir.filePath(name)))
+            return false;
+    }
+    return true;
+}
+
+// the thumbnails keep the directories of the models
+QString ThumbnailBatch::thumbnailName(const QString &file, const char *view) const
+{
+    QFileInfo info(file);
+    QString base = info.completeBaseName() + '_' + view + ".png";
+    if (info.path() == ".")
+        return base;
+    return info.path() + '/' + base;
+}
+
+// the manifest is written one model per line, so that it reads back
+// without a JSON parser
+void ThumbnailBatch::readManifest()
+{
+    entries.clear();
+
+    QFile file(QDir(output).filePath("manifest.json"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+
+    QRegExp header("^\\s*\"thumbnailsize\": (\\d+),");
+    QRegExp model("^\\s*\\{\"file\": \"((?:[^\"\\\\]|\\\\.)*)\", \"size\": (\\d+), "
+                  "\"mtime\": (\\d+), \"triangles\": (\\d+), \"thumbnails\": \\[(.*)\\]"
+                  "(, \"failed\": true)?\\},?$");
+    QRegExp name("\"((?:[^\"\\\\]|\\\\.)*)\"");
+
+    // thumbnails of another size are all rendered again
+    bool sameSize = false;
+    while (!stream.atEnd()) {
+        QString line = stream.readLine();
+        if (header.indexIn(line) != -1) {
+            sameSize = header.cap(1).toInt() == size;
+        } else if (sameSize && model.indexIn(line) != -1) {
+            Entry entry;
+            entry.size = model.cap(2).toLongLong();
+            entry.mtime = model.cap(3).toUInt();
+            entry.triangles = model.cap(4).toUInt();
+            entry.failed = !model.cap(6).isEmpty();
+            QString thumbnails = model.cap(5);
+            for (int pos = 0; (pos = name.indexIn(thumbnails, pos)) != -1;
+                 pos += name.matchedLength())
+                entry.thumbnails.append(jsonUnquote(name.cap(1)));
+            entries.insert(jsonUnquote(model.cap(1)), entry);
+        }
+    }
+}
+
+bool ThumbnailBatch::writeManifest() const
+{
+    // written aside and renamed, a crash never leaves half a manifest
+    QString manifest = QDir(output).filePath("manifest.json");
+    QFile file(manifest + ".tmp");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        fprintf(stderr, "could not write %s\n", manifest.toUtf8().data());
+        return false;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+
+    stream << "{\n\"thumbnailsize\": " << size << ",\n\"models\": [\n";
+    QMap<QString, Entry>::const_iterator entry;
+    for (entry = entries.constBegin(); entry != entries.constEnd(); ++entry) {
+        QStringList thumbnails;
+        foreach (QString name, entry->thumbnails)
+            thumbnails.append(jsonQuote(name));
+        stream << "{\"file\": " << jsonQuote(entry.key())
+               << ", \"size\": " << entry->size
+               << ", \"mtime\": " << entry->mtime
+               << ", \"triangles\": " << entry->triangles
+               << ", \"thumbnails\": [" << thumbnails.join(", ") << "]"
+               << (entry->failed ? ", \"failed\": true}" : "}")
+               << (entry + 1 != entries.constEnd() ? ",\n" : "\n");
+    }
+    stream << "]\n}\n";
+    stream.flush();
+    file.close();
+    if (file.error() != QFile::NoError)
+        return false;
+
+    QFile::remove(manifest);
+    return QFile::rename(manifest + ".tmp", manifest);
+}
+
+/*========================================================================================*/
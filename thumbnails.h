@@ -0,0 +1,73 @@
+/*******************************************************************************************
+**
+** Project: Obj Model Viewer
+** File: thumbnails.h
+**
+** Copyright (C) 2011 techvoid.
+** All rights reserved.
+** http://sourceforge.net/projects/objmodelviewer/
+**
+** This program is free software: you can redistribute it and/or modify it under the terms
+** of the GNU General Public License as published by the Free Software Foundation, either
+** version 3 of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+** without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+** See the GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License along with this
+** program. If not, see <http://www.gnu.org/licenses/>.
+**
+*******************************************************************************************/
+
+/*======================================== HEADERS =======================================*/
+
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/*======================================== CLASSES =======================================*/
+
+// Renders thumbnails of every model under a directory from a few fixed
+// angles and lists them in a manifest.json next to them.  Models are
+// read on a pool of threads while the one offscreen context renders the
+// ones already read; models whose size and modification time match the
+// manifest of the previous run are skipped.  Models that can't be read
+// are listed as failed and only tried again once their file changes.
+class ThumbnailBatch
+{
+    public:
+        ThumbnailBatch(const QString &input, const QString &output, int size);
+
+        // returns the exit code, 0 if every model was rendered
+        int run();
+
+    private:
+        struct Entry {
+            qint64 size;
+            uint mtime;
+            uint triangles;
+            QStringList thumbnails;
+            bool failed;
+        };
+
+        bool upToDate(const Entry &entry) const;
+        QString thumbnailName(const QString &file, const char *view) const;
+
+        void readManifest();
+        bool writeManifest() const;
+
+        QString input;
+        QString output;
+        int size;
+
+        // by file, relative to the input directory
+        QMap<QString, Entry> entries;
+};
+
+#endif // THUMBNAILS_H
+
+/*========================================================================================*/
@@ -27,6 +27,8 @@
 #include <QtCore/QUrl>
 #include <QtCore/QMimeData>
 #include <QtCore/QMutex>
+#include <QtCore/QFileInfo>
+#include <QtCore/QVector>
 
 #include <QtGui/QHBoxLayout>
 #include <QtGui/QFileDialog>
@@ -34,6 +36,9 @@
 #include <QtGui/QDragEnterEvent>
 #include <QtGui/QColorDialog>
 #include <QtGui/QMessageBox>
+#include <QtGui/QInputDialog>
+#include <QtGui/QTreeWidget>
+#include <QtGui/QHeaderView>
 
 #include "glwidget.h"
 #include "global.h"
@@ -52,7 +57,11 @@ Window::Window(QWidget *parent) :
     glWidget = new GLWidget(this);
 
     IsSmooth();
+    IsShaders();
     IsWireframe();
+    IsOverlay();
+    IsLod();
+    IsSoftware();
     IsStats();
     IsPerspective();
 
@@ -60,6 +69,7 @@ Window::Window(QWidget *parent) :
     ySlider = createSlider();
     zSlider = createSlider();
     disSlider = createZoomSlider();
+    groupTree = createGroupTree();
 
     xSlider->setValue(0 * 16);
     ySlider->setValue(0 * 16);
@@ -67,6 +77,7 @@ Window::Window(QWidget *parent) :
     disSlider->setValue(-1);
 
     IsSliders();
+    IsGroups();
 
     glWidget->setXRotation(xSlider->value());
     glWidget->setYRotation(ySlider->value());
@@ -87,18 +98,32 @@ Window::Window(QWidget *parent) :
 
     //buttons - file
     connect(MainWindow.actionOpen, SIGNAL(triggered()), this, SLOT(openFile()));
+    connect(MainWindow.actionAddFiles, SIGNAL(triggered()), this, SLOT(AddFiles()));
     connect(MainWindow.actionAbout, SIGNAL(triggered()), this, SLOT(About()));
     connect(MainWindow.actionExit, SIGNAL(triggered()), this, SLOT(close()));
 
     //buttons - options
     connect(MainWindow.actionSliders, SIGNAL(triggered()), this, SLOT(IsSliders()));
+    connect(MainWindow.actionGroups, SIGNAL(triggered()), this, SLOT(IsGroups()));
     connect(MainWindow.actionSmooth, SIGNAL(triggered()), this, SLOT(IsSmooth()));
+    connect(MainWindow.actionShaders, SIGNAL(triggered()), this, SLOT(IsShaders()));
     connect(MainWindow.actionStatistics, SIGNAL(triggered()), this, SLOT(IsStats()));
     connect(MainWindow.actionWireframe, SIGNAL(triggered()), this, SLOT(IsWireframe()));
+    connect(MainWindow.actionOverlay, SIGNAL(triggered()), this, SLOT(IsOverlay()));
+    connect(MainWindow.actionLod, SIGNAL(triggered()), this, SLOT(IsLod()));
+    connect(MainWindow.actionSoftware, SIGNAL(triggered()), this, SLOT(IsSoftware()));
     connect(MainWindow.actionPerspective, SIGNAL(triggered()), this, SLOT(IsPerspective()));
     connect(MainWindow.actionBg_color, SIGNAL(triggered()), this, SLOT(PickColor()));
+    connect(MainWindow.actionInstances, SIGNAL(triggered()), this, SLOT(AddInstances()));
+    connect(MainWindow.actionSaveTimings, SIGNAL(triggered()), this, SLOT(SaveTimings()));
+    connect(MainWindow.actionScreenshot, SIGNAL(triggered()), this, SLOT(SaveScreenshot()));
+    connect(MainWindow.actionRecord, SIGNAL(triggered()), this, SLOT(Record()));
+    connect(MainWindow.actionAddKeyframe, SIGNAL(triggered()), this, SLOT(AddKeyframe()));
+    connect(MainWindow.actionClearKeyframes, SIGNAL(triggered()), this, SLOT(ClearKeyframes()));
+    connect(glWidget, SIGNAL(recordingFinished(bool)), this, SLOT(RecordingFinished(bool)));
 
     QHBoxLayout *mainLayout = new QHBoxLayout;
+    mainLayout->addWidget(groupTree);
     mainLayout->addWidget(glWidget);
     mainLayout->addWidget(xSlider);
     mainLayout->addWidget(ySlider);
@@ -143,18 +168,139 @@ bool Window::openFile(const QString &Path)
             return false;
     }
 
-    glWidget->readFromFile(fileName.toUtf8().data());
-    setWindowTitle(QString("%1 ( %2 )").arg(APP_PRODUCTNAME).arg(fileName));
+    return openFiles(QStringList(fileName));
+}
+
+bool Window::openFiles(const QStringList &Paths)
+{
+    if (Paths.isEmpty())
+        return false;
+
+    glWidget->openFiles(Paths);
+    fillGroupTree();
+    if (Paths.size() == 1)
+        setWindowTitle(QString("%1 ( %2 )").arg(APP_PRODUCTNAME).arg(Paths.first()));
+    else
+        setWindowTitle(QString("%1 ( %2 models )").arg(APP_PRODUCTNAME).arg(Paths.size()));
     return true;
 }
 
 /*===================================== PRIVATE SLOTS ====================================*/
 
+void Window::AddFiles()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, "Choose files to add",
+                                                          QDir::currentPath(),
+                                                          "wavefront format (*.obj)");
+    if (fileNames.isEmpty())
+        return;
+
+    glWidget->addFiles(fileNames);
+    fillGroupTree();
+    setWindowTitle(QString("%1 ( %2 models )").arg(APP_PRODUCTNAME).arg(glWidget->modelCount()));
+}
+
 void Window::PickColor()
 {
     glWidget->setBgColor(QColorDialog::getColor());
 }
 
+void Window::AddInstances()
+{
+    bool ok;
+    int rows = QInputDialog::getInt(this, "Instances", "rows:", 1, 1, 100, 1, &ok);
+    if (!ok)
+        return;
+    int columns = QInputDialog::getInt(this, "Instances", "columns:", rows, 1, 100, 1, &ok);
+    if (!ok)
+        return;
+    glWidget->setInstanceGrid(rows, columns);
+}
+
+void Window::SaveTimings()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Save frame timings",
+                                                    QDir::currentPath(),
+                                                    "comma separated values (*.csv)");
+    if (fileName.isEmpty())
+        return;
+
+    if (!glWidget->saveTimings(fileName))
+        QMessageBox::warning(this, APP_PRODUCTNAME, QString("Could not write %1").arg(fileName));
+}
+
+void Window::SaveScreenshot()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Save screenshot",
+                                                    QDir::currentPath(),
+                                                    "PNG image (*.png)");
+    if (fileName.isEmpty())
+        return;
+    if (QFileInfo(fileName).suffix().isEmpty())
+        fileName += ".png";
+
+    bool ok;
+    int scale = QInputDialog::getInt(this, "Screenshot", "scale:", 1, 1, 8, 1, &ok);
+    if (!ok)
+        return;
+    glWidget->saveScreenshot(fileName, scale);
+}
+
+void Window::Record()
+{
+    if (glWidget->isRecording())
+        return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Record video",
+                                                    QDir::currentPath(),
+                                                    "video (*.mp4 *.mkv *.avi);;"
+                                                    "PNG image sequence (*.png)");
+    if (fileName.isEmpty())
+        return;
+    if (QFileInfo(fileName).suffix().isEmpty())
+        fileName += ".mp4";
+
+    // a turn about the y axis without a camera path
+    QString what = glWidget->keyframeCount() < 2 ? QString("turntable frames:") :
+                   QString("frames along %1 keyframes:").arg(glWidget->keyframeCount());
+    bool ok;
+    int frames = QInputDialog::getInt(this, "Record video", what, 120, 1, 100000, 1, &ok);
+    if (!ok)
+        return;
+
+    QStringList sizes;
+    sizes << "window" << "1280x720" << "1920x1080" << "3840x2160";
+    QString size = QInputDialog::getItem(this, "Record video", "size:", sizes, 2, false, &ok);
+    if (!ok)
+        return;
+    int width = glWidget->width(), height = glWidget->height();
+    if (size != sizes.first()) {
+        width = size.section('x', 0, 0).toInt();
+        height = size.section('x', 1, 1).toInt();
+    }
+
+    MainWindow.actionRecord->setEnabled(false);
+    glWidget->record(fileName, frames, width, height);
+}
+
+void Window::RecordingFinished(bool ok)
+{
+    MainWindow.actionRecord->setEnabled(true);
+    if (!ok)
+        QMessageBox::warning(this, APP_PRODUCTNAME, "The recording could not be written, "
+                             "see the console for details");
+}
+
+void Window::AddKeyframe()
+{
+    glWidget->addKeyframe();
+}
+
+void Window::ClearKeyframes()
+{
+    glWidget->clearKeyframes();
+}
+
 void Window::SetSliders(bool value)
 {
     xSlider->setShown(value);
@@ -168,6 +314,58 @@ void Window::IsSliders()
     SetSliders(MainWindow.actionSliders->isChecked());
 }
 
+void Window::IsGroups()
+{
+    groupTree->setShown(MainWindow.actionGroups->isChecked());
+}
+
+void Window::GroupChanged(QTreeWidgetItem *item, int column)
+{
+    if (column != 0)
+        return;
+
+    bool visible = item->checkState(0) == Qt::Checked;
+    if (!item->parent()) {
+        // a model shows or hides all of its groups
+        GLMmodel *model = (GLMmodel *)item->data(0, Qt::UserRole).value<void *>();
+        glmShowAllGroups(model, visible);
+        groupTree->blockSignals(true);
+        for (int i = 0; i < item->childCount(); i++)
+            item->child(i)->setCheckState(0, visible ? Qt::Checked : Qt::Unchecked);
+        groupTree->blockSignals(false);
+    } else {
+        GLMmodel *model = (GLMmodel *)item->parent()->data(0, Qt::UserRole).value<void *>();
+        GLMgroup *group = (GLMgroup *)item->data(0, Qt::UserRole).value<void *>();
+        glmShowGroup(model, group, visible);
+    }
+    // repaints are merged, however many groups changed
+    glWidget->update();
+}
+
+void Window::IsolateGroups()
+{
+    showSelectedGroups(false, true);
+}
+
+void Window::HideGroups()
+{
+    showSelectedGroups(true, false);
+}
+
+void Window::ShowAllGroups()
+{
+    groupTree->blockSignals(true);
+    for (int i = 0; i < groupTree->topLevelItemCount(); i++) {
+        QTreeWidgetItem *item = groupTree->topLevelItem(i);
+        glmShowAllGroups((GLMmodel *)item->data(0, Qt::UserRole).value<void *>(), GL_TRUE);
+        item->setCheckState(0, Qt::Checked);
+        for (int j = 0; j < item->childCount(); j++)
+            item->child(j)->setCheckState(0, Qt::Checked);
+    }
+    groupTree->blockSignals(false);
+    glWidget->update();
+}
+
 void Window::IsStats()
 {
     glWidget->setStats(MainWindow.actionStatistics->isChecked());
@@ -183,11 +381,31 @@ void Window::IsWireframe()
     glWidget->setWireframe(MainWindow.actionWireframe->isChecked());
 }
 
+void Window::IsOverlay()
+{
+    glWidget->setOverlay(MainWindow.actionOverlay->isChecked());
+}
+
+void Window::IsLod()
+{
+    glWidget->setLod(MainWindow.actionLod->isChecked());
+}
+
+void Window::IsSoftware()
+{
+    glWidget->setSoftware(MainWindow.actionSoftware->isChecked());
+}
+
 void Window::IsSmooth()
 {
     glWidget->setSmooth(MainWindow.actionSmooth->isChecked());
 }
 
+void Window::IsShaders()
+{
+    glWidget->setShaders(MainWindow.actionShaders->isChecked());
+}
+
 void Window::About()
 {
     QMessageBox::about(this, "About " + QString(APP_PRODUCTNAME),
@@ -235,12 +453,16 @@ void Window::dropEvent(QDropEvent *event)
 {
     const QMimeData *MimeData = event->mimeData();
     if (MimeData->hasUrls()) {
+        // the files dropped together make up the scene
+        QStringList Files;
         QList<QUrl> UrlList = MimeData->urls();
         foreach(QUrl Url, UrlList) {
-            QString File = QFileInfo(Url.toLocalFile()).canonicalFilePath();
-            if (openFile(File))
-                event->acceptProposedAction();
+            QFileInfo File(Url.toLocalFile());
+            if (File.suffix() == "obj")
+                Files.append(File.canonicalFilePath());
         }
+        if (openFiles(Files))
+            event->acceptProposedAction();
     }
 }
 
@@ -257,6 +479,90 @@ QSlider *Window::createSlider()
     return slider;
 }
 
+QTreeWidget *Window::createGroupTree()
+{
+    QTreeWidget *tree = new QTreeWidget;
+    tree->setColumnCount(2);
+    tree->setHeaderLabels(QStringList() << "group" << "triangles");
+    tree->header()->setResizeMode(0, QHeaderView::Stretch);
+    tree->header()->setStretchLastSection(false);
+    tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    tree->setUniformRowHeights(true);
+    tree->setMinimumWidth(200);
+    connect(tree, SIGNAL(itemChanged(QTreeWidgetItem *, int)),
+            this, SLOT(GroupChanged(QTreeWidgetItem *, int)));
+
+    // the selection is shown or hidden from the context menu
+    QAction *isolate = new QAction("show only selected", tree);
+    QAction *hide = new QAction("hide selected", tree);
+    QAction *showAll = new QAction("show all", tree);
+    connect(isolate, SIGNAL(triggered()), this, SLOT(IsolateGroups()));
+    connect(hide, SIGNAL(triggered()), this, SLOT(HideGroups()));
+    connect(showAll, SIGNAL(triggered()), this, SLOT(ShowAllGroups()));
+    tree->addAction(isolate);
+    tree->addAction(hide);
+    tree->addAction(showAll);
+    tree->setContextMenuPolicy(Qt::ActionsContextMenu);
+    return tree;
+}
+
+void Window::fillGroupTree()
+{
+    groupTree->blockSignals(true);
+    groupTree->clear();
+
+    QList<QTreeWidgetItem *> items;
+    for (int i = 0; i < glWidget->modelCount(); i++) {
+        GLMmodel *model = glWidget->model(i);
+        QTreeWidgetItem *item = new QTreeWidgetItem;
+        item->setText(0, QFileInfo(glWidget->modelFile(i)).fileName());
+        item->setText(1, QString::number(model->numtriangles));
+        item->setData(0, Qt::UserRole, QVariant::fromValue((void *)model));
+        item->setCheckState(0, Qt::Checked);
+
+        // the groups are listed in the order of the file
+        QVector<GLMgroup *> groups(model->numgroups);
+        for (GLMgroup *group = model->groups; group; group = group->next)
+            groups[group->index] = group;
+        QList<QTreeWidgetItem *> children;
+        foreach (GLMgroup *group, groups) {
+            QTreeWidgetItem *child = new QTreeWidgetItem;
+            child->setText(0, group->name);
+            child->setText(1, QString::number(group->numtriangles));
+            child->setData(0, Qt::UserRole, QVariant::fromValue((void *)group));
+            child->setCheckState(0, glmGroupVisible(model, group) ? Qt::Checked : Qt::Unchecked);
+            children.append(child);
+        }
+        item->addChildren(children);
+        items.append(item);
+    }
+    groupTree->addTopLevelItems(items);
+    if (items.size() == 1)
+        items.first()->setExpanded(true);
+
+    groupTree->blockSignals(false);
+}
+
+void Window::showSelectedGroups(bool others, bool selected)
+{
+    groupTree->blockSignals(true);
+    for (int i = 0; i < groupTree->topLevelItemCount(); i++) {
+        QTreeWidgetItem *item = groupTree->topLevelItem(i);
+        GLMmodel *model = (GLMmodel *)item->data(0, Qt::UserRole).value<void *>();
+        // a selected model stands for all of its groups
+        for (int j = 0; j < item->childCount(); j++) {
+            QTreeWidgetItem *child = item->child(j);
+            bool visible = (item->isSelected() || child->isSelected()) ? selected :
+                           others ? child->checkState(0) == Qt::Checked : false;
+            glmShowGroup(model, (GLMgroup *)child->data(0, Qt::UserRole).value<void *>(),
+                         visible ? GL_TRUE : GL_FALSE);
+            child->setCheckState(0, visible ? Qt::Checked : Qt::Unchecked);
+        }
+    }
+    groupTree->blockSignals(false);
+    glWidget->update();
+}
+
 QSlider *Window::createZoomSlider()
 {
     QSlider *slider = new QSlider(Qt::Vertical);
@@ -31,6 +31,8 @@
 
 QT_BEGIN_NAMESPACE
 class QSlider;
+class QTreeWidget;
+class QTreeWidgetItem;
 QT_END_NAMESPACE
 
 class GLWidget;
@@ -46,14 +48,32 @@ class Window : public QMainWindow
 
     public slots:
         bool openFile(const QString &Path = QString());
+        bool openFiles(const QStringList &Paths);
 
     private slots:
         void IsSliders();
         void IsSmooth();
+        void IsShaders();
         void IsWireframe();
+        void IsOverlay();
+        void IsLod();
+        void IsSoftware();
         void IsStats();
         void IsPerspective();
+        void IsGroups();
+        void GroupChanged(QTreeWidgetItem *item, int column);
+        void IsolateGroups();
+        void HideGroups();
+        void ShowAllGroups();
+        void AddFiles();
         void PickColor();
+        void AddInstances();
+        void SaveTimings();
+        void SaveScreenshot();
+        void Record();
+        void RecordingFinished(bool ok);
+        void AddKeyframe();
+        void ClearKeyframes();
         void SetSliders(bool value);
         void About();
 
@@ -77,12 +97,18 @@ class Window : public QMainWindow
 
         QSlider *createSlider();
         QSlider *createZoomSlider();
+        QTreeWidget *createGroupTree();
+        void fillGroupTree();
+        void showSelectedGroups(bool others, bool selected);
 
         GLWidget *glWidget;
         QSlider  *xSlider;
         QSlider  *ySlider;
         QSlider  *zSlider;
         QSlider  *disSlider;
+
+        // groups of the models in the scene, checked when drawn
+        QTreeWidget *groupTree;
 };
 
 #endif // WINDOW_H